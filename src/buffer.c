@@ -0,0 +1,314 @@
+#include "buffer.h"
+#include "compress.h"
+#include "diff.h"
+#include "file.h"
+#include "follow.h"
+#include "input.h"
+#include "journal.h"
+#include "loader.h"
+#include "row.h"
+#include "rowcache.h"
+#include "syntax.h"
+#include "trigram.h"
+#include "watch.h"
+#include "window.h"
+
+/***
+ * Allocates an empty buffer
+ *
+ * @return the new buffer
+ */
+struct editorBuffer *editorBufferNew() {
+  struct editorBuffer *buf = malloc(sizeof(struct editorBuffer));
+  if (buf == NULL) {
+    return NULL;
+  }
+
+  buf->row = NULL;
+  buf->numrows = 0;
+  buf->rowcap = 0;
+  buf->dirty = 0;
+  buf->filename = NULL;
+  buf->syntax = NULL;
+  buf->compression = COMPRESS_NONE;
+  memset(&buf->disk, 0, sizeof(buf->disk));
+  buf->wd = -1;
+  buf->cx = KILO_SIGN_COLUMN;
+  buf->cy = 0;
+  buf->rowoff = 0;
+  buf->coloff = 0;
+  buf->loader = NULL;
+  buf->follow = NULL;
+  buf->journal = NULL;
+  buf->diff = NULL;
+  buf->trigrams = editorTrigramNew();
+  buf->hlvalid = 0;
+  buf->hlcached = -1;
+  buf->cursors = NULL;
+  buf->numcursors = 0;
+  buf->match_row = -1;
+  buf->match_start = 0;
+  buf->match_len = 0;
+  buf->cold = 0;
+  buf->cachebytes = 0;
+  buf->lastused = 0;
+
+  return buf;
+}
+
+/***
+ * Frees a buffer and all of its rows
+ *
+ * @param *buf The buffer to free
+ */
+void editorBufferFree(struct editorBuffer *buf) {
+  editorRowCacheSave(buf);
+  editorLoaderCancel(buf);
+  editorFollowStop(buf);
+  editorWatchRemove(buf);
+  editorJournalDiscard(buf);
+  editorDiffStop(buf);
+  editorTrigramFree(buf->trigrams);
+  for (int j = 0; j < buf->numrows; j++) {
+    editorFreeRow(&buf->row[j]);
+  }
+  free(buf->row);
+  free(buf->cursors);
+  free(buf->filename);
+  free(buf);
+}
+
+/***
+ * Appends a buffer to the buffer list
+ *
+ * @param *buf The buffer to add
+ * @return the index of the buffer in the list
+ */
+int editorBufferAdd(struct editorBuffer *buf) {
+  struct editorBuffer **new = realloc(
+      E.buffers, sizeof(struct editorBuffer *) * (E.numbuffers + 1));
+  if (new == NULL) {
+    return -1;
+  }
+
+  E.buffers = new;
+  E.buffers[E.numbuffers] = buf;
+  return E.numbuffers++;
+}
+
+/***
+ * Rebuilds the render and highlight of a buffer whose caches were dropped
+ *
+ * @param *buf The buffer, it must be the current one
+ */
+static void editorBufferWarm(struct editorBuffer *buf) {
+  buf->cold = 0;
+  for (int j = 0; j < buf->numrows; j++) {
+    editorUpdateRow(&buf->row[j]);
+  }
+}
+
+/***
+ * Makes another buffer the current one
+ *
+ * Only the cursor is saved and restored, rows and their highlight stay where
+ * they are, so switching does not depend on the size of either buffer
+ *
+ * @param idx The index of the buffer in the list
+ */
+void editorBufferSwitch(int idx) {
+  if (idx < 0 || idx >= E.numbuffers) {
+    return;
+  }
+
+  if (E.buf != NULL) {
+    E.buf->cx = E.cx;
+    E.buf->cy = E.cy;
+    E.buf->rowoff = E.rowoff;
+    E.buf->coloff = E.coloff;
+  }
+
+  E.curbuf = idx;
+  E.buf = E.buffers[idx];
+  E.buf->lastused = ++E.switches;
+
+  E.cx = E.buf->cx;
+  E.cy = E.buf->cy;
+  E.rowoff = E.buf->rowoff;
+  E.coloff = E.buf->coloff;
+
+  if (E.win != NULL) {
+    E.win->buf = E.buf;
+    E.win->drawn_rowoff = -1;
+  }
+
+  if (E.buf->cold) {
+    editorBufferWarm(E.buf);
+  }
+  editorBufferTrimCaches();
+}
+
+/***
+ * Switches to the next buffer in the list
+ */
+void editorBufferNext() {
+  editorBufferSwitch((E.curbuf + 1) % E.numbuffers);
+}
+
+/***
+ * Switches to the previous buffer in the list
+ */
+void editorBufferPrev() {
+  editorBufferSwitch((E.curbuf + E.numbuffers - 1) % E.numbuffers);
+}
+
+/***
+ * Opens a file in its own buffer, or switches to it if it is already open
+ *
+ * @param *filename The name of the file to edit
+ */
+void editorBufferEdit(char *filename) {
+  for (int j = 0; j < E.numbuffers; j++) {
+    if (E.buffers[j]->filename &&
+        strcmp(E.buffers[j]->filename, filename) == 0) {
+      editorBufferSwitch(j);
+      return;
+    }
+  }
+
+  // an untouched [No Name] buffer is reused instead of piling up
+  if (E.buf->filename != NULL || E.buf->numrows != 0 || E.buf->dirty) {
+    struct editorBuffer *buf = editorBufferNew();
+    int idx = buf ? editorBufferAdd(buf) : -1;
+    if (idx == -1) {
+      free(buf);
+      editorSetStatusMessage("Can't open '%s': out of memory", filename);
+      return;
+    }
+    editorBufferSwitch(idx);
+  }
+
+  if (editorOpen(filename) == -1) {
+    if (errno != ENOENT) {
+      editorSetStatusMessage("Can't open '%s': %s", filename,
+                             strerror(errno));
+      editorBufferClose(1);
+      return;
+    }
+
+    E.buf->filename = strdup(filename);
+    E.buf->compression = editorCompressionFor(filename);
+    editorSelectSyntaxHighlight();
+    editorSetStatusMessage("\"%s\" [New File]", filename);
+  }
+}
+
+/***
+ * Closes the current buffer
+ *
+ * @param force Whether to discard unsaved changes
+ */
+void editorBufferClose(int force) {
+  if (E.buf->dirty && !force) {
+    editorSetStatusMessage(
+        "WARNING! Buffer has unsaved changes! :w to save or :bd! to discard");
+    return;
+  }
+
+  int idx = E.curbuf;
+  struct editorBuffer *old = E.buf;
+  editorBufferFree(old);
+  memmove(&E.buffers[idx], &E.buffers[idx + 1],
+          sizeof(struct editorBuffer *) * (E.numbuffers - idx - 1));
+  E.numbuffers--;
+  E.buf = NULL;
+
+  if (E.numbuffers == 0) {
+    editorBufferAdd(editorBufferNew());
+  }
+  editorBufferSwitch(idx < E.numbuffers ? idx : E.numbuffers - 1);
+  editorWindowReplaceBuffer(old, E.buf);
+}
+
+/***
+ * Shows the buffer list in the status bar
+ */
+void editorBufferList() {
+  char list[sizeof(E.statusmsg)];
+  int len = 0;
+
+  for (int j = 0; j < E.numbuffers && len < (int)sizeof(list); j++) {
+    struct editorBuffer *buf = E.buffers[j];
+    len += snprintf(&list[len], sizeof(list) - len, "%s%d%s \"%s\"%s",
+                    j ? " | " : "", j + 1, j == E.curbuf ? "%" : "",
+                    buf->filename ? buf->filename : "[No Name]",
+                    buf->dirty ? " +" : "");
+  }
+
+  editorSetStatusMessage("%s", list);
+}
+
+/***
+ * Frees the render and highlight of every row of a hidden buffer
+ *
+ * The rows themselves are kept, the caches are rebuilt the next time the
+ * buffer is switched to
+ *
+ * @param *buf The buffer to shrink, it must not be displayed
+ */
+void editorBufferDropCaches(struct editorBuffer *buf) {
+  if (buf == E.buf || buf->cold || buf->loader || editorWindowShows(buf)) {
+    return;
+  }
+
+  for (int j = 0; j < buf->numrows; j++) {
+    editorSyntaxFree(&buf->row[j]);
+    free(buf->row[j].render);
+    buf->row[j].render = NULL;
+    buf->row[j].rsize = 0;
+  }
+  buf->cachebytes = 0;
+  buf->cold = 1;
+}
+
+/***
+ * Drops the caches of the least recently used hidden buffers until the ones
+ * left fit in KILO_CACHE_LIMIT
+ */
+void editorBufferTrimCaches() {
+  while (1) {
+    size_t total = 0;
+    struct editorBuffer *oldest = NULL;
+
+    for (int j = 0; j < E.numbuffers; j++) {
+      struct editorBuffer *buf = E.buffers[j];
+      if (buf == E.buf || buf->cold || buf->loader ||
+          editorWindowShows(buf)) {
+        continue;
+      }
+      total += buf->cachebytes;
+      if (oldest == NULL || buf->lastused < oldest->lastused) {
+        oldest = buf;
+      }
+    }
+
+    if (oldest == NULL || total <= KILO_CACHE_LIMIT) {
+      return;
+    }
+    editorBufferDropCaches(oldest);
+  }
+}
+
+/***
+ * Looks for a buffer with unsaved changes
+ *
+ * @return the index of the first modified buffer, -1 if there is none
+ */
+int editorBuffersDirty() {
+  for (int j = 0; j < E.numbuffers; j++) {
+    if (E.buffers[j]->dirty) {
+      return j;
+    }
+  }
+  return -1;
+}
@@ -0,0 +1,19 @@
+#ifndef BUFFER_H_
+#define BUFFER_H_
+
+#include "typedefs.h"
+
+struct editorBuffer *editorBufferNew();
+void editorBufferFree(struct editorBuffer *buf);
+int editorBufferAdd(struct editorBuffer *buf);
+void editorBufferSwitch(int idx);
+void editorBufferNext();
+void editorBufferPrev();
+void editorBufferEdit(char *filename);
+void editorBufferClose(int force);
+void editorBufferList();
+void editorBufferDropCaches(struct editorBuffer *buf);
+void editorBufferTrimCaches();
+int editorBuffersDirty();
+
+#endif // !#ifndef BUFFER_H_
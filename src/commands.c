@@ -1,8 +1,16 @@
 #include "commands.h"
+#include "buffer.h"
 #include "input.h"
+#include "journal.h"
+#include "rowcache.h"
+#include "writer.h"
 
 void quit() {
-  if (E.dirty) {
+  int dirty = editorBuffersDirty();
+  if (dirty != -1) {
+    if (dirty != E.curbuf) {
+      editorBufferSwitch(dirty);
+    }
     editorSetStatusMessage(
         "WARNING! File has unsaved changes! :w to save or :q! "
         "to quit without saving");
@@ -12,6 +20,13 @@ void quit() {
 }
 
 void force_quit() {
+  // leaving on purpose, the unsaved edits are not to be recovered
+  for (int j = 0; j < E.numbuffers; j++) {
+    editorJournalDiscard(E.buffers[j]);
+    editorRowCacheSave(E.buffers[j]);
+  }
+
+  editorWriterDrain();
   write(STDOUT_FILENO, "\x1b[2J", 4); // clear screen
   write(STDOUT_FILENO, "\x1b[H", 3);  // cursor home
   exit(EXIT_SUCCESS);
@@ -0,0 +1,462 @@
+#include "compress.h"
+#include <pthread.h>
+#include <zlib.h>
+#ifdef KILO_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+struct editorStream {
+  int fd;
+  int format;
+  size_t offset; // bytes read from fd so far
+  int eof;
+
+  char *in;
+  z_stream z;
+  int inmember; // inside a gzip member that has not ended yet
+#ifdef KILO_HAVE_ZSTD
+  ZSTD_DStream *zstd;
+  ZSTD_inBuffer zin;
+#endif
+};
+
+/***
+ * Guesses the compression of a file from its name
+ *
+ * @param *filename The name of the file
+ * @return one of editorCompression
+ */
+int editorCompressionFor(char *filename) {
+  char *ext = strrchr(filename, '.');
+  if (ext == NULL) {
+    return COMPRESS_NONE;
+  }
+  if (strcmp(ext, ".gz") == 0) {
+    return COMPRESS_GZIP;
+  }
+  if (strcmp(ext, ".zst") == 0) {
+    return COMPRESS_ZSTD;
+  }
+  return COMPRESS_NONE;
+}
+
+/***
+ * Tells the compression of an open file from its magic bytes
+ *
+ * @param fd The file, its offset is not moved
+ * @return one of editorCompression
+ */
+int editorCompressionDetect(int fd) {
+  unsigned char magic[4];
+  ssize_t n = pread(fd, magic, sizeof(magic), 0);
+
+  if (n >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+    return COMPRESS_GZIP;
+  }
+  if (n == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f &&
+      magic[3] == 0xfd) {
+    return COMPRESS_ZSTD;
+  }
+  return COMPRESS_NONE;
+}
+
+/***
+ * Wraps a file in a stream that reads it uncompressed
+ *
+ * The stream owns fd from here on
+ *
+ * @param fd The open file
+ * @param format One of editorCompression
+ * @return the stream, NULL with errno set on failure
+ */
+struct editorStream *editorStreamOpen(int fd, int format) {
+#ifndef KILO_HAVE_ZSTD
+  if (format == COMPRESS_ZSTD) {
+    errno = ENOTSUP;
+    return NULL;
+  }
+#endif
+
+  struct editorStream *s = calloc(1, sizeof(struct editorStream));
+  if (s == NULL) {
+    return NULL;
+  }
+  s->fd = fd;
+  s->format = format;
+  if (format == COMPRESS_NONE) {
+    return s;
+  }
+
+  s->in = malloc(KILO_LOAD_CHUNK);
+  if (s->in == NULL) {
+    free(s);
+    return NULL;
+  }
+
+  if (format == COMPRESS_GZIP) {
+    // 15 + 32 accepts both gzip and zlib headers
+    if (inflateInit2(&s->z, 15 + 32) != Z_OK) {
+      free(s->in);
+      free(s);
+      errno = ENOMEM;
+      return NULL;
+    }
+  }
+#ifdef KILO_HAVE_ZSTD
+  if (format == COMPRESS_ZSTD) {
+    s->zstd = ZSTD_createDStream();
+    if (s->zstd == NULL) {
+      free(s->in);
+      free(s);
+      errno = ENOMEM;
+      return NULL;
+    }
+    ZSTD_initDStream(s->zstd);
+    s->zin.src = s->in;
+    s->zin.size = 0;
+    s->zin.pos = 0;
+  }
+#endif
+
+  return s;
+}
+
+/***
+ * Reads more compressed input once the previous block is used up
+ *
+ * @return the number of bytes read, 0 at end of file, -1 on error
+ */
+static ssize_t editorStreamFill(struct editorStream *s) {
+  ssize_t n;
+  do {
+    n = read(s->fd, s->in, KILO_LOAD_CHUNK);
+  } while (n == -1 && errno == EINTR);
+
+  if (n == 0) {
+    s->eof = 1;
+  } else if (n > 0) {
+    s->offset += n;
+  }
+  return n;
+}
+
+/***
+ * Inflates gzip data, members written one after the other are read as one
+ */
+static ssize_t editorStreamInflate(struct editorStream *s, char *buf,
+                                   size_t len) {
+  s->z.next_out = (unsigned char *)buf;
+  s->z.avail_out = len;
+
+  while (s->z.avail_out == len) {
+    if (s->z.avail_in == 0) {
+      if (s->eof) {
+        break;
+      }
+      ssize_t n = editorStreamFill(s);
+      if (n == -1) {
+        return -1;
+      }
+      s->z.next_in = (unsigned char *)s->in;
+      s->z.avail_in = n;
+      continue;
+    }
+
+    s->inmember = 1;
+    int ret = inflate(&s->z, Z_NO_FLUSH);
+    if (ret == Z_STREAM_END) {
+      s->inmember = 0;
+      inflateReset(&s->z);
+    } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+      errno = EIO;
+      return -1;
+    }
+  }
+
+  size_t got = len - s->z.avail_out;
+  if (got == 0 && s->inmember) {
+    // the file ends in the middle of a member
+    errno = EIO;
+    return -1;
+  }
+  return got;
+}
+
+#ifdef KILO_HAVE_ZSTD
+/***
+ * Decompresses zstd data, frames written one after the other are read as one
+ */
+static ssize_t editorStreamZstd(struct editorStream *s, char *buf,
+                                size_t len) {
+  ZSTD_outBuffer out = {buf, len, 0};
+  size_t ret = 0;
+
+  while (out.pos == 0) {
+    if (s->zin.pos == s->zin.size) {
+      if (s->eof) {
+        break;
+      }
+      ssize_t n = editorStreamFill(s);
+      if (n == -1) {
+        return -1;
+      }
+      s->zin.size = n;
+      s->zin.pos = 0;
+      continue;
+    }
+
+    ret = ZSTD_decompressStream(s->zstd, &out, &s->zin);
+    if (ZSTD_isError(ret)) {
+      errno = EIO;
+      return -1;
+    }
+    s->inmember = (ret != 0);
+  }
+
+  if (out.pos == 0 && s->inmember) {
+    errno = EIO;
+    return -1;
+  }
+  return out.pos;
+}
+#endif
+
+/***
+ * Reads uncompressed data from a stream
+ *
+ * @param *s The stream
+ * @param *buf Where to store the data
+ * @param len The size of buf
+ * @return the number of bytes read, 0 at end of file, -1 on error
+ */
+ssize_t editorStreamRead(struct editorStream *s, char *buf, size_t len) {
+  switch (s->format) {
+  case COMPRESS_GZIP:
+    return editorStreamInflate(s, buf, len);
+#ifdef KILO_HAVE_ZSTD
+  case COMPRESS_ZSTD:
+    return editorStreamZstd(s, buf, len);
+#endif
+  default: {
+    ssize_t n;
+    do {
+      n = read(s->fd, buf, len);
+    } while (n == -1 && errno == EINTR);
+    if (n > 0) {
+      s->offset += n;
+    }
+    return n;
+  }
+  }
+}
+
+/***
+ * Tells how much of the file on disk was consumed
+ *
+ * @param *s The stream
+ * @return the offset in the underlying file
+ */
+size_t editorStreamOffset(struct editorStream *s) { return s->offset; }
+
+/***
+ * Closes a stream and its file
+ *
+ * @param *s The stream
+ */
+void editorStreamClose(struct editorStream *s) {
+  if (s->format == COMPRESS_GZIP) {
+    inflateEnd(&s->z);
+  }
+#ifdef KILO_HAVE_ZSTD
+  if (s->format == COMPRESS_ZSTD) {
+    ZSTD_freeDStream(s->zstd);
+  }
+#endif
+  close(s->fd);
+  free(s->in);
+  free(s);
+}
+
+struct editorCompressJob {
+  int format;
+  char *in;
+  size_t inlen;
+  char *out;
+  size_t outlen;
+  int error;
+};
+
+/***
+ * Compresses one block into a gzip member or zstd frame of its own, so the
+ * blocks can be done in parallel and simply written one after the other
+ *
+ * @param *arg The job
+ */
+static void *editorCompressBlock(void *arg) {
+  struct editorCompressJob *job = arg;
+
+#ifdef KILO_HAVE_ZSTD
+  if (job->format == COMPRESS_ZSTD) {
+    size_t cap = ZSTD_compressBound(job->inlen);
+    job->out = malloc(cap);
+    if (job->out == NULL) {
+      job->error = ENOMEM;
+      return NULL;
+    }
+    size_t ret = ZSTD_compress(job->out, cap, job->in, job->inlen,
+                               KILO_COMPRESS_LEVEL);
+    if (ZSTD_isError(ret)) {
+      job->error = EIO;
+      return NULL;
+    }
+    job->outlen = ret;
+    return NULL;
+  }
+#endif
+
+  z_stream z;
+  memset(&z, 0, sizeof(z));
+  // 15 + 16 writes a gzip header instead of a zlib one
+  if (deflateInit2(&z, KILO_COMPRESS_LEVEL, Z_DEFLATED, 15 + 16, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    job->error = ENOMEM;
+    return NULL;
+  }
+
+  size_t cap = deflateBound(&z, job->inlen);
+  job->out = malloc(cap);
+  if (job->out == NULL) {
+    deflateEnd(&z);
+    job->error = ENOMEM;
+    return NULL;
+  }
+
+  z.next_in = (unsigned char *)job->in;
+  z.avail_in = job->inlen;
+  z.next_out = (unsigned char *)job->out;
+  z.avail_out = cap;
+  if (deflate(&z, Z_FINISH) != Z_STREAM_END) {
+    job->error = EIO;
+  }
+  job->outlen = cap - z.avail_out;
+  deflateEnd(&z);
+  return NULL;
+}
+
+/***
+ * Collects whole rows of the current buffer into a block of about
+ * KILO_LOAD_CHUNK bytes
+ *
+ * @param *row The first row to take, advanced past the rows taken
+ * @param *len Where to store the length of the block
+ * @return the block, NULL when out of memory
+ */
+static char *editorCompressCollect(int *row, size_t *len) {
+  size_t cap = KILO_LOAD_CHUNK;
+  char *block = malloc(cap);
+  size_t used = 0;
+
+  while (block && *row < E.buf->numrows && used < KILO_LOAD_CHUNK) {
+    erow *r = &E.buf->row[*row];
+    if (used + r->size + 1 > cap) {
+      cap = used + r->size + 1;
+      char *new = realloc(block, cap);
+      if (new == NULL) {
+        free(block);
+        return NULL;
+      }
+      block = new;
+    }
+
+    memcpy(&block[used], r->chars, r->size);
+    used += r->size;
+    block[used++] = '\n';
+    (*row)++;
+  }
+
+  *len = used;
+  return block;
+}
+
+/***
+ * Writes the current buffer compressed
+ *
+ * The rows are cut in blocks that are compressed by one thread per CPU.
+ * Only one block per thread is held at a time, whatever the file size.
+ *
+ * @param fd The file, positioned where the data goes
+ * @param format One of editorCompression
+ * @return the number of bytes written, -1 with errno set on failure
+ */
+ssize_t editorCompressWrite(int fd, int format) {
+#ifndef KILO_HAVE_ZSTD
+  if (format == COMPRESS_ZSTD) {
+    errno = ENOTSUP;
+    return -1;
+  }
+#endif
+
+  long workers = sysconf(_SC_NPROCESSORS_ONLN);
+  if (workers < 1) {
+    workers = 1;
+  } else if (workers > 16) {
+    workers = 16;
+  }
+
+  struct editorCompressJob jobs[workers];
+  pthread_t threads[workers];
+  ssize_t written = 0;
+  int row = 0;
+  int error = 0;
+
+  // an empty buffer still gets a valid, empty, stream
+  int first = 1;
+  while (!error && (first || row < E.buf->numrows)) {
+    first = 0;
+
+    int n = 0;
+    while (n < workers && (n == 0 || row < E.buf->numrows)) {
+      memset(&jobs[n], 0, sizeof(jobs[n]));
+      jobs[n].format = format;
+      jobs[n].in = editorCompressCollect(&row, &jobs[n].inlen);
+      if (jobs[n].in == NULL) {
+        error = ENOMEM;
+        break;
+      }
+      n++;
+    }
+
+    int started = 0;
+    for (; !error && started < n; started++) {
+      if (pthread_create(&threads[started], NULL, editorCompressBlock,
+                         &jobs[started]) != 0) {
+        editorCompressBlock(&jobs[started]);
+        threads[started] = pthread_self();
+      }
+    }
+
+    for (int j = 0; j < n; j++) {
+      if (j < started && !pthread_equal(threads[j], pthread_self())) {
+        pthread_join(threads[j], NULL);
+      }
+      if (!error && jobs[j].error) {
+        error = jobs[j].error;
+      }
+      if (!error) {
+        ssize_t w = write(fd, jobs[j].out, jobs[j].outlen);
+        if (w != (ssize_t)jobs[j].outlen) {
+          error = (w == -1) ? errno : EIO;
+        }
+        written += jobs[j].outlen;
+      }
+      free(jobs[j].in);
+      free(jobs[j].out);
+    }
+  }
+
+  if (error) {
+    errno = error;
+    return -1;
+  }
+  return written;
+}
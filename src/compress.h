@@ -0,0 +1,16 @@
+#ifndef COMPRESS_H_
+#define COMPRESS_H_
+
+#include "typedefs.h"
+
+struct editorStream;
+
+int editorCompressionFor(char *filename);
+int editorCompressionDetect(int fd);
+struct editorStream *editorStreamOpen(int fd, int format);
+ssize_t editorStreamRead(struct editorStream *s, char *buf, size_t len);
+size_t editorStreamOffset(struct editorStream *s);
+void editorStreamClose(struct editorStream *s);
+ssize_t editorCompressWrite(int fd, int format);
+
+#endif // !#ifndef COMPRESS_H_
@@ -0,0 +1,413 @@
+#include "cursor.h"
+#include "input.h"
+#include "row.h"
+#include "utf8.h"
+#include "window.h"
+
+// every cursor of the buffer while a key is applied to all of them, the one
+// of the window included
+struct editorCursorSlot {
+  int cx, cy;
+  int primary;
+};
+
+static struct editorCursorSlot *slots = NULL;
+static int numslots = 0;
+static int slotcap = 0;
+
+/***
+ * Orders cursors by row and column
+ */
+static int editorCursorCompare(const void *a, const void *b) {
+  const struct editorCursorSlot *x = a;
+  const struct editorCursorSlot *y = b;
+  if (x->cy != y->cy) {
+    return (x->cy > y->cy) - (x->cy < y->cy);
+  }
+  return (x->cx > y->cx) - (x->cx < y->cx);
+}
+
+/***
+ * Sorts the slots and merges the cursors that are in the same place
+ */
+static void editorCursorsUnique() {
+  qsort(slots, numslots, sizeof(*slots), editorCursorCompare);
+
+  int n = 0;
+  for (int j = 0; j < numslots; j++) {
+    if (n > 0 && slots[n - 1].cx == slots[j].cx &&
+        slots[n - 1].cy == slots[j].cy) {
+      slots[n - 1].primary |= slots[j].primary;
+      continue;
+    }
+    slots[n++] = slots[j];
+  }
+  numslots = n;
+}
+
+/***
+ * Gathers the cursors of the current buffer and the window's into slots,
+ * sorted and unique, and brings back inside the text the ones other edits
+ * left out
+ *
+ * @return 0 on success, -1 if out of memory
+ */
+static int editorCursorsGather() {
+  int n = E.buf->numcursors + 1;
+  if (n > slotcap) {
+    struct editorCursorSlot *new = realloc(slots, sizeof(*slots) * n);
+    if (new == NULL) {
+      return -1;
+    }
+    slots = new;
+    slotcap = n;
+  }
+
+  for (int j = 0; j < E.buf->numcursors; j++) {
+    slots[j].cx = E.buf->cursors[j].cx;
+    slots[j].cy = E.buf->cursors[j].cy;
+    slots[j].primary = 0;
+  }
+  slots[n - 1].cx = E.cx;
+  slots[n - 1].cy = E.cy;
+  slots[n - 1].primary = 1;
+  numslots = n;
+
+  for (int j = 0; j < n; j++) {
+    if (slots[j].cy > E.buf->numrows) {
+      slots[j].cy = E.buf->numrows;
+    }
+    int size = 0;
+    if (slots[j].cy < E.buf->numrows) {
+      size = E.buf->row[slots[j].cy].size;
+    }
+    if (slots[j].cx > size + KILO_SIGN_COLUMN) {
+      slots[j].cx = size + KILO_SIGN_COLUMN;
+    }
+  }
+  editorCursorsUnique();
+  return 0;
+}
+
+/***
+ * Puts the slots back into the window's cursor and the buffer's, cursors
+ * that ended up in the same place become one
+ */
+static void editorCursorsScatter() {
+  editorCursorsUnique();
+
+  int count = 0;
+  for (int j = 0; j < numslots; j++) {
+    if (slots[j].primary) {
+      E.cx = slots[j].cx;
+      E.cy = slots[j].cy;
+    } else {
+      E.buf->cursors[count].cx = slots[j].cx;
+      E.buf->cursors[count].cy = slots[j].cy;
+      count++;
+    }
+  }
+  E.buf->numcursors = count;
+}
+
+/***
+ * Schedules the repaint of the rows between the first and last slot
+ */
+static void editorCursorsDamage() {
+  if (numslots > 0) {
+    editorWindowDamage(E.buf, slots[0].cy, slots[numslots - 1].cy);
+  }
+}
+
+/***
+ * Adds a cursor on the row below the lowest one, in the same column
+ *
+ * @return 0 if a cursor was added, -1 at the end of the buffer
+ */
+int editorCursorAddBelow() {
+  int cx = E.cx;
+  int cy = E.cy;
+  if (E.buf->numcursors > 0 &&
+      E.buf->cursors[E.buf->numcursors - 1].cy > cy) {
+    cx = E.buf->cursors[E.buf->numcursors - 1].cx;
+    cy = E.buf->cursors[E.buf->numcursors - 1].cy;
+  }
+  if (cy + 1 >= E.buf->numrows) {
+    return -1;
+  }
+
+  struct editorCursor *new = realloc(
+      E.buf->cursors, sizeof(struct editorCursor) * (E.buf->numcursors + 1));
+  if (new == NULL) {
+    return -1;
+  }
+  E.buf->cursors = new;
+
+  // the cursor moves down the way the window's would
+  int saved_cx = E.cx;
+  int saved_cy = E.cy;
+  E.cx = cx;
+  E.cy = cy;
+  editorMoveCursor(ARROW_DOWN);
+  new[E.buf->numcursors].cx = E.cx;
+  new[E.buf->numcursors].cy = E.cy;
+  E.buf->numcursors++;
+  E.cx = saved_cx;
+  E.cy = saved_cy;
+
+  editorWindowDamage(E.buf, new[E.buf->numcursors - 1].cy,
+                     new[E.buf->numcursors - 1].cy);
+  return 0;
+}
+
+/***
+ * Drops the extra cursors of the current buffer
+ */
+void editorCursorsClear() {
+  if (E.buf->numcursors == 0) {
+    return;
+  }
+  editorWindowDamage(E.buf, E.buf->cursors[0].cy,
+                     E.buf->cursors[E.buf->numcursors - 1].cy);
+  free(E.buf->cursors);
+  E.buf->cursors = NULL;
+  E.buf->numcursors = 0;
+}
+
+/***
+ * Finds the extra cursors on a row of the current buffer
+ *
+ * @param cy The row
+ * @param *count Filled with the number of cursors on the row
+ * @return the first of them, sorted by column
+ */
+const struct editorCursor *editorCursorsOnRow(int cy, int *count) {
+  int lo = 0;
+  int hi = E.buf->numcursors;
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (E.buf->cursors[mid].cy < cy) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  int end = lo;
+  while (end < E.buf->numcursors && E.buf->cursors[end].cy == cy) {
+    end++;
+  }
+  *count = end - lo;
+  return &E.buf->cursors[lo];
+}
+
+/***
+ * Moves every cursor, a count is applied to each at once the way it is to
+ * the window's cursor alone
+ *
+ * @param key The arrow key
+ * @param count The number of times to move, 0 for once
+ */
+void editorCursorsMove(int key, int count) {
+  if (editorCursorsGather() == -1) {
+    return;
+  }
+  editorCursorsDamage();
+
+  int saved_cx = E.cx;
+  int saved_cy = E.cy;
+  for (int j = 0; j < numslots; j++) {
+    E.cx = slots[j].cx;
+    E.cy = slots[j].cy;
+    editorMoveMotion(key, count);
+    slots[j].cx = E.cx;
+    slots[j].cy = E.cy;
+  }
+  E.cx = saved_cx;
+  E.cy = saved_cy;
+
+  editorCursorsScatter();
+  editorCursorsDamage();
+}
+
+/***
+ * Applies the changes gathered for one row and moves its cursors past the
+ * text each one inserted
+ *
+ * @param *edits The changes, one per cursor of the row
+ * @param first The slot of the first cursor of the row
+ * @param n The number of cursors of the row
+ */
+static void editorCursorsEditRow(struct editorRowEdit *edits, int first,
+                                 int n) {
+  editorRowEditMany(&E.buf->row[slots[first].cy], edits, n);
+
+  int shift = 0;
+  for (int k = 0; k < n; k++) {
+    slots[first + k].cx = edits[k].at + shift + edits[k].len +
+                          KILO_SIGN_COLUMN;
+    shift += edits[k].len - edits[k].del;
+  }
+}
+
+/***
+ * Inserts a character at every cursor, each touched row is changed once
+ *
+ * @param c The codepoint to insert
+ */
+void editorCursorsInsertChar(int c) {
+  if (editorCursorsGather() == -1) {
+    return;
+  }
+  if (slots[numslots - 1].cy == E.buf->numrows) {
+    editorInsertRow(E.buf->numrows, "", 0);
+  }
+
+  struct editorRowEdit *edits = malloc(sizeof(*edits) * numslots);
+  if (edits == NULL) {
+    return;
+  }
+  char buf[4];
+  int len = utf8Encode(c, buf);
+
+  for (int j = 0; j < numslots;) {
+    int n = 0;
+    while (j + n < numslots && slots[j + n].cy == slots[j].cy) {
+      edits[n].at = slots[j + n].cx - KILO_SIGN_COLUMN;
+      edits[n].del = 0;
+      edits[n].s = buf;
+      edits[n].len = len;
+      n++;
+    }
+    editorCursorsEditRow(edits, j, n);
+    j += n;
+  }
+  free(edits);
+
+  editorCursorsScatter();
+}
+
+/***
+ * Deletes the character before every cursor, each touched row is changed
+ * once and the rows joined by cursors at their start are joined in one go
+ */
+void editorCursorsDelChar() {
+  if (editorCursorsGather() == -1) {
+    return;
+  }
+  struct editorRowEdit *edits = malloc(sizeof(*edits) * numslots);
+  if (edits == NULL) {
+    return;
+  }
+
+  for (int j = 0; j < numslots;) {
+    int n = 0;
+    int count = 0;
+    while (j + count < numslots && slots[j + count].cy == slots[j].cy) {
+      count++;
+    }
+    if (slots[j].cy < E.buf->numrows) {
+      erow *row = &E.buf->row[slots[j].cy];
+      for (int k = j; k < j + count; k++) {
+        int cx = slots[k].cx - KILO_SIGN_COLUMN;
+        if (cx == 0) {
+          continue;
+        }
+        edits[n].at = editorRowPrevCx(row, cx);
+        edits[n].del = cx - edits[n].at;
+        edits[n].s = NULL;
+        edits[n].len = 0;
+        n++;
+      }
+    }
+
+    // a cursor at the start of the row is the first of its row, the others
+    // are the ones edited
+    int first = (n < count) ? j + 1 : j;
+    if (n > 0) {
+      editorCursorsEditRow(edits, first, n);
+    }
+    j += count;
+  }
+  free(edits);
+
+  // rows whose cursor is at their start are joined to the rows above, the
+  // cursors on them move by the length of what they are joined to
+  int *rows = malloc(sizeof(int) * numslots);
+  int *offset = malloc(sizeof(int) * numslots);
+  if (rows == NULL || offset == NULL) {
+    free(rows);
+    free(offset);
+    editorCursorsScatter();
+    return;
+  }
+  int n = 0;
+  for (int j = 0; j < numslots; j++) {
+    int cy = slots[j].cy;
+    if (slots[j].cx != KILO_SIGN_COLUMN || cy == 0 || cy >= E.buf->numrows) {
+      continue;
+    }
+    offset[n] = E.buf->row[cy - 1].size;
+    if (n > 0 && rows[n - 1] == cy - 1) {
+      offset[n] += offset[n - 1];
+    }
+    rows[n++] = cy;
+  }
+
+  int k = 0;
+  for (int j = 0; j < numslots; j++) {
+    while (k < n && rows[k] < slots[j].cy) {
+      k++;
+    }
+    if (k < n && rows[k] == slots[j].cy) {
+      slots[j].cx += offset[k];
+      slots[j].cy -= k + 1;
+    } else {
+      slots[j].cy -= k;
+    }
+  }
+  editorRowJoinMany(rows, n);
+  free(rows);
+  free(offset);
+
+  editorCursorsScatter();
+}
+
+/***
+ * Splits the row at every cursor, the row array is moved once
+ */
+void editorCursorsInsertNewLine() {
+  if (editorCursorsGather() == -1) {
+    return;
+  }
+
+  // a cursor past the last row only adds an empty row
+  int n = numslots;
+  if (slots[n - 1].cy == E.buf->numrows) {
+    editorInsertRow(E.buf->numrows, "", 0);
+    slots[n - 1].cy++;
+    n--;
+  }
+
+  struct editorRowPos *at = malloc(sizeof(*at) * (n + 1));
+  if (at == NULL) {
+    return;
+  }
+  for (int j = 0; j < n; j++) {
+    at[j].row = slots[j].cy;
+    at[j].at = slots[j].cx - KILO_SIGN_COLUMN;
+  }
+
+  if (editorRowSplitMany(at, n) == 0) {
+    for (int j = 0; j < n; j++) {
+      slots[j].cy += j + 1;
+      slots[j].cx = KILO_SIGN_COLUMN;
+    }
+    if (n < numslots) {
+      slots[numslots - 1].cy += n;
+    }
+  }
+  free(at);
+
+  editorCursorsScatter();
+}
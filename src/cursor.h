@@ -0,0 +1,14 @@
+#ifndef CURSOR_H_
+#define CURSOR_H_
+
+#include "typedefs.h"
+
+int editorCursorAddBelow();
+void editorCursorsClear();
+const struct editorCursor *editorCursorsOnRow(int cy, int *count);
+void editorCursorsMove(int key, int count);
+void editorCursorsInsertChar(int c);
+void editorCursorsDelChar();
+void editorCursorsInsertNewLine();
+
+#endif // !#ifndef CURSOR_H_
@@ -0,0 +1,459 @@
+#include "diff.h"
+#include "file.h"
+#include "input.h"
+#include "row.h"
+#include "window.h"
+#include <limits.h>
+
+struct editorDiffView {
+  uint64_t *disk; // hash of every line of the file on disk
+  int ndisk;
+  struct timespec mtime; // of the file the hashes were taken from
+  off_t size;
+
+  unsigned char *marks; // one per row, 0 when unchanged
+  int nmarks;
+  int seen; // the dirty count the marks were computed for, -1 for never
+};
+
+struct editorDiffState {
+  const uint64_t *a;
+  const uint64_t *b;
+  struct editorDiffHunk *hunks;
+  int numhunks;
+  int cap;
+  int failed;
+};
+
+/***
+ * Records that a.. was replaced by b.., merging it with the previous hunk
+ * when they touch
+ */
+static void editorDiffEmit(struct editorDiffState *st, int a, int alen, int b,
+                           int blen) {
+  if (alen == 0 && blen == 0) {
+    return;
+  }
+
+  if (st->numhunks > 0) {
+    struct editorDiffHunk *last = &st->hunks[st->numhunks - 1];
+    if (last->a + last->alen == a && last->b + last->blen == b) {
+      last->alen += alen;
+      last->blen += blen;
+      return;
+    }
+  }
+
+  if (st->numhunks == st->cap) {
+    int cap = st->cap ? st->cap * 2 : 16;
+    struct editorDiffHunk *new =
+        realloc(st->hunks, sizeof(struct editorDiffHunk) * cap);
+    if (new == NULL) {
+      st->failed = 1;
+      return;
+    }
+    st->hunks = new;
+    st->cap = cap;
+  }
+
+  struct editorDiffHunk *h = &st->hunks[st->numhunks++];
+  h->a = a;
+  h->alen = alen;
+  h->b = b;
+  h->blen = blen;
+}
+
+static void editorDiffRange(struct editorDiffState *st, int a0, int a1, int b0,
+                            int b1);
+
+/***
+ * Finds the middle of the shortest edit script between two ranges and
+ * diffs both halves
+ *
+ * This is Myers' linear space refinement: the forward and the reverse
+ * searches run towards each other and only keep one diagonal vector each.
+ * When the script would cost more than KILO_DIFF_MAX_COST the whole range
+ * is reported as replaced.
+ */
+static void editorDiffBisect(struct editorDiffState *st, int a0, int a1,
+                             int b0, int b1) {
+  const uint64_t *a = st->a + a0;
+  const uint64_t *b = st->b + b0;
+  int n = a1 - a0;
+  int m = b1 - b0;
+
+  int maxd = (n + m + 1) / 2;
+  if (maxd > KILO_DIFF_MAX_COST) {
+    maxd = KILO_DIFF_MAX_COST;
+  }
+  int off = maxd + 1;
+  int vlen = 2 * off + 1;
+  int *v1 = malloc(sizeof(int) * vlen);
+  int *v2 = malloc(sizeof(int) * vlen);
+  if (v1 == NULL || v2 == NULL) {
+    free(v1);
+    free(v2);
+    st->failed = 1;
+    return;
+  }
+  for (int j = 0; j < vlen; j++) {
+    v1[j] = -1;
+    v2[j] = -1;
+  }
+  v1[off + 1] = 0;
+  v2[off + 1] = 0;
+
+  int delta = n - m;
+  int front = (delta % 2 != 0);
+  int k1start = 0, k1end = 0, k2start = 0, k2end = 0;
+
+  for (int d = 0; d < maxd; d++) {
+    for (int k1 = -d + k1start; k1 <= d - k1end; k1 += 2) {
+      int k1off = off + k1;
+      int x1 = (k1 == -d || (k1 != d && v1[k1off - 1] < v1[k1off + 1]))
+                   ? v1[k1off + 1]
+                   : v1[k1off - 1] + 1;
+      int y1 = x1 - k1;
+      while (x1 < n && y1 < m && a[x1] == b[y1]) {
+        x1++;
+        y1++;
+      }
+      v1[k1off] = x1;
+
+      if (x1 > n) {
+        k1end += 2;
+      } else if (y1 > m) {
+        k1start += 2;
+      } else if (front) {
+        int k2off = off + delta - k1;
+        if (k2off >= 0 && k2off < vlen && v2[k2off] != -1 &&
+            x1 >= n - v2[k2off]) {
+          free(v1);
+          free(v2);
+          editorDiffRange(st, a0, a0 + x1, b0, b0 + y1);
+          editorDiffRange(st, a0 + x1, a1, b0 + y1, b1);
+          return;
+        }
+      }
+    }
+
+    for (int k2 = -d + k2start; k2 <= d - k2end; k2 += 2) {
+      int k2off = off + k2;
+      int x2 = (k2 == -d || (k2 != d && v2[k2off - 1] < v2[k2off + 1]))
+                   ? v2[k2off + 1]
+                   : v2[k2off - 1] + 1;
+      int y2 = x2 - k2;
+      while (x2 < n && y2 < m && a[n - x2 - 1] == b[m - y2 - 1]) {
+        x2++;
+        y2++;
+      }
+      v2[k2off] = x2;
+
+      if (x2 > n) {
+        k2end += 2;
+      } else if (y2 > m) {
+        k2start += 2;
+      } else if (!front) {
+        int k1off = off + delta - k2;
+        if (k1off >= 0 && k1off < vlen && v1[k1off] != -1) {
+          int x1 = v1[k1off];
+          int y1 = off + x1 - k1off;
+          if (x1 >= n - x2) {
+            free(v1);
+            free(v2);
+            editorDiffRange(st, a0, a0 + x1, b0, b0 + y1);
+            editorDiffRange(st, a0 + x1, a1, b0 + y1, b1);
+            return;
+          }
+        }
+      }
+    }
+  }
+
+  free(v1);
+  free(v2);
+  editorDiffEmit(st, a0, n, b0, m);
+}
+
+/***
+ * Diffs a range after stripping what it starts and ends with in common
+ */
+static void editorDiffRange(struct editorDiffState *st, int a0, int a1, int b0,
+                            int b1) {
+  while (a0 < a1 && b0 < b1 && st->a[a0] == st->b[b0]) {
+    a0++;
+    b0++;
+  }
+
+  int a2 = a1, b2 = b1;
+  while (a2 > a0 && b2 > b0 && st->a[a2 - 1] == st->b[b2 - 1]) {
+    a2--;
+    b2--;
+  }
+
+  if (a0 == a2 || b0 == b2) {
+    editorDiffEmit(st, a0, a2 - a0, b0, b2 - b0);
+  } else if (!st->failed) {
+    editorDiffBisect(st, a0, a2, b0, b2);
+  }
+}
+
+/***
+ * Computes the changes that turn one sequence of line hashes into another
+ *
+ * @param *a The old lines
+ * @param n The number of old lines
+ * @param *b The new lines
+ * @param m The number of new lines
+ * @param **hunks Where to store the changes, in order, to be freed
+ * @return the number of hunks, -1 if out of memory
+ */
+int editorDiff(const uint64_t *a, int n, const uint64_t *b, int m,
+               struct editorDiffHunk **hunks) {
+  struct editorDiffState st = {a, b, NULL, 0, 0, 0};
+  editorDiffRange(&st, 0, n, 0, m);
+
+  if (st.failed) {
+    free(st.hunks);
+    *hunks = NULL;
+    return -1;
+  }
+  *hunks = st.hunks;
+  return st.numhunks;
+}
+
+/***
+ * Splits text in lines the way rows are made and hashes them
+ *
+ * @param *data The text
+ * @param len The length of the text
+ * @param **hashes Where to store the hash of every line, to be freed
+ * @param **offsets Where to store where every line starts, plus len at the
+ * end, to be freed, NULL if not wanted
+ * @return the number of lines, -1 if out of memory
+ */
+int editorDiffLines(char *data, size_t len, uint64_t **hashes,
+                    size_t **offsets) {
+  int lines = 0;
+  for (char *p = data; p && (p = memchr(p, '\n', data + len - p)) != NULL;
+       p++) {
+    lines++;
+  }
+  if (len > 0 && data[len - 1] != '\n') {
+    lines++;
+  }
+
+  *hashes = malloc(sizeof(uint64_t) * (lines + 1));
+  size_t *starts = offsets ? malloc(sizeof(size_t) * (lines + 1)) : NULL;
+  if (*hashes == NULL || (offsets && starts == NULL)) {
+    free(*hashes);
+    free(starts);
+    return -1;
+  }
+
+  size_t pos = 0;
+  for (int j = 0; j < lines; j++) {
+    char *nl = memchr(&data[pos], '\n', len - pos);
+    size_t end = nl ? (size_t)(nl - data) : len;
+    size_t linelen = end - pos;
+    while (linelen > 0 && data[pos + linelen - 1] == '\r') {
+      linelen--;
+    }
+
+    (*hashes)[j] = editorRowHash(&data[pos], linelen);
+    if (starts) {
+      starts[j] = pos;
+    }
+    pos = nl ? end + 1 : len;
+  }
+
+  if (offsets) {
+    starts[lines] = len;
+    *offsets = starts;
+  }
+  return lines;
+}
+
+/***
+ * Gathers the hashes kept in the rows of a buffer
+ *
+ * @param *buf The buffer
+ * @return one hash per row, to be freed, NULL if out of memory
+ */
+uint64_t *editorDiffRowHashes(struct editorBuffer *buf) {
+  uint64_t *hashes = malloc(sizeof(uint64_t) * (buf->numrows + 1));
+  if (hashes == NULL) {
+    return NULL;
+  }
+  for (int j = 0; j < buf->numrows; j++) {
+    hashes[j] = buf->row[j].hash;
+  }
+  return hashes;
+}
+
+/***
+ * Hashes the file of a buffer as it is on disk
+ *
+ * @return 0 on success, -1 if the file can't be read
+ */
+static int editorDiffReadDisk(struct editorBuffer *buf,
+                              struct editorDiffView *view) {
+  struct editorFileData file;
+  if (editorFileLoad(buf->filename, &file) == -1) {
+    return -1;
+  }
+
+  uint64_t *hashes;
+  int n = editorDiffLines(file.data, file.len, &hashes, NULL);
+  editorFileUnload(&file);
+  if (n == -1) {
+    return -1;
+  }
+
+  free(view->disk);
+  view->disk = hashes;
+  view->ndisk = n;
+  view->mtime = buf->disk.st_mtim;
+  view->size = buf->disk.st_size;
+  view->seen = -1;
+  return 0;
+}
+
+/***
+ * Brings the change marks of a buffer in diff mode up to date
+ *
+ * The file on disk is hashed again only after it was saved or reloaded,
+ * edits only cost a pass over the row hashes, which editorUpdateRow keeps
+ *
+ * @param *buf The buffer
+ */
+void editorDiffUpdate(struct editorBuffer *buf) {
+  struct editorDiffView *view = buf->diff;
+  if (view == NULL) {
+    return;
+  }
+
+  if (view->mtime.tv_sec != buf->disk.st_mtim.tv_sec ||
+      view->mtime.tv_nsec != buf->disk.st_mtim.tv_nsec ||
+      view->size != buf->disk.st_size) {
+    if (editorDiffReadDisk(buf, view) == -1) {
+      return;
+    }
+  }
+  if (view->seen == buf->dirty && view->nmarks == buf->numrows) {
+    return;
+  }
+
+  uint64_t *rows = editorDiffRowHashes(buf);
+  unsigned char *marks = calloc(buf->numrows + 1, 1);
+  struct editorDiffHunk *hunks = NULL;
+  int numhunks = (rows && marks) ? editorDiff(view->disk, view->ndisk, rows,
+                                              buf->numrows, &hunks)
+                                 : -1;
+  free(rows);
+  if (numhunks == -1) {
+    free(marks);
+    return;
+  }
+
+  for (int j = 0; j < numhunks; j++) {
+    struct editorDiffHunk *h = &hunks[j];
+    for (int k = 0; k < h->blen; k++) {
+      marks[h->b + k] = (k < h->alen) ? '~' : '+';
+    }
+    if (h->blen == 0 && buf->numrows > 0) {
+      // lines removed below a row, or above the first one
+      int at = (h->b > 0) ? h->b - 1 : 0;
+      if (at >= buf->numrows) {
+        at = buf->numrows - 1;
+      }
+      if (marks[at] == 0) {
+        marks[at] = '-';
+      }
+    }
+  }
+  free(hunks);
+
+  // repaint only the rows whose mark changed
+  for (int j = 0; j < buf->numrows; j++) {
+    int old = (j < view->nmarks) ? view->marks[j] : 0;
+    if (old != marks[j]) {
+      editorWindowDamage(buf, j, j);
+    }
+  }
+
+  free(view->marks);
+  view->marks = marks;
+  view->nmarks = buf->numrows;
+  view->seen = buf->dirty;
+}
+
+/***
+ * Tells how a row differs from the file on disk
+ *
+ * @param *buf The buffer
+ * @param row The row index
+ * @return '+' for an added row, '~' for a changed one, '-' when rows were
+ * removed below it, 0 otherwise
+ */
+int editorDiffMark(struct editorBuffer *buf, int row) {
+  struct editorDiffView *view = buf->diff;
+  if (view == NULL || row < 0 || row >= view->nmarks) {
+    return 0;
+  }
+  return view->marks[row];
+}
+
+/***
+ * Leaves diff mode
+ *
+ * @param *buf The buffer
+ */
+void editorDiffStop(struct editorBuffer *buf) {
+  struct editorDiffView *view = buf->diff;
+  if (view == NULL) {
+    return;
+  }
+
+  free(view->disk);
+  free(view->marks);
+  free(view);
+  buf->diff = NULL;
+  editorWindowDamage(buf, 0, INT_MAX);
+}
+
+/***
+ * Shows or hides the changes of the current buffer in the sign column
+ */
+void editorDiffToggle() {
+  if (E.buf->diff != NULL) {
+    editorDiffStop(E.buf);
+    editorSetStatusMessage("Diff off");
+    return;
+  }
+
+  if (E.buf->filename == NULL || E.buf->loader != NULL ||
+      E.buf->follow != NULL) {
+    editorSetStatusMessage("Can't diff a buffer without a file, still "
+                           "loading or followed");
+    return;
+  }
+
+  struct editorDiffView *view = calloc(1, sizeof(struct editorDiffView));
+  if (view == NULL || editorDiffReadDisk(E.buf, view) == -1) {
+    editorSetStatusMessage("Can't diff '%s': %s", E.buf->filename,
+                           strerror(errno));
+    free(view);
+    return;
+  }
+  E.buf->diff = view;
+  editorDiffUpdate(E.buf);
+
+  int added = 0, changed = 0;
+  for (int j = 0; j < view->nmarks; j++) {
+    added += (view->marks[j] == '+');
+    changed += (view->marks[j] == '~');
+  }
+  editorSetStatusMessage("Diff against disk: %d added, %d changed", added,
+                         changed);
+}
@@ -0,0 +1,22 @@
+#ifndef DIFF_H_
+#define DIFF_H_
+
+#include "typedefs.h"
+
+// lines a..a+alen of the old version became b..b+blen of the new one
+struct editorDiffHunk {
+  int a, alen;
+  int b, blen;
+};
+
+int editorDiff(const uint64_t *a, int n, const uint64_t *b, int m,
+               struct editorDiffHunk **hunks);
+int editorDiffLines(char *data, size_t len, uint64_t **hashes,
+                    size_t **offsets);
+uint64_t *editorDiffRowHashes(struct editorBuffer *buf);
+void editorDiffToggle();
+void editorDiffUpdate(struct editorBuffer *buf);
+int editorDiffMark(struct editorBuffer *buf, int row);
+void editorDiffStop(struct editorBuffer *buf);
+
+#endif // !#ifndef DIFF_H_
@@ -1,35 +1,57 @@
 #include "editor.h"
+#include "cursor.h"
 #include "row.h"
 #include "typedefs.h"
 
 /***
- * Inserts a character into the current row
+ * Inserts a character into the current row, or at every cursor
  *
- * @param c The character to insert
+ * @param c The codepoint to insert
  */
 void editorInsertChar(int c) {
-  if (E.cy == E.numrows) {
-    editorInsertRow(E.numrows, "", 0);
+  if (E.buf->numcursors > 0) {
+    editorCursorsInsertChar(c);
+    return;
+  }
+  if (E.cy == E.buf->numrows) {
+    editorInsertRow(E.buf->numrows, "", 0);
   }
 
-  editorRowInsertChar(&E.row[E.cy], E.cx - KILO_SIGN_COLUMN, c);
-  E.cx++;
+  E.cx += editorRowInsertChar(&E.buf->row[E.cy], E.cx - KILO_SIGN_COLUMN, c);
 }
 
 /***
- * Inserts a new line
+ * Inserts a run of text without new lines into the current row
+ *
+ * @param *s The text
+ * @param len The length of the text
+ */
+void editorInsertText(const char *s, size_t len) {
+  if (E.cy == E.buf->numrows) {
+    editorInsertRow(E.buf->numrows, "", 0);
+  }
+
+  editorRowInsertBytes(&E.buf->row[E.cy], E.cx - KILO_SIGN_COLUMN, s, len);
+  E.cx += len;
+}
+
+/***
+ * Inserts a new line, or one at every cursor
  */
 void editorInsertNewLine() {
+  if (E.buf->numcursors > 0) {
+    editorCursorsInsertNewLine();
+    return;
+  }
   if (E.cx == KILO_SIGN_COLUMN) {
     editorInsertRow(E.cy, "", 0);
   } else {
-    erow *row = &E.row[E.cy];
+    erow *row = &E.buf->row[E.cy];
     editorInsertRow(E.cy + 1, &row->chars[E.cx - KILO_SIGN_COLUMN],
                     row->size - E.cx + KILO_SIGN_COLUMN);
-    row = &E.row[E.cy];
-    row->size = E.cx - KILO_SIGN_COLUMN;
-    row->chars[row->size] = '\0';
-    editorUpdateRow(row);
+    row = &E.buf->row[E.cy];
+    editorRowDelChars(row, E.cx - KILO_SIGN_COLUMN,
+                      row->size - E.cx + KILO_SIGN_COLUMN);
   }
 
   E.cy++;
@@ -37,23 +59,28 @@ void editorInsertNewLine() {
 }
 
 /***
- * Deletes a character from the current row
+ * Deletes a character from the current row, or before every cursor
  */
 void editorDelChar() {
-  if (E.cy == E.numrows) {
+  if (E.buf->numcursors > 0) {
+    editorCursorsDelChar();
+    return;
+  }
+  if (E.cy == E.buf->numrows) {
     return;
   }
   if (E.cx == KILO_SIGN_COLUMN && E.cy == 0) {
     return;
   }
 
-  erow *row = &E.row[E.cy];
+  erow *row = &E.buf->row[E.cy];
   if (E.cx > KILO_SIGN_COLUMN) {
-    editorRowDelChar(row, E.cx - KILO_SIGN_COLUMN - 1);
-    E.cx--;
+    int at = editorRowPrevCx(row, E.cx - KILO_SIGN_COLUMN);
+    editorRowDelChars(row, at, E.cx - KILO_SIGN_COLUMN - at);
+    E.cx = at + KILO_SIGN_COLUMN;
   } else {
-    E.cx = E.row[E.cy - 1].size + KILO_SIGN_COLUMN;
-    editorRowAppendString(&E.row[E.cy - 1], row->chars, row->size);
+    E.cx = E.buf->row[E.cy - 1].size + KILO_SIGN_COLUMN;
+    editorRowAppendString(&E.buf->row[E.cy - 1], row->chars, row->size);
     editorDelRow(E.cy);
     E.cy--;
   }
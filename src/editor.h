@@ -4,6 +4,7 @@
 #include "typedefs.h"
 
 void editorInsertChar(int c);
+void editorInsertText(const char *s, size_t len);
 void editorInsertNewLine();
 void editorDelChar();
 
@@ -0,0 +1,100 @@
+#include "event.h"
+#include "writer.h"
+#include <poll.h>
+
+struct editorEvent {
+  int fd;
+  editorEventHandler handler;
+  void *arg;
+};
+
+static struct editorEvent *events = NULL;
+static int numevents = 0;
+
+/***
+ * Registers a file descriptor to watch while waiting for keys
+ *
+ * @param fd The file descriptor to poll for input
+ * @param handler The function called when fd is readable
+ * @param *arg Passed to the handler
+ * @return 0 on success, -1 on failure
+ */
+int editorEventAdd(int fd, editorEventHandler handler, void *arg) {
+  struct editorEvent *new =
+      realloc(events, sizeof(struct editorEvent) * (numevents + 1));
+  if (new == NULL) {
+    return -1;
+  }
+
+  events = new;
+  events[numevents].fd = fd;
+  events[numevents].handler = handler;
+  events[numevents].arg = arg;
+  numevents++;
+  return 0;
+}
+
+/***
+ * Stops watching a file descriptor
+ *
+ * @param fd The file descriptor
+ */
+void editorEventRemove(int fd) {
+  for (int j = 0; j < numevents; j++) {
+    if (events[j].fd == fd) {
+      memmove(&events[j], &events[j + 1],
+              sizeof(struct editorEvent) * (numevents - j - 1));
+      numevents--;
+      return;
+    }
+  }
+}
+
+/***
+ * Waits until a key can be read, dispatching other events meanwhile
+ *
+ * @param timeout The maximum time to wait in milliseconds, -1 to block
+ * @return 1 when stdin is readable, 0 when the wait ended for any other reason
+ */
+int editorEventWait(int timeout) {
+  int n = numevents + 1;
+  struct pollfd fds[n + 1];
+
+  fds[0].fd = STDIN_FILENO;
+  fds[0].events = POLLIN;
+  for (int j = 0; j < numevents; j++) {
+    fds[j + 1].fd = events[j].fd;
+    fds[j + 1].events = POLLIN;
+  }
+
+  // the rest of a frame the terminal didn't take yet
+  int output = editorWriterPending();
+  if (output) {
+    fds[n].fd = STDOUT_FILENO;
+    fds[n].events = POLLOUT;
+  }
+
+  if (poll(fds, n + output, timeout) <= 0) {
+    return 0;
+  }
+
+  if (output && (fds[n].revents & (POLLOUT | POLLHUP | POLLERR)) &&
+      editorWriterWritable()) {
+    return 0;
+  }
+
+  // handlers may register or remove events, so match them by descriptor
+  for (int j = 1; j < n; j++) {
+    if (!(fds[j].revents & (POLLIN | POLLHUP | POLLERR))) {
+      continue;
+    }
+    for (int k = 0; k < numevents; k++) {
+      if (events[k].fd == fds[j].fd) {
+        events[k].handler(events[k].fd, events[k].arg);
+        break;
+      }
+    }
+  }
+
+  return (fds[0].revents & POLLIN) != 0;
+}
@@ -0,0 +1,12 @@
+#ifndef EVENT_H_
+#define EVENT_H_
+
+#include "typedefs.h"
+
+typedef void (*editorEventHandler)(int fd, void *arg);
+
+int editorEventAdd(int fd, editorEventHandler handler, void *arg);
+void editorEventRemove(int fd);
+int editorEventWait(int timeout);
+
+#endif // !#ifndef EVENT_H_
@@ -1,8 +1,15 @@
 #include "file.h"
+#include "compress.h"
+#include "diff.h"
 #include "input.h"
+#include "journal.h"
+#include "loader.h"
 #include "row.h"
+#include "rowcache.h"
 #include "syntax.h"
 #include "terminal.h"
+#include "watch.h"
+#include <sys/mman.h>
 
 /***
  * converts rows to a string
@@ -13,17 +20,17 @@
  */
 char *editorRowsToString(int *buflen) {
   int totlen = 0;
-  for (int j = 0; j < E.numrows; j++) {
-    totlen += E.row[j].size + 1;
+  for (int j = 0; j < E.buf->numrows; j++) {
+    totlen += E.buf->row[j].size + 1;
   }
   *buflen = totlen;
 
   char *buf = malloc(totlen);
   char *p = buf;
 
-  for (int j = 0; j < E.numrows; j++) {
-    memcpy(p, E.row[j].chars, E.row[j].size);
-    p += E.row[j].size;
+  for (int j = 0; j < E.buf->numrows; j++) {
+    memcpy(p, E.buf->row[j].chars, E.buf->row[j].size);
+    p += E.buf->row[j].size;
     *p = '\n';
     p++;
   }
@@ -35,69 +42,410 @@ char *editorRowsToString(int *buflen) {
  * Reads a file into a buffer
  *
  * @param filename The name of the file to open
+ * @return 0 on success, -1 if the file can't be opened
  */
-void editorOpen(char *filename) {
-  FILE *fp = fopen(filename, "r");
-  if (!fp) {
-    die("editorOpen: fopen");
+int editorOpen(char *filename) {
+  int fd = open(filename, O_RDONLY);
+  if (fd == -1) {
+    return -1;
+  }
+
+  // big and compressed files are read on a thread so the editor shows up
+  // right away, compressed ones are inflated on the fly by the stream
+  struct stat st;
+  int compression = editorCompressionDetect(fd);
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) &&
+      (st.st_size >= KILO_LOAD_ASYNC || compression != COMPRESS_NONE)) {
+    E.buf->filename = strdup(filename);
+    E.buf->compression = compression;
+    E.buf->disk = st;
+    editorSelectSyntaxHighlight();
+
+    // a file seen before comes with its rows already measured
+    struct editorRowCache *cache = editorRowCacheOpen(E.buf, fd);
+    struct editorStream *in = editorStreamOpen(fd, compression);
+    if (in == NULL) {
+      int saved = errno;
+      editorRowCacheClose(cache);
+      close(fd);
+      errno = saved;
+      return -1;
+    }
+    if (editorLoaderStart(E.buf, in, st.st_size, cache) == -1) {
+      editorRowCacheClose(cache);
+      editorStreamClose(in);
+      errno = ENOMEM;
+      return -1;
+    }
+
+    editorWatchAdd(E.buf);
+    editorSetStatusMessage("Loading \"%s\"...", filename);
+
+    // the edits of a crashed session go onto the whole file, before any new
+    // one, so the file is read to the end first
+    if (editorJournalPending(E.buf)) {
+      editorLoaderWait(E.buf);
+    }
+    return 0;
   }
 
-  E.filename = strdup(filename);
+  E.buf->filename = strdup(filename);
   editorSelectSyntaxHighlight();
 
+  FILE *fp = fdopen(fd, "r");
+  if (!fp) {
+    close(fd);
+    return -1;
+  }
+
   char *line = NULL;
   size_t linecap = 0;
   ssize_t linelen;
 
   while ((linelen = getline(&line, &linecap, fp)) != -1) {
-    while (linelen > 0 &&
-           (line[linelen - 1] == '\n' || line[linelen - 1] == '\r')) {
-      linelen--;
-    }
-
-    editorInsertRow(E.numrows, line, linelen);
+    editorAppendLines(line, linelen);
   }
 
   free(line);
   fclose(fp);
 
-  E.dirty = 0;
+  E.buf->dirty = 0;
+  editorFileStamp(E.buf);
+  editorWatchAdd(E.buf);
+  editorJournalRecover(E.buf);
+  return 0;
+}
+
+/***
+ * Remembers the identity and modification time of a buffer's file
+ *
+ * @param *buf The buffer
+ */
+void editorFileStamp(struct editorBuffer *buf) {
+  if (buf->filename == NULL || stat(buf->filename, &buf->disk) == -1) {
+    memset(&buf->disk, 0, sizeof(buf->disk));
+  }
+}
+
+/***
+ * Checks whether a buffer's file was changed by someone else since it was
+ * last read or written
+ *
+ * @param *buf The buffer
+ * @return 1 if the file on disk is not the one the buffer was made from
+ */
+int editorFileChanged(struct editorBuffer *buf) {
+  struct stat st;
+  if (buf->filename == NULL || stat(buf->filename, &st) == -1) {
+    // nothing to overwrite
+    return 0;
+  }
+
+  return st.st_dev != buf->disk.st_dev || st.st_ino != buf->disk.st_ino ||
+         st.st_size != buf->disk.st_size ||
+         st.st_mtim.tv_sec != buf->disk.st_mtim.tv_sec ||
+         st.st_mtim.tv_nsec != buf->disk.st_mtim.tv_nsec;
+}
+
+/***
+ * Reads a whole file uncompressed into memory
+ *
+ * Plain files are mapped rather than copied
+ *
+ * @param *filename The name of the file
+ * @param *file Where to store the contents and how the file is stored
+ * @return 0 on success, -1 if the file can't be read
+ */
+int editorFileLoad(char *filename, struct editorFileData *file) {
+  file->data = NULL;
+  file->len = 0;
+  file->mapped = 0;
+
+  int fd = open(filename, O_RDONLY);
+  if (fd == -1 || fstat(fd, &file->st) == -1) {
+    if (fd != -1) {
+      close(fd);
+    }
+    return -1;
+  }
+  file->compression = editorCompressionDetect(fd);
+
+  if (file->compression == COMPRESS_NONE) {
+    if (file->st.st_size > 0) {
+      file->data =
+          mmap(NULL, file->st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (file->data == MAP_FAILED) {
+        file->data = NULL;
+        close(fd);
+        return -1;
+      }
+      file->len = file->st.st_size;
+      file->mapped = 1;
+    }
+    close(fd);
+    return 0;
+  }
+
+  struct editorStream *in = editorStreamOpen(fd, file->compression);
+  if (in == NULL) {
+    close(fd);
+    return -1;
+  }
+
+  size_t cap = 0;
+  ssize_t n;
+  do {
+    if (cap - file->len < KILO_LOAD_CHUNK) {
+      cap = cap ? cap * 2 : 4 * KILO_LOAD_CHUNK;
+      char *new = realloc(file->data, cap);
+      if (new == NULL) {
+        n = -1;
+        break;
+      }
+      file->data = new;
+    }
+
+    n = editorStreamRead(in, file->data + file->len, KILO_LOAD_CHUNK);
+    if (n > 0) {
+      file->len += n;
+    }
+  } while (n > 0);
+  editorStreamClose(in);
+
+  if (n == -1) {
+    editorFileUnload(file);
+    return -1;
+  }
+  return 0;
+}
+
+/***
+ * Releases the contents read by editorFileLoad
+ *
+ * @param *file The contents
+ */
+void editorFileUnload(struct editorFileData *file) {
+  if (file->mapped) {
+    munmap(file->data, file->len);
+  } else {
+    free(file->data);
+  }
+  file->data = NULL;
+  file->len = 0;
+}
+
+/***
+ * Reads the current buffer's file again, keeping the rows that did not
+ * change
+ *
+ * The rows and the new lines are diffed by hash, only the changed ranges
+ * are replaced and highlighted again
+ *
+ * @return the number of rows replaced, -1 if the file can't be read
+ */
+int editorReload() {
+  if (E.buf->filename == NULL || E.buf->loader != NULL) {
+    return -1;
+  }
+
+  struct editorFileData file;
+  if (editorFileLoad(E.buf->filename, &file) == -1) {
+    return -1;
+  }
+
+  uint64_t *hashes = NULL;
+  size_t *offsets = NULL;
+  uint64_t *rows = editorDiffRowHashes(E.buf);
+  struct editorDiffHunk *hunks = NULL;
+  int numhunks = -1;
+
+  int lines = rows ? editorDiffLines(file.data, file.len, &hashes, &offsets)
+                   : -1;
+  if (lines != -1) {
+    numhunks = editorDiff(rows, E.buf->numrows, hashes, lines, &hunks);
+  }
+  free(rows);
+  free(hashes);
+  if (numhunks == -1) {
+    free(offsets);
+    editorFileUnload(&file);
+    errno = ENOMEM;
+    return -1;
+  }
+
+  // from the bottom up so the row numbers of the hunks stay valid
+  int changed = 0;
+  for (int j = numhunks - 1; j >= 0; j--) {
+    struct editorDiffHunk *h = &hunks[j];
+    size_t from = offsets[h->b];
+    size_t to = offsets[h->b + h->blen];
+    editorReplaceRows(h->a, h->alen, &file.data[from], to - from);
+    changed += (h->alen > h->blen) ? h->alen : h->blen;
+  }
+
+  free(hunks);
+  free(offsets);
+  editorFileUnload(&file);
+
+  E.buf->compression = file.compression;
+  E.buf->disk = file.st;
+  E.buf->dirty = 0;
+  editorJournalDiscard(E.buf);
+  return changed;
 }
 
 /***
  * Writes the current file to disk
  */
 void editorSave() {
-  if (E.filename == NULL) {
-    E.filename = editorPrompt("Save as: %s", NULL);
-    if (E.filename == NULL) {
+  if (E.buf->loader != NULL) {
+    editorSetStatusMessage("Can't save while the file is still loading");
+    return;
+  }
+
+  if (editorFileChanged(E.buf)) {
+    char *answer =
+        editorPrompt("File changed on disk since it was read, overwrite? "
+                     "(y/N) %s",
+                     NULL);
+    int overwrite = answer && (answer[0] == 'y' || answer[0] == 'Y');
+    free(answer);
+    if (!overwrite) {
+      editorSetStatusMessage("Save aborted");
+      return;
+    }
+  }
+
+  if (E.buf->filename == NULL) {
+    E.buf->filename = editorPrompt("Save as: %s", NULL);
+    if (E.buf->filename == NULL) {
       editorSetStatusMessage("Save aborted");
       return;
     }
 
+    E.buf->compression = editorCompressionFor(E.buf->filename);
     editorSelectSyntaxHighlight();
   }
 
-  int len;
-  char *buf = editorRowsToString(&len);
-
   // O_RDWR = open for reading and writing
   // O_CREAT = create the file if it doesn't exist
   // 0644 = rw-r--r--
-  int fd = open(E.filename, O_RDWR | O_CREAT, 0644);
-  if (fd != 1) {
-    if (ftruncate(fd, len) != -1) {
-      if (write(fd, buf, len) != -1) {
-        close(fd);
-        free(buf);
-        editorSetStatusMessage("%d bytes written to '%s'", len, E.filename);
-        E.dirty = 0;
-        return;
-      }
+  int fd = open(E.buf->filename, O_RDWR | O_CREAT, 0644);
+  if (fd == -1) {
+    editorSetStatusMessage("Can't save! I/O error: %s", strerror(errno));
+    return;
+  }
+
+  if (E.buf->compression != COMPRESS_NONE) {
+    // the compressed size is only known once written, so trim afterwards
+    ssize_t len = editorCompressWrite(fd, E.buf->compression);
+    if (len != -1 && ftruncate(fd, len) != -1) {
+      close(fd);
+      editorSetStatusMessage("%zd bytes written to '%s'", len,
+                             E.buf->filename);
+      E.buf->dirty = 0;
+      editorFileStamp(E.buf);
+      editorWatchAdd(E.buf);
+      editorJournalDiscard(E.buf);
+      return;
     }
 
+    int saved = errno;
     close(fd);
+    editorSetStatusMessage("Can't save! I/O error: %s", strerror(saved));
+    return;
+  }
+
+  int len;
+  char *buf = editorRowsToString(&len);
+
+  if (ftruncate(fd, len) != -1) {
+    if (write(fd, buf, len) != -1) {
+      close(fd);
+      free(buf);
+      editorSetStatusMessage("%d bytes written to '%s'", len,
+                             E.buf->filename);
+      E.buf->dirty = 0;
+      editorFileStamp(E.buf);
+      editorWatchAdd(E.buf);
+      editorJournalDiscard(E.buf);
+      return;
+    }
   }
+
+  close(fd);
   free(buf);
   editorSetStatusMessage("Can't save! I/O error: %s", strerror(errno));
 }
+
+/***
+ * Builds a name under the XDG base directories
+ *
+ * @param *env The XDG variable
+ * @param *fallback The directory under $HOME used when env is not set
+ * @param *sub The file or directory below the base
+ * @return the name, to be freed, NULL when neither variable is set
+ */
+char *editorFileXdgPath(const char *env, const char *fallback,
+                        const char *sub) {
+  const char *base = getenv(env);
+  const char *home = getenv("HOME");
+  char *path;
+
+  if (base && base[0] == '/') {
+    path = malloc(strlen(base) + strlen(sub) + 2);
+    if (path) {
+      sprintf(path, "%s/%s", base, sub);
+    }
+  } else if (home && home[0]) {
+    path = malloc(strlen(home) + strlen(fallback) + strlen(sub) + 3);
+    if (path) {
+      sprintf(path, "%s/%s/%s", home, fallback, sub);
+    }
+  } else {
+    path = NULL;
+  }
+  return path;
+}
+
+/***
+ * Reads a whole file
+ *
+ * @param *path The name of the file
+ * @param *len Filled with the length of the file
+ * @return the contents followed by a '\0', to be freed, NULL on error
+ */
+char *editorFileRead(const char *path, size_t *len) {
+  int fd = open(path, O_RDONLY);
+  if (fd == -1) {
+    return NULL;
+  }
+
+  char *data = NULL;
+  size_t cap = 0;
+  ssize_t n = -1;
+  *len = 0;
+  do {
+    // room is always left for the terminator
+    if (*len + 1 >= cap) {
+      cap = cap ? cap * 2 : 4096;
+      char *new = realloc(data, cap);
+      if (new == NULL) {
+        break;
+      }
+      data = new;
+    }
+    n = read(fd, &data[*len], cap - *len - 1);
+    if (n > 0) {
+      *len += n;
+    }
+  } while (n > 0 || (n == -1 && errno == EINTR));
+
+  close(fd);
+  if (n != 0) {
+    free(data);
+    return NULL;
+  }
+  data[*len] = '\0';
+  return data;
+}
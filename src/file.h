@@ -3,8 +3,25 @@
 
 #include "typedefs.h"
 
+// a whole file, uncompressed, as read by editorFileLoad
+struct editorFileData {
+  char *data;
+  size_t len;
+  int mapped;
+  int compression;
+  struct stat st;
+};
+
 char *editorRowsToString(int *buflen);
-void editorOpen(char *filename);
+int editorOpen(char *filename);
+void editorFileStamp(struct editorBuffer *buf);
+int editorFileChanged(struct editorBuffer *buf);
+int editorFileLoad(char *filename, struct editorFileData *file);
+void editorFileUnload(struct editorFileData *file);
+int editorReload();
 void editorSave();
+char *editorFileXdgPath(const char *env, const char *fallback,
+                        const char *sub);
+char *editorFileRead(const char *path, size_t *len);
 
 #endif // !#ifndef FILE_H_
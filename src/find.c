@@ -1,18 +1,16 @@
 #include "find.h"
 #include "input.h"
 #include "row.h"
+#include "trigram.h"
+#include "window.h"
 
 void editorFindCallback(char *query, int key) {
   static int last_match = -1;
   static int direction = 1;
 
-  static int saved_hl_line;
-  static char *saved_hl = NULL;
-
-  if (saved_hl) {
-    memcpy(E.row[saved_hl_line].hl, saved_hl, E.row[saved_hl_line].rsize);
-    free(saved_hl);
-    saved_hl = NULL;
+  if (E.buf->match_row != -1) {
+    editorWindowDamage(E.buf, E.buf->match_row, E.buf->match_row);
+    E.buf->match_row = -1;
   }
 
   if (key == '\x1b' || key == '\r') {
@@ -35,26 +33,39 @@ void editorFindCallback(char *query, int key) {
   }
   int current = last_match;
 
-  for (int i = 0; i < E.numrows; i++) {
+  for (int i = 0; i < E.buf->numrows; i++) {
     current += direction;
     if (current == -1) {
-      current = E.numrows - 1;
-    } else if (current == E.numrows) {
+      current = E.buf->numrows - 1;
+    } else if (current == E.buf->numrows) {
       current = 0;
     }
 
-    erow *row = &E.row[current];
+    // the rows the search index rules out are passed over a block at a time
+    int skip = editorTrigramSkip(query, current, direction);
+    if (skip > 0) {
+      if (skip > E.buf->numrows - i) {
+        skip = E.buf->numrows - i;
+      }
+      i += skip - 1;
+      current += direction * (skip - 1);
+      continue;
+    }
+
+    erow *row = &E.buf->row[current];
     char *match = strstr(row->render, query);
     if (match) {
       last_match = current;
       E.cy = current;
-      E.cx = editorRowRxToCx(row, match - row->render) + KILO_SIGN_COLUMN;
-      E.rowoff = E.numrows;
+      E.cx = editorRowRxToCx(row,
+                             editorRowRenderToRx(row, match - row->render)) +
+             KILO_SIGN_COLUMN;
+      E.rowoff = E.buf->numrows;
 
-      saved_hl_line = current;
-      saved_hl = malloc(row->rsize);
-      memcpy(saved_hl, row->hl, row->rsize);
-      memset(&row->hl[match - row->render], HL_MATCH, strlen(query));
+      E.buf->match_row = current;
+      E.buf->match_start = match - row->render;
+      E.buf->match_len = strlen(query);
+      editorWindowDamage(E.buf, current, current);
       return;
     }
   }
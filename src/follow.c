@@ -0,0 +1,239 @@
+#include "follow.h"
+#include "event.h"
+#include "input.h"
+#include "row.h"
+#include "window.h"
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+struct editorFollow {
+  struct editorBuffer *buf;
+  int fd;       // the followed file
+  int inotify;  // watches fd for appends
+  int wake[2];  // pokes the event loop when a read was cut short
+  off_t offset; // how much of the file is in the buffer
+  int partial;  // the last row is a line still being written
+  char *block;  // KILO_LOAD_CHUNK bytes to read into
+};
+
+/***
+ * Keeps the views that were on the last row on the last row
+ *
+ * @param *buf The buffer that grew or was emptied
+ * @param last The index of the last row before it grew
+ */
+static void editorFollowPin(struct editorBuffer *buf, int last) {
+  int bottom = (buf->numrows > 0) ? buf->numrows - 1 : 0;
+
+  if (E.buf == buf && E.cy >= last) {
+    E.cy = bottom;
+  }
+  for (int j = 0; j < E.numwindows; j++) {
+    struct editorWindow *win = E.windows[j];
+    if (win == E.win || win->buf != buf || win->cy < last) {
+      continue;
+    }
+    // only the active window is scrolled by editorScroll
+    win->cy = bottom;
+    if (win->rowoff < bottom - win->rows + 1) {
+      win->rowoff = bottom - win->rows + 1;
+    }
+    if (win->rowoff > bottom) {
+      win->rowoff = bottom;
+    }
+  }
+  if (!editorWindowShows(buf) && buf->cy >= last) {
+    buf->cy = bottom;
+  }
+}
+
+/***
+ * Appends newly written data to the buffer
+ *
+ * A line that is still being written is shown as it is and completed by
+ * the next read
+ *
+ * @param *fl The follow state
+ * @param len The number of bytes in fl->block
+ */
+static void editorFollowAppend(struct editorFollow *fl, size_t len) {
+  struct editorBuffer *buf = fl->buf;
+  char *data = fl->block;
+
+  if (fl->partial && buf->numrows > 0) {
+    char *nl = memchr(data, '\n', len);
+    size_t head = nl ? (size_t)(nl - data) : len;
+    erow *row = &buf->row[buf->numrows - 1];
+
+    // the \r of a \r\n is dropped like editorAppendLines does, it may have
+    // come with the read before
+    size_t keep = head;
+    while (nl && keep > 0 && data[keep - 1] == '\r') {
+      keep--;
+    }
+    editorRowAppendString(row, data, keep);
+    if (nl && keep == 0 && row->size > 0 && row->chars[row->size - 1] == '\r') {
+      editorRowDelChars(row, row->size - 1, 1);
+    }
+    editorWindowDamage(buf, buf->numrows - 1, buf->numrows - 1);
+
+    fl->partial = (nl == NULL);
+    size_t skip = nl ? head + 1 : head;
+    data += skip;
+    len -= skip;
+  }
+
+  if (len > 0) {
+    editorAppendLines(data, len);
+    fl->partial = (data[len - 1] != '\n');
+  }
+}
+
+/***
+ * Reads what was appended to the followed file since the last time
+ *
+ * @param fd The inotify or wake descriptor that fired
+ * @param *arg The follow state
+ */
+static void editorFollowRead(int fd, void *arg) {
+  struct editorFollow *fl = arg;
+  char drain[4096];
+  while (read(fd, drain, sizeof(drain)) > 0) {
+  }
+
+  struct editorBuffer *saved = E.buf;
+  E.buf = fl->buf;
+  int dirty = E.buf->dirty;
+
+  struct stat st;
+  int truncated = fstat(fl->fd, &st) == 0 && st.st_size < fl->offset;
+  if (truncated) {
+    // the log was truncated in place, its rows go and it is read again from
+    // its beginning
+    editorReplaceRows(0, E.buf->numrows, "", 0);
+    fl->offset = 0;
+    fl->partial = 0;
+    editorSetStatusMessage("\"%s\" was truncated", fl->buf->filename);
+  }
+  int last = E.buf->numrows - 1;
+
+  // stop after a few blocks so keys are still served under a fast writer
+  int blocks = 0;
+  ssize_t n;
+  while (blocks < KILO_LOAD_BATCH &&
+         (n = pread(fl->fd, fl->block, KILO_LOAD_CHUNK, fl->offset)) > 0) {
+    fl->offset += n;
+    editorFollowAppend(fl, n);
+    blocks++;
+  }
+  if (blocks == KILO_LOAD_BATCH) {
+    write(fl->wake[1], "f", 1);
+  }
+
+  E.buf->dirty = dirty;
+  E.buf = saved;
+
+  if (blocks > 0 || truncated) {
+    editorFollowPin(fl->buf, last < 0 ? 0 : last);
+  }
+}
+
+/***
+ * Starts streaming what gets appended to a buffer's file into it
+ *
+ * The buffer is assumed to hold the file as it is on disk now
+ *
+ * @param *buf The buffer
+ * @return 0 on success, -1 with the reason in the status message
+ */
+int editorFollowStart(struct editorBuffer *buf) {
+  if (buf->filename == NULL) {
+    editorSetStatusMessage("Can't follow a buffer without a file");
+    return -1;
+  }
+  if (buf->loader != NULL || buf->compression != COMPRESS_NONE) {
+    editorSetStatusMessage("Can't follow '%s' while it is loading or "
+                           "compressed",
+                           buf->filename);
+    return -1;
+  }
+
+  struct editorFollow *fl = malloc(sizeof(struct editorFollow));
+  if (fl == NULL) {
+    return -1;
+  }
+  fl->buf = buf;
+  fl->block = malloc(KILO_LOAD_CHUNK);
+  fl->fd = open(buf->filename, O_RDONLY);
+  fl->inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  fl->wake[0] = fl->wake[1] = -1;
+
+  struct stat st;
+  if (fl->block == NULL || fl->fd == -1 || fl->inotify == -1 ||
+      fstat(fl->fd, &st) == -1 ||
+      inotify_add_watch(fl->inotify, buf->filename, IN_MODIFY) == -1 ||
+      pipe(fl->wake) == -1) {
+    editorSetStatusMessage("Can't follow '%s': %s", buf->filename,
+                           strerror(errno));
+    buf->follow = fl;
+    editorFollowStop(buf);
+    return -1;
+  }
+  fcntl(fl->wake[0], F_SETFL, O_NONBLOCK);
+
+  fl->offset = st.st_size;
+  fl->partial = 0;
+  if (st.st_size > 0) {
+    char c;
+    fl->partial = pread(fl->fd, &c, 1, st.st_size - 1) == 1 && c != '\n';
+  }
+
+  editorEventAdd(fl->inotify, editorFollowRead, fl);
+  editorEventAdd(fl->wake[0], editorFollowRead, fl);
+  buf->follow = fl;
+  return 0;
+}
+
+/***
+ * Stops following a buffer's file
+ *
+ * @param *buf The buffer
+ */
+void editorFollowStop(struct editorBuffer *buf) {
+  struct editorFollow *fl = buf->follow;
+  if (fl == NULL) {
+    return;
+  }
+
+  if (fl->inotify != -1) {
+    editorEventRemove(fl->inotify);
+    close(fl->inotify);
+  }
+  if (fl->wake[0] != -1) {
+    editorEventRemove(fl->wake[0]);
+    close(fl->wake[0]);
+    close(fl->wake[1]);
+  }
+  if (fl->fd != -1) {
+    close(fl->fd);
+  }
+  free(fl->block);
+  free(fl);
+  buf->follow = NULL;
+}
+
+/***
+ * Turns follow mode on or off for the current buffer
+ */
+void editorFollowToggle() {
+  if (E.buf->follow != NULL) {
+    editorFollowStop(E.buf);
+    editorSetStatusMessage("Stopped following \"%s\"", E.buf->filename);
+    return;
+  }
+
+  if (editorFollowStart(E.buf) == 0) {
+    E.cy = E.buf->numrows > 0 ? E.buf->numrows - 1 : 0;
+    editorSetStatusMessage("Following \"%s\"", E.buf->filename);
+  }
+}
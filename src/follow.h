@@ -0,0 +1,10 @@
+#ifndef FOLLOW_H_
+#define FOLLOW_H_
+
+#include "typedefs.h"
+
+int editorFollowStart(struct editorBuffer *buf);
+void editorFollowStop(struct editorBuffer *buf);
+void editorFollowToggle();
+
+#endif // !#ifndef FOLLOW_H_
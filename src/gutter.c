@@ -0,0 +1,107 @@
+#include "gutter.h"
+#include "theme.h"
+
+#define GUTTER_SUFFIX "\x1b[m\x1b[39m \x1b[m"
+#define GUTTER_DIGITS (KILO_SIGN_COLUMN - 1)
+#define GUTTER_CELL                                                            \
+  (THEME_SEQ_MAX + GUTTER_DIGITS + sizeof(GUTTER_SUFFIX) - 1)
+
+// precomposed cells for a run of consecutive numbers
+struct editorGutterCache {
+  int first;
+  int count;
+  char cells[3 * KILO_GUTTER_SPAN][GUTTER_CELL];
+};
+
+// absolute numbers and relative ones are far apart, each keeps its own run
+static struct editorGutterCache abscache;
+static struct editorGutterCache relcache;
+static char blank[GUTTER_CELL];
+static int prefixlen = -1; // the theme's style of the gutter, set at first use
+
+/***
+ * Writes an empty cell, the prefix and suffix of every cell around spaces
+ */
+static void editorGutterBlank(char *cell) {
+  const char *prefix = editorThemeSeq(THEME_RESET, THEME_GUTTER, &prefixlen);
+  memcpy(cell, prefix, prefixlen);
+  memset(&cell[prefixlen], ' ', GUTTER_DIGITS);
+  memcpy(&cell[prefixlen + GUTTER_DIGITS], GUTTER_SUFFIX,
+         sizeof(GUTTER_SUFFIX) - 1);
+}
+
+/***
+ * Fills a cache with the cells of the numbers around one
+ *
+ * Only the first number is formatted, the next ones are made by
+ * incrementing the digits of the previous cell. Numbers too wide for the
+ * gutter show their last digits.
+ *
+ * @param *cache The cache to fill
+ * @param number The number that has to be in it
+ */
+static void editorGutterFill(struct editorGutterCache *cache, int number) {
+  int first = (number / KILO_GUTTER_SPAN - 1) * KILO_GUTTER_SPAN;
+  if (first < 0) {
+    first = 0;
+  }
+  cache->first = first;
+  cache->count = 3 * KILO_GUTTER_SPAN;
+
+  char digits[GUTTER_DIGITS + 1];
+  char num[16];
+  int numlen = snprintf(num, sizeof(num), "%d", first);
+  memset(digits, ' ', GUTTER_DIGITS);
+  if (numlen > GUTTER_DIGITS) {
+    memcpy(digits, &num[numlen - GUTTER_DIGITS], GUTTER_DIGITS);
+  } else {
+    memcpy(&digits[GUTTER_DIGITS - numlen], num, numlen);
+  }
+
+  for (int j = 0; j < cache->count; j++) {
+    char *cell = cache->cells[j];
+    editorGutterBlank(cell);
+    memcpy(&cell[prefixlen], digits, GUTTER_DIGITS);
+
+    // next number: carry from the last digit, growing into the padding
+    for (int d = GUTTER_DIGITS - 1; d >= 0; d--) {
+      if (digits[d] == ' ') {
+        digits[d] = '1';
+        break;
+      }
+      if (digits[d] != '9') {
+        digits[d]++;
+        break;
+      }
+      digits[d] = '0';
+    }
+  }
+}
+
+/***
+ * Gives the precomposed gutter cell of a number
+ *
+ * The cell is drawn with a single append, the mark at its end is to be
+ * patched in by the caller
+ *
+ * @param number The number to show, -1 for none
+ * @param *len Where to store the length of the cell
+ * @return the cell, valid until the next call
+ */
+const char *editorGutterCell(int number, int *len) {
+  if (prefixlen == -1) {
+    editorGutterBlank(blank);
+  }
+  *len = prefixlen + GUTTER_DIGITS + sizeof(GUTTER_SUFFIX) - 1;
+  if (number < 0) {
+    return blank;
+  }
+
+  // relative numbers stay within a screen of the cursor
+  struct editorGutterCache *cache =
+      (number < KILO_GUTTER_SPAN) ? &relcache : &abscache;
+  if (number < cache->first || number >= cache->first + cache->count) {
+    editorGutterFill(cache, number);
+  }
+  return cache->cells[number - cache->first];
+}
@@ -0,0 +1,12 @@
+#ifndef GUTTER_H_
+#define GUTTER_H_
+
+#include "typedefs.h"
+
+// a gutter cell ends with the mark: \x1b[3Xm, the mark character, \x1b[m
+#define GUTTER_MARK_COLOR 6 // bytes from the end of a cell to X
+#define GUTTER_MARK 4       // bytes from the end of a cell to the mark
+
+const char *editorGutterCell(int number, int *len);
+
+#endif // !#ifndef GUTTER_H_
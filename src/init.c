@@ -1,5 +1,8 @@
 #include "init.h"
+#include "buffer.h"
+#include "resize.h"
 #include "terminal.h"
+#include "window.h"
 
 /***
  * Initializes the program
@@ -10,18 +13,27 @@ void initEditor() {
   E.rx = 0;
   E.rowoff = 0;
   E.coloff = 0;
-  E.numrows = 0;
-  E.dirty = 0;
   E.mode = NORMAL_MODE;
-  E.row = NULL;
-  E.filename = NULL;
+  E.vcx = KILO_SIGN_COLUMN;
+  E.vcy = 0;
+  E.gutter = GUTTER_NUMBER;
+  E.win = NULL;
+  E.buf = NULL;
+  E.buffers = NULL;
+  E.numbuffers = 0;
+  E.curbuf = 0;
+  E.switches = 0;
+  E.frame = 0;
+  E.hlbytes = 0;
   E.statusmsg[0] = '\0';
   E.statusmsg_time = 0;
-  E.syntax = NULL;
 
-  if (getWindowSize(&E.screenrows, &E.screencols) == -1) {
+  if (getWindowSize(&E.termrows, &E.termcols) == -1) {
     die("getWindowSize");
   }
+  editorResizeInit();
 
-  E.screenrows -= 2;
+  editorBufferAdd(editorBufferNew());
+  editorBufferSwitch(0);
+  editorWindowInit();
 }
@@ -1,11 +1,23 @@
 #include "input.h"
+#include "buffer.h"
 #include "commands.h"
+#include "cursor.h"
+#include "diff.h"
 #include "editor.h"
 #include "file.h"
 #include "find.h"
+#include "follow.h"
+#include "macro.h"
 #include "output.h"
+#include "range.h"
+#include "row.h"
+#include "rowcache.h"
 #include "terminal.h"
+#include "trigram.h"
 #include "typedefs.h"
+#include "utf8.h"
+#include "window.h"
+#include <limits.h>
 
 /***
  * Show a prompt for user to interact with
@@ -25,10 +37,19 @@ char *editorPrompt(char *prompt, void (*callback)(char *, int)) {
     editorRefreshScreen();
 
     int c = editorReadKey();
+    if (c == REFRESH_KEY) {
+      continue;
+    }
+
     if (c == DEL_KEY || c == BACKSPACE) {
+      // drop the whole last character, not just its final byte
+      while (buflen != 0 && UTF8_IS_CONT(buf[buflen - 1])) {
+        buflen--;
+      }
       if (buflen != 0) {
-        buf[--buflen] = '\0';
+        buflen--;
       }
+      buf[buflen] = '\0';
     } else if (c == '\x1b') {
       editorSetStatusMessage("");
       if (callback) {
@@ -44,12 +65,12 @@ char *editorPrompt(char *prompt, void (*callback)(char *, int)) {
         }
         return buf;
       }
-    } else if (!iscntrl(c) && c < 128) {
-      if (buflen == bufsize - 1) {
+    } else if (c < ARROW_LEFT && (c >= 128 || !iscntrl(c))) {
+      if (buflen + 4 >= bufsize - 1) {
         bufsize *= 2;
         buf = realloc(buf, bufsize);
       }
-      buf[buflen++] = c;
+      buflen += utf8Encode(c, &buf[buflen]);
       buf[buflen] = '\0';
     }
 
@@ -63,21 +84,21 @@ char *editorPrompt(char *prompt, void (*callback)(char *, int)) {
  * Moves the cursor
  */
 void editorMoveCursor(int key) {
-  erow *row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
+  erow *row = (E.cy >= E.buf->numrows) ? NULL : &E.buf->row[E.cy];
 
   switch (key) {
   case ARROW_LEFT:
-    if (E.cx != KILO_SIGN_COLUMN) {
-      E.cx--;
+    if (row != NULL && E.cx != KILO_SIGN_COLUMN) {
+      E.cx = editorRowPrevCx(row, E.cx - KILO_SIGN_COLUMN) + KILO_SIGN_COLUMN;
     } else if (E.cy > 0) {
       E.cy--;
-      E.cx = E.row[E.cy].size + KILO_SIGN_COLUMN;
+      E.cx = E.buf->row[E.cy].size + KILO_SIGN_COLUMN;
     }
     break;
   case ARROW_RIGHT: {
     int size = ((row) ? row->size : 0) + KILO_SIGN_COLUMN;
     if (row != NULL && E.cx < size) {
-      E.cx++;
+      E.cx = editorRowNextCx(row, E.cx - KILO_SIGN_COLUMN) + KILO_SIGN_COLUMN;
     } else if (row != NULL && E.cx == size) {
       E.cy++;
       E.cx = KILO_SIGN_COLUMN;
@@ -89,17 +110,17 @@ void editorMoveCursor(int key) {
     }
     break;
   case ARROW_DOWN:
-    if (E.cy < E.numrows) {
+    if (E.cy < E.buf->numrows) {
       E.cy++;
     }
     break;
   }
 
-  // row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
-  if (E.cy >= E.numrows) {
+  // row = (E.cy >= E.buf->numrows) ? NULL : &E.buf->row[E.cy];
+  if (E.cy >= E.buf->numrows) {
     row = NULL;
   } else {
-    row = &E.row[E.cy];
+    row = &E.buf->row[E.cy];
   }
 
   int rowlen;
@@ -112,6 +133,304 @@ void editorMoveCursor(int key) {
   if (E.cx > rowlen) {
     E.cx = rowlen;
   }
+
+  // never leave the cursor in the middle of a multibyte character
+  if (row != NULL && !row->ascii) {
+    E.cx = utf8ClusterStart(row->chars, row->size, E.cx - KILO_SIGN_COLUMN) +
+           KILO_SIGN_COLUMN;
+  }
+}
+
+/***
+ * Waits for the key completing a command, the screen is kept up to date
+ * meanwhile
+ *
+ * @return the key pressed
+ */
+static int editorReadNextKey() {
+  int key;
+  while ((key = editorReadKey()) == REFRESH_KEY) {
+    editorRefreshScreen();
+  }
+  return key;
+}
+
+// the register the next yank, delete or put uses, chosen with "
+static int pending_register = '"';
+
+/***
+ * Takes the register chosen for the next yank, delete or put
+ *
+ * @return its name, the unnamed register if none was chosen
+ */
+static int editorTakeRegister() {
+  int name = pending_register;
+  pending_register = '"';
+  return name;
+}
+
+/***
+ * Starts selecting from the cursor
+ *
+ * @param mode One of the visual modes
+ */
+static void editorVisualStart(enum editorMode mode) {
+  E.vcx = E.cx;
+  E.vcy = E.cy;
+  E.mode = mode;
+  editorWindowDamage(E.buf, E.cy, E.cy);
+}
+
+// the count typed before a command, 0 when there is none
+static int pending_count = 0;
+
+/***
+ * Adds a digit to the count of the next command
+ *
+ * @param c The key pressed
+ * @return 1 if the key was part of a count, 0 otherwise
+ */
+static int editorCountKey(int c) {
+  if (c < '0' || c > '9' || (c == '0' && pending_count == 0)) {
+    return 0;
+  }
+  if (pending_count <= (INT_MAX - 9) / 10) {
+    pending_count = pending_count * 10 + (c - '0');
+  }
+  return 1;
+}
+
+/***
+ * Takes the count typed for the next command
+ *
+ * @return the count, 0 if none was typed
+ */
+static int editorTakeCount() {
+  int count = pending_count;
+  pending_count = 0;
+  return count;
+}
+
+/***
+ * Caps a number of rows to move over at the length of the buffer, so a big
+ * count can't overflow the row the cursor lands on
+ *
+ * @param rows The number of rows
+ * @return the number of rows, at most one past the last row
+ */
+static int editorMotionRows(long long rows) {
+  return (rows > E.buf->numrows + 1) ? E.buf->numrows + 1 : (int)rows;
+}
+
+/***
+ * Finds where a motion takes the cursor, a count is applied at once
+ * instead of repeating the motion
+ *
+ * @param key The motion
+ * @param count The count typed before it, 0 if none
+ * @param *cx Filled with the byte offset in the row it lands on
+ * @param *cy Filled with that row
+ * @return RANGE_LINES for motions between rows, RANGE_CHARS for motions
+ * inside a row, -1 if the key is not a motion
+ */
+static int editorMotion(int key, int count, int *cx, int *cy) {
+  int n = (count > 0) ? count : 1;
+  int x = E.cx - KILO_SIGN_COLUMN;
+  int y = E.cy;
+  erow *row = (y < E.buf->numrows) ? &E.buf->row[y] : NULL;
+  int type = RANGE_LINES;
+
+  switch (key) {
+  case 'h':
+  case ARROW_LEFT:
+    while (n-- > 0 && x > 0) {
+      x = editorRowPrevCx(row, x);
+    }
+    type = RANGE_CHARS;
+    break;
+  case 'l':
+  case ARROW_RIGHT:
+    while (n-- > 0 && row != NULL && x < row->size) {
+      x = editorRowNextCx(row, x);
+    }
+    type = RANGE_CHARS;
+    break;
+  case 'k':
+  case ARROW_UP:
+    y -= editorMotionRows(n);
+    break;
+  case 'j':
+  case ARROW_DOWN:
+    y += editorMotionRows(n);
+    break;
+  case CTRL_KEY('u'):
+  case PAGE_UP:
+    y -= editorMotionRows((long long)n * (E.screenrows / 2));
+    break;
+  case CTRL_KEY('d'):
+  case PAGE_DOWN:
+    y += editorMotionRows((long long)n * (E.screenrows / 2));
+    break;
+  case '0':
+  case HOME_KEY:
+    x = 0;
+    type = RANGE_CHARS;
+    break;
+  case '$':
+  case END_KEY:
+    x = (row != NULL) ? row->size : 0;
+    type = RANGE_CHARS;
+    break;
+  case 'G':
+    y = (count > 0) ? count - 1 : E.buf->numrows - 1;
+    x = 0;
+    break;
+  case 'g':
+    if (editorReadNextKey() != 'g') {
+      return -1;
+    }
+    y = (count > 0) ? count - 1 : 0;
+    x = 0;
+    break;
+  default:
+    return -1;
+  }
+
+  if (y > E.buf->numrows) {
+    y = E.buf->numrows;
+  }
+  if (y < 0) {
+    y = 0;
+  }
+  row = (y < E.buf->numrows) ? &E.buf->row[y] : NULL;
+  if (x > (row ? row->size : 0)) {
+    x = row ? row->size : 0;
+  }
+  if (row != NULL && !row->ascii) {
+    x = utf8ClusterStart(row->chars, row->size, x);
+  }
+
+  *cx = x;
+  *cy = y;
+  return type;
+}
+
+/***
+ * Moves the cursor by a motion, the arrows without a count move the way
+ * they do in insert mode
+ *
+ * @param key The motion
+ * @param count The count typed before it, 0 if none
+ * @return 0 if the cursor moved, -1 if the key is not a motion
+ */
+int editorMoveMotion(int key, int count) {
+  if (count <= 1 && key >= ARROW_LEFT && key <= ARROW_DOWN) {
+    editorMoveCursor(key);
+    return 0;
+  }
+
+  int cx, cy;
+  if (editorMotion(key, count, &cx, &cy) == -1) {
+    return -1;
+  }
+  E.cx = cx + KILO_SIGN_COLUMN;
+  E.cy = cy;
+  return 0;
+}
+
+/***
+ * Yanks a range into the chosen register and then applies an operator to
+ * it
+ *
+ * @param op d deletes the range, c deletes it and starts insert mode and y
+ * leaves the text as it is
+ * @param *r The range
+ */
+static void editorOperatorApply(int op, struct editorRange *r) {
+  editorRangeYank(r, editorTakeRegister());
+
+  int from, to;
+  switch (op) {
+  case 'y':
+    editorRangeRow(r, r->top, &from, &to);
+    E.cy = r->top;
+    if (r->type != RANGE_LINES) {
+      E.cx = from + KILO_SIGN_COLUMN;
+    } else if (E.cx > E.buf->row[r->top].size + KILO_SIGN_COLUMN) {
+      E.cx = E.buf->row[r->top].size + KILO_SIGN_COLUMN;
+    }
+    break;
+  case 'c':
+    // changed rows leave an empty row to type in
+    if (r->type == RANGE_LINES) {
+      r->type = RANGE_CHARS;
+      r->start = 0;
+      r->end = E.buf->row[r->bottom].size;
+    }
+    editorRangeDelete(r);
+    E.mode = INSERT_MODE;
+    editorSetStatusMessage("Press ESC to enter normal mode");
+    break;
+  case 'd':
+    editorRangeDelete(r);
+    break;
+  }
+}
+
+/***
+ * Reads the motion of an operator and applies the operator to the text it
+ * moves over, the operator typed twice takes whole rows
+ *
+ * @param op One of d, c or y
+ * @param count The count typed before the operator, 0 if none
+ */
+static void editorOperator(int op, int count) {
+  int key = editorReadNextKey();
+  while (editorCountKey(key)) {
+    key = editorReadNextKey();
+  }
+  int inner = editorTakeCount();
+  if (inner > 0) {
+    long long product = (long long)(count > 0 ? count : 1) * inner;
+    count = (product > INT_MAX) ? INT_MAX : (int)product;
+  }
+
+  struct editorRange r;
+  int empty;
+  if (key == op) {
+    int n = (count > 0) ? count : 1;
+    int bottom = (E.cy < INT_MAX - n) ? E.cy + n - 1 : INT_MAX;
+    empty = editorRangeBetween(&r, RANGE_LINES, 0, E.cy, 0, bottom);
+  } else {
+    int cx, cy;
+    int type = editorMotion(key, count, &cx, &cy);
+    if (type == -1) {
+      editorTakeRegister();
+      return;
+    }
+    empty = editorRangeBetween(&r, type, E.cx - KILO_SIGN_COLUMN, E.cy, cx,
+                               cy);
+  }
+
+  if (empty == -1) {
+    editorTakeRegister();
+    return;
+  }
+  editorOperatorApply(op, &r);
+}
+
+/***
+ * Moves the cursor, and the extra cursors along with it
+ *
+ * @param key The arrow key
+ * @param count The number of times to move, 0 for once
+ */
+static void editorMoveCursors(int key, int count) {
+  if (E.buf->numcursors == 0) {
+    editorMoveMotion(key, count);
+    return;
+  }
+  editorCursorsMove(key, count);
 }
 
 /***
@@ -120,6 +439,15 @@ void editorMoveCursor(int key) {
  * @param c the key pressed
  * */
 void editorNormalProcessKeypress(int c) {
+  if (c == '"') {
+    pending_register = editorReadNextKey();
+    return;
+  }
+  if (editorCountKey(c)) {
+    return;
+  }
+  int count = editorTakeCount();
+
   switch (c) {
   case ':':
     E.mode = COMMAND_MODE;
@@ -135,64 +463,106 @@ void editorNormalProcessKeypress(int c) {
     editorFind();
     break;
 
-  case '0':
-  case HOME_KEY:
-    E.cx = KILO_SIGN_COLUMN;
+  case CTRL_KEY('w'):
+    switch (editorReadNextKey()) {
+    case 'w':
+    case CTRL_KEY('w'):
+      editorWindowNext();
+      break;
+    case 'W':
+    case 'p':
+      editorWindowPrev();
+      break;
+    case 's':
+      if (editorWindowSplit(0) == -1) {
+        editorSetStatusMessage("Not enough room");
+      }
+      break;
+    case 'v':
+      if (editorWindowSplit(1) == -1) {
+        editorSetStatusMessage("Not enough room");
+      }
+      break;
+    case 'c':
+    case 'q':
+      editorWindowClose();
+      break;
+    case 'h':
+    case ARROW_LEFT:
+      editorWindowMove('h');
+      break;
+    case 'j':
+    case ARROW_DOWN:
+      editorWindowMove('j');
+      break;
+    case 'k':
+    case ARROW_UP:
+      editorWindowMove('k');
+      break;
+    case 'l':
+    case ARROW_RIGHT:
+      editorWindowMove('l');
+      break;
+    }
     break;
 
+  case '0':
+  case HOME_KEY:
   case '$':
   case END_KEY:
-    if (E.cy < E.numrows) {
-      E.cx = E.row[E.cy].size + KILO_SIGN_COLUMN;
-    }
-    break;
-
   case CTRL_KEY('u'):
-  case PAGE_UP: {
-    int times = E.screenrows / 2;
-    while (times--) {
-      editorMoveCursor(ARROW_UP);
-    }
-  } break;
-
+  case PAGE_UP:
   case CTRL_KEY('d'):
-  case PAGE_DOWN: {
-    int times = E.screenrows / 2;
-    while (times--) {
-      editorMoveCursor(ARROW_DOWN);
-    }
-  } break;
+  case PAGE_DOWN:
+  case 'G':
+  case 'g':
+    editorMoveMotion(c, count);
+    break;
 
   case ARROW_UP:
   case ARROW_RIGHT:
   case ARROW_DOWN:
   case ARROW_LEFT:
-    editorMoveCursor(c);
+    editorMoveCursors(c, count);
     break;
 
   case 'k':
-    editorMoveCursor(ARROW_UP);
+    editorMoveCursors(ARROW_UP, count);
     break;
   case 'j':
-    editorMoveCursor(ARROW_DOWN);
+    editorMoveCursors(ARROW_DOWN, count);
     break;
   case 'h':
-    editorMoveCursor(ARROW_LEFT);
+    editorMoveCursors(ARROW_LEFT, count);
     break;
   case 'l':
-    editorMoveCursor(ARROW_RIGHT);
+    editorMoveCursors(ARROW_RIGHT, count);
+    break;
+
+  case 'd':
+  case 'c':
+  case 'y':
+    editorOperator(c, count);
+    break;
+
+  case CTRL_KEY('n'):
+    editorCursorAddBelow();
+    break;
+
+  case '\x1b':
+    editorCursorsClear();
     break;
 
   case 'A':
-    if (E.cy < E.numrows) {
-      E.cx = E.row[E.cy].size + KILO_SIGN_COLUMN;
+    if (E.cy < E.buf->numrows) {
+      E.cx = E.buf->row[E.cy].size + KILO_SIGN_COLUMN;
     }
     E.mode = INSERT_MODE;
     editorSetStatusMessage("Press ESC to enter normal mode");
     break;
 
   case 'I':
-    E.cx = 0;
+    E.cx = KILO_SIGN_COLUMN;
     // TODO: move to the first non-space character
     E.mode = INSERT_MODE;
     editorSetStatusMessage("Press ESC to enter normal mode");
@@ -207,10 +577,154 @@ void editorNormalProcessKeypress(int c) {
     break;
 
   case 'x':
-    editorMoveCursor(ARROW_RIGHT);
-    editorDelChar();
+    if (E.buf->numcursors > 0) {
+      editorMoveCursors(ARROW_RIGHT, 0);
+      editorDelChar();
+    } else {
+      struct editorRange r;
+      int cx, cy;
+      editorMotion(ARROW_RIGHT, count, &cx, &cy);
+      if (editorRangeBetween(&r, RANGE_CHARS, E.cx - KILO_SIGN_COLUMN, E.cy,
+                             cx, cy) == 0) {
+        editorOperatorApply('d', &r);
+      }
+    }
+    break;
+
+  case 'v':
+    editorVisualStart(VISUAL_MODE);
+    break;
+  case 'V':
+    editorVisualStart(VISUAL_LINE_MODE);
+    break;
+  case CTRL_KEY('v'):
+    editorVisualStart(VISUAL_BLOCK_MODE);
+    break;
+
+  case 'p':
+  case 'P':
+    editorRangePut(editorTakeRegister(), c == 'P');
+    break;
+
+  case 'q':
+    // macros can't record or stop a recording
+    if (editorMacroReplaying()) {
+      break;
+    }
+    if (editorMacroRecording()) {
+      editorMacroStop();
+    } else if (editorMacroRecord(editorReadNextKey()) == -1) {
+      editorSetStatusMessage("Can't record into that register");
+    }
+    break;
+
+  case '@':
+    if (editorMacroPlay(editorReadNextKey(), count > 0 ? count : 1) == -1) {
+      editorSetStatusMessage("No macro in that register");
+    }
+    break;
+  }
+}
+
+/***
+ * Waits for a key press and then handles it in one of the visual modes
+ *
+ * @param c the key pressed
+ */
+void editorVisualProcessKeypress(int c) {
+  if (c == '"') {
+    pending_register = editorReadNextKey();
+    return;
+  }
+  if (editorCountKey(c)) {
+    return;
+  }
+  int count = editorTakeCount();
+
+  // the rows selected before and after the key are drawn again
+  struct editorRange r;
+  int selected = editorVisualRange(&r) == 0;
+  if (selected) {
+    editorWindowDamage(E.buf, r.top, r.bottom);
+  }
+
+  switch (c) {
+  case '\x1b':
+    E.mode = NORMAL_MODE;
+    break;
+
+  case 'v':
+  case 'V':
+  case CTRL_KEY('v'): {
+    enum editorMode mode = (c == 'v')   ? VISUAL_MODE
+                           : (c == 'V') ? VISUAL_LINE_MODE
+                                        : VISUAL_BLOCK_MODE;
+    E.mode = (E.mode == mode) ? NORMAL_MODE : mode;
+  } break;
+
+  case 'o': {
+    int cx = E.cx;
+    int cy = E.cy;
+    E.cx = E.vcx;
+    E.cy = E.vcy;
+    E.vcx = cx;
+    E.vcy = cy;
+  } break;
+
+  case 'y':
+  case 'd':
+  case 'x':
+  case 'c':
+    E.mode = NORMAL_MODE;
+    if (selected) {
+      editorOperatorApply(c == 'x' ? 'd' : c, &r);
+    }
+    break;
+
+  case 'k':
+    editorMoveMotion(ARROW_UP, count);
+    break;
+  case 'j':
+    editorMoveMotion(ARROW_DOWN, count);
+    break;
+  case 'h':
+    editorMoveMotion(ARROW_LEFT, count);
     break;
+  case 'l':
+    editorMoveMotion(ARROW_RIGHT, count);
+    break;
+
+  default:
+    editorMoveMotion(c, count);
+    break;
+  }
+
+  if (editorVisualRange(&r) == 0) {
+    editorWindowDamage(E.buf, r.top, r.bottom);
+  }
+}
+
+/***
+ * Inserts a typed character, while a macro is replayed the characters
+ * that follow it are taken too and inserted at once
+ *
+ * @param c The codepoint
+ */
+static void editorInsertRun(int c) {
+  if (E.buf->numcursors > 0 || !editorMacroReplaying()) {
+    editorInsertChar(c);
+    return;
+  }
+
+  char buf[256];
+  int len = utf8Encode(c, buf);
+  int next;
+  while (len + 4 <= (int)sizeof(buf) && (next = editorMacroPeek()) != -1 &&
+         next < ARROW_LEFT && (next >= 128 || !iscntrl(next))) {
+    editorMacroNext(&next);
+    len += utf8Encode(next, &buf[len]);
   }
+  editorInsertText(buf, len);
 }
 
 /***
@@ -235,7 +749,7 @@ void editorInsertProcessKeypress(int c) {
   case BACKSPACE:
   case DEL_KEY:
     if (c == DEL_KEY) {
-      editorMoveCursor(ARROW_RIGHT);
+      editorMoveCursors(ARROW_RIGHT, 0);
     }
     editorDelChar();
     break;
@@ -244,11 +758,13 @@ void editorInsertProcessKeypress(int c) {
   case ARROW_RIGHT:
   case ARROW_DOWN:
   case ARROW_LEFT:
-    editorMoveCursor(c);
+    editorMoveCursors(c, 0);
     break;
 
   default:
-    editorInsertChar(c);
+    if (c < ARROW_LEFT) {
+      editorInsertRun(c);
+    }
     break;
   }
 }
@@ -268,6 +784,12 @@ void editorProcessKeypress() {
     editorInsertProcessKeypress(c);
     break;
 
+  case VISUAL_MODE:
+  case VISUAL_LINE_MODE:
+  case VISUAL_BLOCK_MODE:
+    editorVisualProcessKeypress(c);
+    break;
+
   default:
     break;
   }
@@ -281,18 +803,155 @@ void editorSetStatusMessage(const char *fmt, ...) {
   E.statusmsg_time = time(NULL);
 }
 
+/***
+ * Runs :sp and :vs, with an optional file to open in the new window
+ *
+ * @param *cmd The command line
+ */
+static void editorSplitCommand(char *cmd) {
+  int vertical = (cmd[0] == 'v');
+  char *arg = strchr(cmd, ' ');
+
+  char *name = vertical ? "vsplit" : "split";
+  int cmdlen = arg ? arg - cmd : (int)strlen(cmd);
+  if (cmdlen < 2 || strncmp(cmd, name, cmdlen) != 0) {
+    return;
+  }
+
+  if (editorWindowSplit(vertical) == -1) {
+    editorSetStatusMessage("Not enough room");
+    return;
+  }
+
+  while (arg && *arg == ' ') {
+    arg++;
+  }
+  if (arg && *arg != '\0') {
+    editorBufferEdit(arg);
+  }
+}
+
+/***
+ * Changes an option of the editor
+ *
+ * @param *option One of nu, nonu, rnu, nornu, index, noindex, rowcache,
+ * norowcache
+ */
+static void editorSetOption(char *option) {
+  if (strcmp(option, "nu") == 0 || strcmp(option, "number") == 0) {
+    E.gutter |= GUTTER_NUMBER;
+  } else if (strcmp(option, "nonu") == 0 || strcmp(option, "nonumber") == 0) {
+    E.gutter &= ~GUTTER_NUMBER;
+  } else if (strcmp(option, "rnu") == 0 ||
+             strcmp(option, "relativenumber") == 0) {
+    E.gutter |= GUTTER_RELATIVE;
+  } else if (strcmp(option, "nornu") == 0 ||
+             strcmp(option, "norelativenumber") == 0) {
+    E.gutter &= ~GUTTER_RELATIVE;
+  } else if (strcmp(option, "index") == 0) {
+    editorTrigramEnable(1);
+    return;
+  } else if (strcmp(option, "noindex") == 0) {
+    editorTrigramEnable(0);
+    return;
+  } else if (strcmp(option, "rowcache") == 0) {
+    editorRowCacheEnable(1);
+    return;
+  } else if (strcmp(option, "norowcache") == 0) {
+    editorRowCacheEnable(0);
+    return;
+  } else {
+    editorSetStatusMessage("Unknown option: %s", option);
+    return;
+  }
+  editorWindowDamageAll();
+}
+
+/***
+ * Discards the changes to the current buffer and reads its file again
+ */
+static void editorReloadCommand() {
+  if (E.buf->follow != NULL) {
+    editorSetStatusMessage("Can't reload while following, :follow to stop");
+    return;
+  }
+
+  int changed = editorReload();
+  if (changed == -1) {
+    editorSetStatusMessage("Can't reload: %s",
+                           E.buf->filename ? strerror(errno) : "no file");
+    return;
+  }
+
+  if (E.cy > E.buf->numrows) {
+    E.cy = E.buf->numrows;
+  }
+  int size = (E.cy < E.buf->numrows) ? E.buf->row[E.cy].size : 0;
+  if (E.cx > size + KILO_SIGN_COLUMN) {
+    E.cx = size + KILO_SIGN_COLUMN;
+  }
+  editorSetStatusMessage("\"%s\" %d lines reloaded", E.buf->filename,
+                         changed);
+}
+
 void editorCommandMode() {
   char *q = editorPrompt(":%s", NULL);
   if (q != NULL) {
     if (strcmp(q, "q") == 0) {
-      quit();
+      if (editorWindowClose() == -1) {
+        quit();
+      }
     } else if (strcmp(q, "q!") == 0) {
+      if (editorWindowClose() == -1) {
+        force_quit();
+      }
+    } else if (strcmp(q, "qa") == 0) {
+      quit();
+    } else if (strcmp(q, "qa!") == 0) {
       force_quit();
     } else if (strcmp(q, "w") == 0) {
       editorSave();
     } else if (strcmp(q, "wq") == 0 || strcmp(q, "x") == 0) {
       editorSave();
-      quit();
+      if (editorWindowClose() == -1) {
+        quit();
+      }
+    } else if (strncmp(q, "sp", 2) == 0 || strncmp(q, "vs", 2) == 0) {
+      editorSplitCommand(q);
+    } else if (strcmp(q, "close") == 0) {
+      if (editorWindowClose() == -1) {
+        editorSetStatusMessage("Cannot close last window");
+      }
+    } else if (strcmp(q, "e!") == 0) {
+      editorReloadCommand();
+    } else if (strncmp(q, "e ", 2) == 0 && q[2] != '\0') {
+      editorBufferEdit(&q[2]);
+    } else if (strcmp(q, "bn") == 0) {
+      editorBufferNext();
+    } else if (strcmp(q, "bp") == 0) {
+      editorBufferPrev();
+    } else if (q[0] == 'b' && isdigit((unsigned char)q[1])) {
+      editorBufferSwitch(atoi(&q[1]) - 1);
+    } else if (strncmp(q, "b ", 2) == 0 && isdigit((unsigned char)q[2])) {
+      editorBufferSwitch(atoi(&q[2]) - 1);
+    } else if (strcmp(q, "bd") == 0) {
+      editorBufferClose(0);
+    } else if (strcmp(q, "bd!") == 0) {
+      editorBufferClose(1);
+    } else if (strcmp(q, "ls") == 0) {
+      editorBufferList();
+    } else if (strcmp(q, "follow") == 0) {
+      editorFollowToggle();
+    } else if (strcmp(q, "diff") == 0) {
+      editorDiffToggle();
+    } else if (strncmp(q, "cursors ", 8) == 0) {
+      for (int n = atoi(&q[8]); n > 0 && editorCursorAddBelow() == 0; n--) {
+      }
+    } else if (q[strspn(q, "0123456789")] == '\0') {
+      int line = atoi(q);
+      editorMoveMotion('G', line > 0 ? line : 1);
+    } else if (strncmp(q, "set ", 4) == 0) {
+      editorSetOption(&q[4]);
     }
     free(q);
   }
@@ -5,8 +5,10 @@
 
 char *editorPrompt(char *prompt, void (*callback)(char *, int));
 void editorMoveCursor(int key);
+int editorMoveMotion(int key, int count);
 void editorNormalProcessKeypress(int c);
 void editorInsertProcessKeypress(int c);
+void editorVisualProcessKeypress(int c);
 void editorProcessKeypress();
 void editorSetStatusMessage(const char *fmt, ...);
 void editorCommandMode();
@@ -0,0 +1,560 @@
+#include "journal.h"
+#include "input.h"
+#include "row.h"
+#include <libgen.h>
+#include <pthread.h>
+#include <sys/file.h>
+
+#define KILO_JOURNAL_MAGIC "KILOSWP1"
+
+// identifies the version of the file the journal applies to
+struct editorJournalHeader {
+  char magic[8];
+  int64_t size;
+  int64_t mtime_sec;
+  int64_t mtime_nsec;
+};
+
+struct editorJournalRecord {
+  int32_t op;
+  int32_t row;
+  int32_t at;
+  int32_t len; // bytes of text following the record
+};
+
+struct editorJournal {
+  char *path;
+  int fd;
+
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+
+  // records not written yet, guarded by lock
+  char *data;
+  size_t len;
+  size_t cap;
+  size_t last; // where the last record of data starts, while len > 0
+  int stop;
+};
+
+// set while the journal is replayed so the replay is not journaled again
+static int replaying = 0;
+
+/***
+ * Builds the name of a file's journal, .name.kswp next to it
+ *
+ * @param *filename The name of the file
+ * @return the name of the journal, to be freed
+ */
+static char *editorJournalPath(const char *filename) {
+  char *dcopy = strdup(filename);
+  char *bcopy = strdup(filename);
+  char *path = NULL;
+
+  if (dcopy && bcopy) {
+    char *dir = dirname(dcopy);
+    char *base = basename(bcopy);
+    size_t len = strlen(dir) + strlen(base) + 8;
+    path = malloc(len);
+    if (path) {
+      snprintf(path, len, "%s/.%s.kswp", dir, base);
+    }
+  }
+
+  free(dcopy);
+  free(bcopy);
+  return path;
+}
+
+/***
+ * Adds a number of milliseconds to the current time
+ */
+static struct timespec editorJournalDeadline(int ms) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  ts.tv_sec += ms / 1000;
+  ts.tv_nsec += (long)(ms % 1000) * 1000000;
+  if (ts.tv_nsec >= 1000000000) {
+    ts.tv_sec++;
+    ts.tv_nsec -= 1000000000;
+  }
+  return ts;
+}
+
+/***
+ * Writes the journal in the background
+ *
+ * Records are gathered for KILO_JOURNAL_MS after the first one arrives and
+ * written with a single call, the file is synced at most every
+ * KILO_JOURNAL_SYNC_MS, so typing never waits on the disk
+ *
+ * @param *arg The journal
+ */
+static void *editorJournalThread(void *arg) {
+  struct editorJournal *jr = arg;
+  char *out = NULL;
+  size_t outcap = 0;
+  int unsynced = 0;
+  struct timespec nextsync = editorJournalDeadline(0);
+
+  pthread_mutex_lock(&jr->lock);
+  while (1) {
+    while (jr->len == 0 && !jr->stop) {
+      if (!unsynced) {
+        pthread_cond_wait(&jr->cond, &jr->lock);
+      } else if (pthread_cond_timedwait(&jr->cond, &jr->lock, &nextsync) ==
+                 ETIMEDOUT) {
+        break;
+      }
+    }
+
+    if (jr->len > 0 && !jr->stop) {
+      // only a stop wakes this wait, edits just pile up meanwhile
+      struct timespec batch = editorJournalDeadline(KILO_JOURNAL_MS);
+      while (!jr->stop && pthread_cond_timedwait(&jr->cond, &jr->lock,
+                                                 &batch) != ETIMEDOUT) {
+      }
+    }
+
+    char *tmp = jr->data;
+    size_t tmpcap = jr->cap;
+    size_t len = jr->len;
+    jr->data = out;
+    jr->cap = outcap;
+    jr->len = 0;
+    out = tmp;
+    outcap = tmpcap;
+    int stop = jr->stop;
+    pthread_mutex_unlock(&jr->lock);
+
+    for (size_t done = 0; done < len;) {
+      ssize_t n = write(jr->fd, &out[done], len - done);
+      if (n == -1 && errno != EINTR) {
+        break;
+      }
+      done += (n > 0) ? (size_t)n : 0;
+    }
+    if (len > 0) {
+      unsynced = 1;
+    }
+
+    struct timespec now = editorJournalDeadline(0);
+    if (unsynced && (stop || now.tv_sec > nextsync.tv_sec ||
+                     (now.tv_sec == nextsync.tv_sec &&
+                      now.tv_nsec >= nextsync.tv_nsec))) {
+      fdatasync(jr->fd);
+      unsynced = 0;
+      nextsync = editorJournalDeadline(KILO_JOURNAL_SYNC_MS);
+    }
+
+    pthread_mutex_lock(&jr->lock);
+    if (stop && jr->len == 0) {
+      break;
+    }
+  }
+  pthread_mutex_unlock(&jr->lock);
+
+  free(out);
+  return NULL;
+}
+
+/***
+ * Opens the journal of the current buffer and starts its writer
+ *
+ * The journal stays locked while it is open, the session holding the lock
+ * owns it and no other one reads it back or writes to it
+ *
+ * @param append Whether to keep the records already in it
+ * @return the journal, NULL if it can't be created or another session owns
+ * it
+ */
+static struct editorJournal *editorJournalOpen(int append) {
+  struct editorJournal *jr = calloc(1, sizeof(struct editorJournal));
+  if (jr == NULL) {
+    return NULL;
+  }
+
+  jr->path = editorJournalPath(E.buf->filename);
+  jr->fd = jr->path ? open(jr->path, O_WRONLY | O_CREAT | (append ? O_APPEND : 0),
+                           0600)
+                    : -1;
+  if (jr->fd != -1 && flock(jr->fd, LOCK_EX | LOCK_NB) == -1) {
+    close(jr->fd);
+    jr->fd = -1;
+  }
+  if (jr->fd == -1 || (!append && ftruncate(jr->fd, 0) == -1)) {
+    if (jr->fd != -1) {
+      close(jr->fd);
+    }
+    free(jr->path);
+    free(jr);
+    return NULL;
+  }
+
+  if (!append) {
+    struct editorJournalHeader hdr;
+    memcpy(hdr.magic, KILO_JOURNAL_MAGIC, sizeof(hdr.magic));
+    hdr.size = E.buf->disk.st_size;
+    hdr.mtime_sec = E.buf->disk.st_mtim.tv_sec;
+    hdr.mtime_nsec = E.buf->disk.st_mtim.tv_nsec;
+    if (write(jr->fd, &hdr, sizeof(hdr)) != sizeof(hdr)) {
+      close(jr->fd);
+      unlink(jr->path);
+      free(jr->path);
+      free(jr);
+      return NULL;
+    }
+  }
+
+  pthread_mutex_init(&jr->lock, NULL);
+  pthread_cond_init(&jr->cond, NULL);
+  if (pthread_create(&jr->thread, NULL, editorJournalThread, jr) != 0) {
+    pthread_mutex_destroy(&jr->lock);
+    pthread_cond_destroy(&jr->cond);
+    close(jr->fd);
+    unlink(jr->path);
+    free(jr->path);
+    free(jr);
+    return NULL;
+  }
+
+  return jr;
+}
+
+/***
+ * Merges an edit into the last record not written yet when it carries on
+ * from it, so a run of typed or deleted characters takes a single record
+ *
+ * @param *jr The journal, locked, with records not written yet
+ * @param *rec The edit
+ * @param *s The text inserted, NULL for deletions
+ * @return 1 if the edit was merged, 0 otherwise
+ */
+static int editorJournalMerge(struct editorJournal *jr,
+                              const struct editorJournalRecord *rec,
+                              const char *s) {
+  struct editorJournalRecord last;
+  memcpy(&last, &jr->data[jr->last], sizeof(last));
+  if (last.op != rec->op || last.row != rec->row) {
+    return 0;
+  }
+
+  if (rec->op == JOURNAL_INSERT && s != NULL &&
+      last.at + last.len == rec->at) {
+    if (jr->len + rec->len > jr->cap) {
+      size_t cap = jr->cap * 2;
+      while (cap < jr->len + rec->len) {
+        cap *= 2;
+      }
+      char *new = realloc(jr->data, cap);
+      if (new == NULL) {
+        return 0;
+      }
+      jr->data = new;
+      jr->cap = cap;
+    }
+    memcpy(&jr->data[jr->len], s, rec->len);
+    jr->len += rec->len;
+    last.len += rec->len;
+  } else if (rec->op == JOURNAL_DELETE && rec->at == last.at) {
+    last.len += rec->len;
+  } else if (rec->op == JOURNAL_DELETE && rec->at + rec->len == last.at) {
+    last.at = rec->at;
+    last.len += rec->len;
+  } else {
+    return 0;
+  }
+
+  memcpy(&jr->data[jr->last], &last, sizeof(last));
+  return 1;
+}
+
+/***
+ * Records an edit of the current buffer in its journal
+ *
+ * Buffers without a file, or whose rows come from a followed file, are not
+ * journaled. Rows still loading are only ever appended after the edited
+ * ones, so replaying onto the whole file gives the same text
+ *
+ * @param op One of editorJournalOp
+ * @param row The row edited
+ * @param at The byte offset in the row
+ * @param *s The text inserted, NULL for deletions
+ * @param len The number of bytes inserted or deleted
+ */
+void editorJournalOp(int op, int row, int at, const char *s, size_t len) {
+  struct editorBuffer *buf = E.buf;
+  if (replaying || buf->filename == NULL || buf->follow != NULL) {
+    return;
+  }
+
+  if (buf->journal == NULL) {
+    buf->journal = editorJournalOpen(0);
+    if (buf->journal == NULL) {
+      return;
+    }
+  }
+  struct editorJournal *jr = buf->journal;
+
+  struct editorJournalRecord rec = {op, row, at, len};
+  size_t text = (s != NULL) ? len : 0;
+  size_t need = sizeof(rec) + text;
+
+  pthread_mutex_lock(&jr->lock);
+  if (jr->len > 0 && editorJournalMerge(jr, &rec, s)) {
+    pthread_mutex_unlock(&jr->lock);
+    return;
+  }
+  if (jr->len + need > jr->cap) {
+    size_t cap = jr->cap ? jr->cap : 4096;
+    while (cap < jr->len + need) {
+      cap *= 2;
+    }
+    char *new = realloc(jr->data, cap);
+    if (new == NULL) {
+      pthread_mutex_unlock(&jr->lock);
+      return;
+    }
+    jr->data = new;
+    jr->cap = cap;
+  }
+
+  jr->last = jr->len;
+  memcpy(&jr->data[jr->len], &rec, sizeof(rec));
+  if (text) {
+    memcpy(&jr->data[jr->len + sizeof(rec)], s, text);
+  }
+  if (jr->len == 0) {
+    pthread_cond_signal(&jr->cond);
+  }
+  jr->len += need;
+  pthread_mutex_unlock(&jr->lock);
+}
+
+/***
+ * Checks whether a journal was written for the version of the file a
+ * buffer was read from
+ *
+ * @param *hdr The header of the journal
+ * @param *buf The buffer
+ * @return 1 if it was
+ */
+static int editorJournalMatches(const struct editorJournalHeader *hdr,
+                                const struct editorBuffer *buf) {
+  return memcmp(hdr->magic, KILO_JOURNAL_MAGIC, sizeof(hdr->magic)) == 0 &&
+         hdr->size == buf->disk.st_size &&
+         hdr->mtime_sec == buf->disk.st_mtim.tv_sec &&
+         hdr->mtime_nsec == buf->disk.st_mtim.tv_nsec;
+}
+
+/***
+ * Checks whether a buffer has edits to recover once its file is read
+ *
+ * @param *buf The buffer, its file stamped
+ * @return 1 if a journal for this version of the file is waiting
+ */
+int editorJournalPending(struct editorBuffer *buf) {
+  if (buf->filename == NULL || buf->journal != NULL) {
+    return 0;
+  }
+  char *path = editorJournalPath(buf->filename);
+  int fd = path ? open(path, O_RDONLY) : -1;
+  free(path);
+  if (fd == -1) {
+    return 0;
+  }
+
+  // a journal another session holds is not waited for
+  struct editorJournalHeader hdr;
+  int pending = flock(fd, LOCK_EX | LOCK_NB) == 0 &&
+                read(fd, &hdr, sizeof(hdr)) == sizeof(hdr) &&
+                editorJournalMatches(&hdr, buf);
+  close(fd);
+  return pending;
+}
+
+/***
+ * Stops the journal writer and closes the journal
+ */
+static void editorJournalClose(struct editorJournal *jr) {
+  pthread_mutex_lock(&jr->lock);
+  jr->stop = 1;
+  pthread_cond_signal(&jr->cond);
+  pthread_mutex_unlock(&jr->lock);
+  pthread_join(jr->thread, NULL);
+
+  pthread_mutex_destroy(&jr->lock);
+  pthread_cond_destroy(&jr->cond);
+  close(jr->fd);
+  free(jr->data);
+}
+
+/***
+ * Throws a buffer's journal away, once it is saved, reloaded or closed
+ *
+ * @param *buf The buffer
+ */
+void editorJournalDiscard(struct editorBuffer *buf) {
+  struct editorJournal *jr = buf->journal;
+  if (jr == NULL) {
+    return;
+  }
+
+  // removed while still locked, so no other session picks it up half gone
+  unlink(jr->path);
+  editorJournalClose(jr);
+  free(jr->path);
+  free(jr);
+  buf->journal = NULL;
+}
+
+/***
+ * Applies one journal record to the current buffer
+ *
+ * @return 0 on success, -1 if the record does not fit the buffer
+ */
+static int editorJournalApply(struct editorJournalRecord *rec, char *text) {
+  int numrows = E.buf->numrows;
+
+  switch (rec->op) {
+  case JOURNAL_INSERT_ROW:
+    if (rec->row < 0 || rec->row > numrows) {
+      return -1;
+    }
+    editorInsertRow(rec->row, text, rec->len);
+    return 0;
+  case JOURNAL_DELETE_ROW:
+    if (rec->row < 0 || rec->row >= numrows) {
+      return -1;
+    }
+    editorDelRow(rec->row);
+    return 0;
+  case JOURNAL_INSERT_ROWS:
+    if (rec->row < 0 || rec->row > numrows) {
+      return -1;
+    }
+    editorInsertRows(rec->row, text, rec->len);
+    return 0;
+  case JOURNAL_DELETE_ROWS:
+    if (rec->row < 0 || rec->at <= 0 || rec->row + rec->at > numrows) {
+      return -1;
+    }
+    editorDelRows(rec->row, rec->at);
+    return 0;
+  case JOURNAL_INSERT:
+  case JOURNAL_DELETE: {
+    if (rec->row < 0 || rec->row >= numrows) {
+      return -1;
+    }
+    erow *row = &E.buf->row[rec->row];
+    if (rec->at < 0 || rec->at > row->size) {
+      return -1;
+    }
+    if (rec->op == JOURNAL_INSERT) {
+      editorRowInsertBytes(row, rec->at, text, rec->len);
+    } else {
+      editorRowDelChars(row, rec->at, rec->len);
+    }
+    return 0;
+  }
+  default:
+    return -1;
+  }
+}
+
+/***
+ * Replays the journal left by an editor that did not exit cleanly
+ *
+ * The journal is only replayed onto the version of the file it was written
+ * for, it is then kept and appended to
+ *
+ * @param *buf The buffer, just read from its file and current
+ */
+void editorJournalRecover(struct editorBuffer *buf) {
+  // edits made while the file loaded are already journaled on their own
+  if (buf->filename == NULL || buf->journal != NULL || buf->dirty) {
+    return;
+  }
+
+  char *path = editorJournalPath(buf->filename);
+  int fd = path ? open(path, O_RDWR) : -1;
+  struct stat st;
+  if (fd == -1 || fstat(fd, &st) == -1) {
+    if (fd != -1) {
+      close(fd);
+    }
+    free(path);
+    return;
+  }
+
+  // the journal of a session still running is its own, like a swap file in
+  // use it is left alone
+  if (flock(fd, LOCK_EX | LOCK_NB) == -1) {
+    editorSetStatusMessage("%s is in use by another editor, edits to this "
+                           "file are not journaled",
+                           path);
+    close(fd);
+    free(path);
+    return;
+  }
+
+  char *data = malloc(st.st_size > 0 ? st.st_size : 1);
+  ssize_t len = data ? read(fd, data, st.st_size) : -1;
+
+  struct editorJournalHeader hdr;
+  if (len < (ssize_t)sizeof(hdr)) {
+    close(fd);
+    free(data);
+    free(path);
+    return;
+  }
+  memcpy(&hdr, data, sizeof(hdr));
+  if (!editorJournalMatches(&hdr, buf)) {
+    editorSetStatusMessage("Ignoring %s, it is for another version of the "
+                           "file",
+                           path);
+    close(fd);
+    free(data);
+    free(path);
+    return;
+  }
+
+  int edits = 0;
+  size_t pos = sizeof(hdr);
+  replaying = 1;
+  while (pos + sizeof(struct editorJournalRecord) <= (size_t)len) {
+    struct editorJournalRecord rec;
+    memcpy(&rec, &data[pos], sizeof(rec));
+    size_t text = (rec.op == JOURNAL_INSERT_ROW || rec.op == JOURNAL_INSERT ||
+                   rec.op == JOURNAL_INSERT_ROWS)
+                      ? (size_t)rec.len
+                      : 0;
+    // a record cut short by the crash ends the replay
+    if (rec.len < 0 || pos + sizeof(rec) + text > (size_t)len ||
+        editorJournalApply(&rec, &data[pos + sizeof(rec)]) == -1) {
+      break;
+    }
+    pos += sizeof(rec) + text;
+    edits++;
+  }
+  replaying = 0;
+
+  free(data);
+  if (edits == 0) {
+    unlink(path);
+    close(fd);
+    free(path);
+    return;
+  }
+  // drop a torn record so new ones are not appended after it
+  ftruncate(fd, pos);
+  close(fd);
+  free(path);
+
+  // the journal still describes the buffer, keep adding to it
+  buf->journal = editorJournalOpen(1);
+  buf->dirty = edits;
+  editorSetStatusMessage("Recovered %d edits to \"%s\", :w to keep them",
+                         edits, buf->filename);
+}
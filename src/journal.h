@@ -0,0 +1,20 @@
+#ifndef JOURNAL_H_
+#define JOURNAL_H_
+
+#include "typedefs.h"
+
+enum editorJournalOp {
+  JOURNAL_INSERT_ROW = 1,
+  JOURNAL_DELETE_ROW,
+  JOURNAL_INSERT,
+  JOURNAL_DELETE,
+  JOURNAL_INSERT_ROWS, // the text holds the rows, each ending with \n
+  JOURNAL_DELETE_ROWS  // at holds the number of rows
+};
+
+void editorJournalOp(int op, int row, int at, const char *s, size_t len);
+void editorJournalDiscard(struct editorBuffer *buf);
+int editorJournalPending(struct editorBuffer *buf);
+void editorJournalRecover(struct editorBuffer *buf);
+
+#endif // !#ifndef JOURNAL_H_
@@ -5,11 +5,13 @@
 #define _BSD_SOURCE
 #define _GNU_SOURCE
 
-#include "file.h"
+#include "buffer.h"
 #include "init.h"
 #include "input.h"
+#include "language.h"
 #include "output.h"
 #include "terminal.h"
+#include "theme.h"
 #include "typedefs.h"
 
 struct editorConfig E;
@@ -17,11 +19,14 @@ struct editorConfig E;
 int main(int argc, char *argv[]) {
   enableRowMode();
   initEditor();
-  if (argc >= 2) {
-    editorOpen(argv[1]);
-  }
-
   editorSetStatusMessage(DEFAULT_MESSAGE);
+  editorLanguageLoad();
+  editorThemeLoad();
+
+  for (int i = 1; i < argc; i++) {
+    editorBufferEdit(argv[i]);
+  }
+  editorBufferSwitch(0);
 
   while (1) {
     editorRefreshScreen();
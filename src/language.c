@@ -0,0 +1,665 @@
+#include "language.h"
+#include "file.h"
+#include "input.h"
+#include "row.h"
+#include "scan.h"
+#include "syntaxdef.h"
+#include <dirent.h>
+#include <sys/mman.h>
+
+#define KILO_LANGUAGE_MAGIC "KILOLNG2"
+
+// the cache, the offsets of count records follow the header
+struct editorLanguageHeader {
+  char magic[8];
+  uint64_t key; // hash of the definitions the cache was compiled from
+  uint32_t size;
+  uint32_t count;
+};
+
+// a compiled language, offsets are from the start of the record so the
+// cache is used where it is mapped
+struct editorLanguageRecord {
+  uint32_t size;
+  uint32_t filetype;
+  uint32_t match; // nmatch offsets of strings
+  uint32_t nmatch;
+  uint32_t scs, mcs, mce; // 0 when the language has no such comment
+  uint32_t scslen, mcslen, mcelen;
+  uint32_t flags;
+  uint32_t keywords; // mask + 1 slots, empty ones have a len of 0
+  uint32_t mask;
+  uint32_t minlen, maxlen;
+  uint32_t fast; // see editorScanWord
+  unsigned char class[256];
+};
+
+struct editorLanguageKeyword {
+  uint32_t word;
+  uint16_t len;
+  uint16_t hl;
+};
+
+static struct editorSyntax *languages = NULL;
+static int numlanguages = 0;
+
+/***
+ * Looks a word up in the keyword table of a compiled language
+ *
+ * @return the highlight of the keyword, HL_NORMAL if it is not one
+ */
+static int editorLanguageKeyword(const struct editorLanguageRecord *lang,
+                                 const char *s, int len) {
+  if (len < (int)lang->minlen || len > (int)lang->maxlen) {
+    return HL_NORMAL;
+  }
+
+  const char *base = (const char *)lang;
+  const struct editorLanguageKeyword *table =
+      (const struct editorLanguageKeyword *)(base + lang->keywords);
+  for (unsigned int slot = editorSyntaxDefHash(s, len) & lang->mask;
+       table[slot].len; slot = (slot + 1) & lang->mask) {
+    if (table[slot].len == len &&
+        memcmp(base + table[slot].word, s, len) == 0) {
+      return table[slot].hl;
+    }
+  }
+  return HL_NORMAL;
+}
+
+/***
+ * Highlights a row with a compiled language
+ *
+ * This is the lexer tools/syntaxgen.c generates, reading the delimiters and
+ * flags from the cache instead of having them folded in
+ *
+ * @param *syntax The language
+ * @param *row The row
+ * @param *hl The highlight of every character, already reset
+ * @param in_comment Whether the row starts inside a multiline comment
+ * @return whether the row ends inside a multiline comment
+ */
+static int editorLanguageLex(const struct editorSyntax *syntax, erow *row,
+                             unsigned char *hl, int in_comment) {
+  const struct editorLanguageRecord *lang = syntax->compiled;
+  const char *base = (const char *)lang;
+  const unsigned char *class = lang->class;
+  const char *scs = base + lang->scs;
+  const char *mcs = base + lang->mcs;
+  const char *mce = base + lang->mce;
+  int numbers = lang->flags & HL_HIGHLIGHT_NUMBERS;
+
+  const unsigned char *s = (const unsigned char *)row->render;
+  int n = row->rsize;
+  int prev_sep = 1;
+  int in_string = 0;
+  int i = 0;
+
+  if (lang->mcslen == 0) {
+    in_comment = 0;
+  }
+
+  while (i < n) {
+    unsigned char c = s[i];
+
+    if (in_comment) {
+      int j = editorScanComment(s, i, n, (unsigned char)mce[0]);
+      memset(&hl[i], HL_MLCOMMENT, j - i);
+      i = j;
+      if (i == n) {
+        break;
+      }
+      if (strncmp(&row->render[i], mce, lang->mcelen) == 0) {
+        memset(&hl[i], HL_MLCOMMENT, lang->mcelen);
+        i += lang->mcelen;
+        in_comment = 0;
+        prev_sep = 1;
+      } else {
+        hl[i++] = HL_MLCOMMENT;
+      }
+      continue;
+    }
+
+    if (in_string) {
+      int j = editorScanString(s, i, n, in_string);
+      if (j > i) {
+        memset(&hl[i], HL_STRING, j - i);
+        i = j;
+        prev_sep = 1;
+        continue;
+      }
+      hl[i] = HL_STRING;
+      if (c == '\\' && i + 1 < n) {
+        hl[i + 1] = HL_STRING;
+        i += 2;
+        continue;
+      }
+      if (c == in_string) {
+        in_string = 0;
+      }
+      i++;
+      prev_sep = 1;
+      continue;
+    }
+
+    if (class[c] & CLASS_SPACE) {
+      i = editorScanSpaces(s, i + 1, n);
+      prev_sep = 1;
+      continue;
+    }
+
+    if (class[c] & CLASS_STOP) {
+      if (lang->scslen && strncmp(&row->render[i], scs, lang->scslen) == 0) {
+        memset(&hl[i], HL_COMMENT, n - i);
+        break;
+      }
+
+      if (lang->mcslen && strncmp(&row->render[i], mcs, lang->mcslen) == 0) {
+        memset(&hl[i], HL_MLCOMMENT, lang->mcslen);
+        i += lang->mcslen;
+        in_comment = 1;
+        continue;
+      }
+
+      if (class[c] & CLASS_QUOTE) {
+        in_string = c;
+        hl[i++] = HL_STRING;
+        continue;
+      }
+    }
+
+    if (numbers && (((class[c] & CLASS_DIGIT) &&
+                     (prev_sep || (i > 0 && hl[i - 1] == HL_NUMBER))) ||
+                    (c == '.' && i > 0 && hl[i - 1] == HL_NUMBER))) {
+      hl[i++] = HL_NUMBER;
+      prev_sep = 0;
+      continue;
+    }
+
+    if (prev_sep && !(class[c] & (CLASS_SEP | CLASS_STOP))) {
+      int j = editorScanWord(class, lang->fast, s, i + 1, n);
+      if ((class[c] & CLASS_KEYWORD) && (class[s[j]] & CLASS_SEP)) {
+        int kw = editorLanguageKeyword(lang, &row->render[i], j - i);
+        if (kw != HL_NORMAL) {
+          memset(&hl[i], kw, j - i);
+        }
+      }
+      i = j;
+      prev_sep = 0;
+      continue;
+    }
+
+    prev_sep = class[c] & CLASS_SEP;
+    i++;
+  }
+
+  return in_comment;
+}
+
+/***
+ * Only lists language definitions
+ */
+static int editorLanguageIsDefinition(const struct dirent *ent) {
+  size_t len = strlen(ent->d_name);
+  return ent->d_name[0] != '.' && len > 7 &&
+         strcmp(&ent->d_name[len - 7], ".syntax") == 0;
+}
+
+/***
+ * Copies a string into a record being compiled
+ *
+ * @param *rec The record
+ * @param *off The free space of the record, advanced past the string
+ * @param *s The string
+ * @return the offset of the string in the record
+ */
+static uint32_t editorLanguagePut(char *rec, size_t *off, const char *s) {
+  uint32_t at = *off;
+  size_t len = strlen(s) + 1;
+  memcpy(&rec[at], s, len);
+  *off += len;
+  return at;
+}
+
+/***
+ * Counts the bytes a language takes in the cache
+ *
+ * @param *def The parsed language
+ * @return the size of its record
+ */
+static size_t editorLanguageSize(struct editorSyntaxDef *def) {
+  size_t size = sizeof(struct editorLanguageRecord) +
+                sizeof(struct editorLanguageKeyword) * def->tablesize +
+                sizeof(uint32_t) * def->nmatch;
+
+  size += strlen(def->filetype) + 1;
+  for (int j = 0; j < def->nmatch; j++) {
+    size += strlen(def->match[j]) + 1;
+  }
+  size += def->scs ? strlen(def->scs) + 1 : 0;
+  size += def->mcs ? strlen(def->mcs) + strlen(def->mce) + 2 : 0;
+  for (int j = 0; j < def->tablesize; j++) {
+    if (def->table[j] != -1) {
+      size += strlen(def->words[def->table[j]]) + 1;
+    }
+  }
+
+  // the next record starts aligned
+  return (size + 7) & ~(size_t)7;
+}
+
+/***
+ * Compiles a parsed language into its cache record
+ *
+ * @param *def The parsed language
+ * @param *rec The zeroed record, editorLanguageSize bytes long
+ * @param size The size of the record
+ */
+static void editorLanguageCompile(struct editorSyntaxDef *def, char *rec,
+                                  size_t size) {
+  struct editorLanguageRecord lang;
+  memset(&lang, 0, sizeof(lang));
+  lang.size = size;
+  lang.flags = def->flags;
+  lang.mask = def->tablesize - 1;
+  lang.minlen = def->minlen;
+  lang.maxlen = def->maxlen;
+  lang.fast = def->fast;
+  memcpy(lang.class, def->class, sizeof(lang.class));
+
+  size_t off = sizeof(lang);
+  lang.keywords = off;
+  off += sizeof(struct editorLanguageKeyword) * def->tablesize;
+  lang.match = off;
+  lang.nmatch = def->nmatch;
+  off += sizeof(uint32_t) * def->nmatch;
+
+  lang.filetype = editorLanguagePut(rec, &off, def->filetype);
+  for (int j = 0; j < def->nmatch; j++) {
+    uint32_t at = editorLanguagePut(rec, &off, def->match[j]);
+    memcpy(&rec[lang.match + sizeof(uint32_t) * j], &at, sizeof(at));
+  }
+  if (def->scs) {
+    lang.scs = editorLanguagePut(rec, &off, def->scs);
+    lang.scslen = strlen(def->scs);
+  }
+  if (def->mcs) {
+    lang.mcs = editorLanguagePut(rec, &off, def->mcs);
+    lang.mcslen = strlen(def->mcs);
+    lang.mce = editorLanguagePut(rec, &off, def->mce);
+    lang.mcelen = strlen(def->mce);
+  }
+
+  for (int j = 0; j < def->tablesize; j++) {
+    int w = def->table[j];
+    if (w == -1) {
+      continue;
+    }
+    struct editorLanguageKeyword kw;
+    kw.word = editorLanguagePut(rec, &off, def->words[w]);
+    kw.len = strlen(def->words[w]);
+    kw.hl = def->hl[w];
+    memcpy(&rec[lang.keywords + sizeof(kw) * j], &kw, sizeof(kw));
+  }
+
+  memcpy(rec, &lang, sizeof(lang));
+}
+
+/***
+ * Checks that a string of a record stays inside it
+ *
+ * @return the length of the string, -1 when it runs past the record
+ */
+static int editorLanguageString(const char *rec, uint32_t size, uint32_t off) {
+  if (off == 0 || off >= size) {
+    return -1;
+  }
+  const char *end = memchr(&rec[off], '\0', size - off);
+  return end ? end - &rec[off] : -1;
+}
+
+/***
+ * Checks a record of a cache that may be truncated or corrupted
+ *
+ * @return 1 when the record can be used, 0 otherwise
+ */
+static int editorLanguageValidRecord(const char *rec, uint32_t avail) {
+  const struct editorLanguageRecord *lang =
+      (const struct editorLanguageRecord *)rec;
+  if (avail < sizeof(*lang) || lang->size > avail || lang->size % 8 ||
+      lang->size < sizeof(*lang)) {
+    return 0;
+  }
+  uint32_t size = lang->size;
+
+  if (editorLanguageString(rec, size, lang->filetype) < 0 ||
+      lang->nmatch > size / sizeof(uint32_t) || lang->match % 4 ||
+      lang->match + sizeof(uint32_t) * lang->nmatch > size) {
+    return 0;
+  }
+  for (uint32_t j = 0; j < lang->nmatch; j++) {
+    uint32_t at;
+    memcpy(&at, &rec[lang->match + sizeof(uint32_t) * j], sizeof(at));
+    if (editorLanguageString(rec, size, at) < 0) {
+      return 0;
+    }
+  }
+
+  if ((lang->scslen &&
+       editorLanguageString(rec, size, lang->scs) != (int)lang->scslen) ||
+      (lang->mcslen &&
+       (editorLanguageString(rec, size, lang->mcs) != (int)lang->mcslen ||
+        editorLanguageString(rec, size, lang->mce) != (int)lang->mcelen ||
+        lang->mcelen == 0))) {
+    return 0;
+  }
+
+  // the lookup stops at an empty slot, there has to be one
+  uint32_t slots = lang->mask + 1;
+  if ((slots & lang->mask) != 0 || lang->keywords % 4 ||
+      slots > size / sizeof(struct editorLanguageKeyword) ||
+      lang->keywords + sizeof(struct editorLanguageKeyword) * slots > size) {
+    return 0;
+  }
+  const struct editorLanguageKeyword *table =
+      (const struct editorLanguageKeyword *)(rec + lang->keywords);
+  int empty = 0;
+  for (uint32_t j = 0; j < slots; j++) {
+    if (table[j].len == 0) {
+      empty = 1;
+    } else if (editorLanguageString(rec, size, table[j].word) !=
+               table[j].len) {
+      return 0;
+    }
+  }
+  return empty;
+}
+
+/***
+ * Checks a cache before using it
+ *
+ * @param *blob The cache
+ * @param size The size of the cache
+ * @param key The hash of the definitions it must have been compiled from
+ * @return 1 when the cache can be used, 0 otherwise
+ */
+static int editorLanguageValid(const char *blob, size_t size, uint64_t key) {
+  const struct editorLanguageHeader *h =
+      (const struct editorLanguageHeader *)blob;
+  if (size < sizeof(*h) || memcmp(h->magic, KILO_LANGUAGE_MAGIC, 8) != 0 ||
+      h->key != key || h->size != size ||
+      h->count > (size - sizeof(*h)) / sizeof(uint32_t)) {
+    return 0;
+  }
+
+  const uint32_t *offsets = (const uint32_t *)(blob + sizeof(*h));
+  for (uint32_t j = 0; j < h->count; j++) {
+    if (offsets[j] % 8 || offsets[j] >= size ||
+        !editorLanguageValidRecord(blob + offsets[j], size - offsets[j])) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/***
+ * Makes the languages of a cache available to editorSelectSyntaxHighlight
+ *
+ * @param *blob The cache, it must stay mapped
+ */
+static void editorLanguageRegister(const char *blob) {
+  const struct editorLanguageHeader *h =
+      (const struct editorLanguageHeader *)blob;
+  const uint32_t *offsets = (const uint32_t *)(blob + sizeof(*h));
+
+  languages = calloc(h->count, sizeof(struct editorSyntax));
+  if (languages == NULL) {
+    return;
+  }
+
+  for (uint32_t j = 0; j < h->count; j++) {
+    const char *rec = blob + offsets[j];
+    const struct editorLanguageRecord *lang =
+        (const struct editorLanguageRecord *)rec;
+    char **match = malloc(sizeof(char *) * (lang->nmatch + 1));
+    if (match == NULL) {
+      break;
+    }
+
+    for (uint32_t k = 0; k < lang->nmatch; k++) {
+      uint32_t at;
+      memcpy(&at, &rec[lang->match + sizeof(uint32_t) * k], sizeof(at));
+      match[k] = (char *)&rec[at];
+    }
+    match[lang->nmatch] = NULL;
+
+    struct editorSyntax *s = &languages[numlanguages++];
+    s->filetype = (char *)&rec[lang->filetype];
+    s->filematch = match;
+    s->lex = editorLanguageLex;
+    s->flags = lang->flags;
+    s->compiled = lang;
+  }
+}
+
+/***
+ * Stores a compiled cache, replacing the ones of older definitions
+ *
+ * The cache is written under a temporary name and renamed so a concurrent
+ * editor never maps half of it
+ *
+ * @param *dir The cache directory
+ * @param *path The name of the cache
+ * @param *blob The cache
+ * @param size The size of the cache
+ */
+static void editorLanguageStore(const char *dir, const char *path,
+                                const char *blob, size_t size) {
+  // the parent of dir is created too, it usually is ~/.cache
+  char *parent = strdup(dir);
+  char *slash = parent ? strrchr(parent, '/') : NULL;
+  if (slash && slash != parent) {
+    *slash = '\0';
+    mkdir(parent, 0700);
+  }
+  free(parent);
+  mkdir(dir, 0700);
+
+  DIR *d = opendir(dir);
+  if (d != NULL) {
+    const char *name = strrchr(path, '/') + 1;
+    struct dirent *ent;
+    while ((ent = readdir(d))) {
+      if (strncmp(ent->d_name, "syntax-", 7) == 0 &&
+          strcmp(ent->d_name, name) != 0) {
+        unlinkat(dirfd(d), ent->d_name, 0);
+      }
+    }
+    closedir(d);
+  }
+
+  size_t len = strlen(path) + 16;
+  char *tmp = malloc(len);
+  if (tmp == NULL) {
+    return;
+  }
+  snprintf(tmp, len, "%s.%d", path, (int)getpid());
+
+  int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  if (fd != -1) {
+    int ok = write(fd, blob, size) == (ssize_t)size;
+    if (close(fd) == 0 && ok) {
+      rename(tmp, path);
+    }
+  }
+  unlink(tmp);
+  free(tmp);
+}
+
+/***
+ * Compiles the language definitions into a cache
+ *
+ * @param *defs The parsed definitions
+ * @param count The number of definitions
+ * @param key The hash of the definitions
+ * @param *size Filled with the size of the cache
+ * @return the cache, to be kept for as long as its languages are used
+ */
+static char *editorLanguageBuild(struct editorSyntaxDef *defs, int count,
+                                 uint64_t key, size_t *size) {
+  size_t total = sizeof(struct editorLanguageHeader) + sizeof(uint32_t) * count;
+  total = (total + 7) & ~(size_t)7;
+  size_t first = total;
+  for (int j = 0; j < count; j++) {
+    total += editorLanguageSize(&defs[j]);
+  }
+
+  char *blob = calloc(1, total);
+  if (blob == NULL) {
+    return NULL;
+  }
+
+  struct editorLanguageHeader h;
+  memcpy(h.magic, KILO_LANGUAGE_MAGIC, 8);
+  h.key = key;
+  h.size = total;
+  h.count = count;
+  memcpy(blob, &h, sizeof(h));
+
+  size_t off = first;
+  for (int j = 0; j < count; j++) {
+    uint32_t at = off;
+    size_t len = editorLanguageSize(&defs[j]);
+    memcpy(&blob[sizeof(h) + sizeof(uint32_t) * j], &at, sizeof(at));
+    editorLanguageCompile(&defs[j], &blob[off], len);
+    off += len;
+  }
+
+  *size = total;
+  return blob;
+}
+
+/***
+ * Loads the language definitions of the user's syntax directory
+ *
+ * Definitions are compiled once into a cache keyed by the hash of their
+ * contents, later starts only read the definitions to hash them and map the
+ * cache. Languages loaded here win over the built in ones
+ */
+void editorLanguageLoad() {
+  char *dir = editorFileXdgPath("XDG_CONFIG_HOME", ".config", "kilo/syntax");
+  struct dirent **names = NULL;
+  int count = dir ? scandir(dir, &names, editorLanguageIsDefinition,
+                            alphasort)
+                  : -1;
+  if (count <= 0) {
+    free(names);
+    free(dir);
+    return;
+  }
+
+  char **texts = calloc(count, sizeof(char *));
+  size_t *lens = calloc(count, sizeof(size_t));
+  uint64_t key = editorRowHash(KILO_LANGUAGE_MAGIC, 8);
+  int loaded = 0;
+
+  for (int j = 0; texts && lens && j < count; j++) {
+    size_t len = strlen(dir) + strlen(names[j]->d_name) + 2;
+    char *path = malloc(len);
+    if (path) {
+      snprintf(path, len, "%s/%s", dir, names[j]->d_name);
+      texts[j] = editorFileRead(path, &lens[j]);
+      free(path);
+    }
+    if (texts[j] == NULL) {
+      editorSetStatusMessage("Can't read syntax '%s': %s", names[j]->d_name,
+                             strerror(errno));
+      continue;
+    }
+
+    key = (key ^ editorRowHash(names[j]->d_name, strlen(names[j]->d_name))) *
+          0x100000001b3ULL;
+    key = (key ^ editorRowHash(texts[j], lens[j])) * 0x100000001b3ULL;
+    loaded++;
+  }
+
+  char *cachedir = editorFileXdgPath("XDG_CACHE_HOME", ".cache", "kilo");
+  char *path = cachedir ? malloc(strlen(cachedir) + 32) : NULL;
+  if (path) {
+    sprintf(path, "%s/syntax-%016llx.bin", cachedir, (unsigned long long)key);
+  }
+
+  // a cache of the same definitions is mapped and used as it is
+  int fd = path ? open(path, O_RDONLY) : -1;
+  struct stat st;
+  if (fd != -1 && fstat(fd, &st) == 0 && st.st_size > 0) {
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED && editorLanguageValid(map, st.st_size, key)) {
+      editorLanguageRegister(map);
+      loaded = 0;
+    } else if (map != MAP_FAILED) {
+      munmap(map, st.st_size);
+    }
+  }
+  if (fd != -1) {
+    close(fd);
+  }
+
+  if (loaded && texts && lens) {
+    struct editorSyntaxDef *defs = calloc(count, sizeof(struct editorSyntaxDef));
+    int ndefs = 0, failed = loaded != count;
+
+    for (int j = 0; defs && j < count; j++) {
+      char err[80];
+      if (texts[j] == NULL) {
+        continue;
+      }
+      if (editorSyntaxDefParse(&defs[ndefs], names[j]->d_name, texts[j],
+                               lens[j], err, sizeof(err)) == -1) {
+        editorSetStatusMessage("Syntax error: %s", err);
+        failed = 1;
+        continue;
+      }
+      ndefs++;
+    }
+
+    size_t size;
+    char *blob = defs ? editorLanguageBuild(defs, ndefs, key, &size) : NULL;
+    if (blob != NULL) {
+      editorLanguageRegister(blob);
+      // broken definitions are parsed again until they are fixed
+      if (!failed && path) {
+        editorLanguageStore(cachedir, path, blob, size);
+      }
+    }
+
+    for (int j = 0; j < ndefs; j++) {
+      editorSyntaxDefFree(&defs[j]);
+    }
+    free(defs);
+  }
+
+  for (int j = 0; j < count; j++) {
+    if (texts) {
+      free(texts[j]);
+    }
+    free(names[j]);
+  }
+  free(names);
+  free(texts);
+  free(lens);
+  free(path);
+  free(cachedir);
+  free(dir);
+}
+
+/***
+ * Lists the languages loaded from the user's syntax directory
+ *
+ * @param *count Filled with the number of languages
+ * @return the languages
+ */
+struct editorSyntax *editorLanguages(int *count) {
+  *count = numlanguages;
+  return languages;
+}
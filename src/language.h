@@ -0,0 +1,9 @@
+#ifndef LANGUAGE_H_
+#define LANGUAGE_H_
+
+#include "typedefs.h"
+
+void editorLanguageLoad();
+struct editorSyntax *editorLanguages(int *count);
+
+#endif // !#ifndef LANGUAGE_H_
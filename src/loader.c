@@ -0,0 +1,384 @@
+#include "loader.h"
+#include "compress.h"
+#include "event.h"
+#include "input.h"
+#include "journal.h"
+#include "row.h"
+#include "rowcache.h"
+#include "trigram.h"
+#include <pthread.h>
+
+struct editorLoaderChunk {
+  char *data;
+  size_t len;
+  size_t offset; // how far into the file on disk the chunk ends
+  struct editorTrigramBatch *trigrams; // the search index of the lines
+  struct editorLoaderChunk *next;
+};
+
+struct editorLoader {
+  struct editorBuffer *buf;
+  struct editorStream *in;
+  struct editorRowCache *cache; // what is known of the rows, NULL if nothing
+  int index; // whether the reader thread builds the search index too
+  int wake[2]; // one byte is written for every queued chunk
+
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+
+  // shared with the reader thread, guarded by lock
+  struct editorLoaderChunk *head;
+  struct editorLoaderChunk *tail;
+  int queued;
+  int done;
+  int error;
+  int cancel;
+
+  // only touched by the main thread
+  size_t total;
+  size_t loaded; // offset in the file on disk of the last appended chunk
+};
+
+/***
+ * Hands a block of whole lines to the main thread
+ *
+ * Blocks while the queue is full so a slow terminal does not let the whole
+ * file pile up in memory twice. The search index of the lines is built
+ * here, off the main thread
+ *
+ * @param *ld The loader
+ * @param *data The lines, ownership passes to the queue
+ * @param len The length of data
+ * @return 0 on success, -1 if the load was cancelled
+ */
+static int editorLoaderPush(struct editorLoader *ld, char *data, size_t len) {
+  struct editorLoaderChunk *chunk = malloc(sizeof(struct editorLoaderChunk));
+  if (chunk == NULL) {
+    free(data);
+    return -1;
+  }
+  chunk->data = data;
+  chunk->len = len;
+  chunk->offset = editorStreamOffset(ld->in);
+  chunk->trigrams = ld->index ? editorTrigramBatchBuild(data, len) : NULL;
+  chunk->next = NULL;
+
+  pthread_mutex_lock(&ld->lock);
+  while (ld->queued >= KILO_LOAD_QUEUE && !ld->cancel) {
+    pthread_cond_wait(&ld->cond, &ld->lock);
+  }
+  if (ld->cancel) {
+    pthread_mutex_unlock(&ld->lock);
+    editorTrigramBatchFree(chunk->trigrams);
+    free(data);
+    free(chunk);
+    return -1;
+  }
+
+  if (ld->tail) {
+    ld->tail->next = chunk;
+  } else {
+    ld->head = chunk;
+  }
+  ld->tail = chunk;
+  ld->queued++;
+  pthread_mutex_unlock(&ld->lock);
+
+  write(ld->wake[1], "c", 1);
+  return 0;
+}
+
+/***
+ * Marks the end of the file, or a read error, and wakes the main thread
+ */
+static void editorLoaderFinish(struct editorLoader *ld, int error) {
+  pthread_mutex_lock(&ld->lock);
+  ld->done = 1;
+  ld->error = error;
+  pthread_mutex_unlock(&ld->lock);
+
+  write(ld->wake[1], "d", 1);
+}
+
+/***
+ * Reads the file in KILO_LOAD_CHUNK blocks and queues them cut at the last
+ * newline, the partial line is carried over to the next block
+ *
+ * A line longer than a block is read into the same block, doubled as often
+ * as needed, so it is copied a bounded number of times
+ *
+ * @param *arg The loader
+ */
+static void *editorLoaderThread(void *arg) {
+  struct editorLoader *ld = arg;
+  char *block = NULL;
+  size_t len = 0; // bytes in the block, all of them in a single line
+  size_t cap = 0;
+
+  while (1) {
+    if (cap - len < KILO_LOAD_CHUNK) {
+      size_t grown = cap ? cap * 2 : KILO_LOAD_CHUNK;
+      while (grown - len < KILO_LOAD_CHUNK) {
+        grown *= 2;
+      }
+      char *new = realloc(block, grown);
+      if (new == NULL) {
+        free(block);
+        editorLoaderFinish(ld, ENOMEM);
+        return NULL;
+      }
+      block = new;
+      cap = grown;
+    }
+
+    ssize_t n = editorStreamRead(ld->in, block + len, KILO_LOAD_CHUNK);
+
+    if (n <= 0) {
+      // the last line may not end with a newline
+      int error = (n == -1) ? errno : 0;
+      if (len) {
+        editorLoaderPush(ld, block, len);
+      } else {
+        free(block);
+      }
+      editorLoaderFinish(ld, error);
+      return NULL;
+    }
+
+    // only the bytes just read can hold a newline
+    char *start = block + len;
+    char *end = start + n;
+    while (end > start && end[-1] != '\n') {
+      end--;
+    }
+    len += n;
+    if (end == start) {
+      // a single line longer than the block, keep reading
+      continue;
+    }
+
+    size_t carrylen = len - (end - block);
+    char *next = malloc(carrylen + KILO_LOAD_CHUNK);
+    if (next == NULL) {
+      free(block);
+      editorLoaderFinish(ld, ENOMEM);
+      return NULL;
+    }
+    memcpy(next, end, carrylen);
+
+    if (editorLoaderPush(ld, block, end - block) == -1) {
+      free(next);
+      return NULL;
+    }
+    block = next;
+    len = carrylen;
+    cap = carrylen + KILO_LOAD_CHUNK;
+  }
+}
+
+/***
+ * Joins the reader thread and releases everything the loader holds
+ */
+static void editorLoaderFree(struct editorLoader *ld) {
+  pthread_join(ld->thread, NULL);
+  editorEventRemove(ld->wake[0]);
+
+  while (ld->head) {
+    struct editorLoaderChunk *next = ld->head->next;
+    editorTrigramBatchFree(ld->head->trigrams);
+    free(ld->head->data);
+    free(ld->head);
+    ld->head = next;
+  }
+
+  close(ld->wake[0]);
+  close(ld->wake[1]);
+  editorStreamClose(ld->in);
+  editorRowCacheClose(ld->cache);
+  pthread_mutex_destroy(&ld->lock);
+  pthread_cond_destroy(&ld->cond);
+  ld->buf->loader = NULL;
+  free(ld);
+}
+
+/***
+ * Appends the queued chunks to the buffer, runs on the main thread
+ *
+ * @param fd The read end of the wake pipe
+ * @param *arg The loader
+ */
+static void editorLoaderReady(int fd, void *arg) {
+  struct editorLoader *ld = arg;
+  char wake[KILO_LOAD_BATCH];
+
+  ssize_t n = read(fd, wake, sizeof(wake));
+  if (n <= 0) {
+    return;
+  }
+
+  struct editorBuffer *saved = E.buf;
+  E.buf = ld->buf;
+
+  int finished = 0;
+  for (ssize_t j = 0; j < n; j++) {
+    if (wake[j] == 'd') {
+      finished = 1;
+      continue;
+    }
+
+    pthread_mutex_lock(&ld->lock);
+    struct editorLoaderChunk *chunk = ld->head;
+    ld->head = chunk->next;
+    if (ld->head == NULL) {
+      ld->tail = NULL;
+    }
+    ld->queued--;
+    pthread_cond_signal(&ld->cond);
+    pthread_mutex_unlock(&ld->lock);
+
+    if (chunk->trigrams != NULL) {
+      editorTrigramAdopt(chunk->trigrams);
+    }
+
+    // once a chunk is not what the cache has the rest is worked out
+    if (ld->cache != NULL &&
+        editorRowCacheAppend(ld->cache, chunk->data, chunk->len) == -1) {
+      editorRowCacheClose(ld->cache);
+      ld->cache = NULL;
+    }
+    if (ld->cache == NULL) {
+      editorAppendLines(chunk->data, chunk->len);
+    }
+    editorTrigramAdoptDone();
+    editorTrigramBatchFree(chunk->trigrams);
+    ld->loaded = chunk->offset;
+    free(chunk->data);
+    free(chunk);
+  }
+
+  E.buf = saved;
+
+  if (finished) {
+    struct editorBuffer *buf = ld->buf;
+    int error = ld->error;
+    editorLoaderFree(ld);
+
+    if (error) {
+      editorSetStatusMessage("Error reading '%s': %s", buf->filename,
+                             strerror(error));
+    } else {
+      editorSetStatusMessage("\"%s\" %d lines loaded", buf->filename,
+                             buf->numrows);
+
+      struct editorBuffer *saved = E.buf;
+      E.buf = buf;
+      editorRowCacheSave(buf);
+      editorJournalRecover(buf);
+      E.buf = saved;
+    }
+  }
+}
+
+/***
+ * Starts reading a file into a buffer on a background thread
+ *
+ * Rows are appended as whole lines arrive, the buffer can be viewed and
+ * edited meanwhile. The loader owns the stream from here on.
+ *
+ * @param *buf The buffer to fill, it should be empty
+ * @param *in The file to read
+ * @param total The size of the file on disk, used for the progress
+ * @param *cache What is known of the rows of the file, NULL if nothing,
+ * owned by the loader too once it started
+ * @return 0 on success, -1 if the thread could not be started
+ */
+int editorLoaderStart(struct editorBuffer *buf, struct editorStream *in,
+                      size_t total, struct editorRowCache *cache) {
+  struct editorLoader *ld = malloc(sizeof(struct editorLoader));
+  if (ld == NULL) {
+    return -1;
+  }
+
+  ld->buf = buf;
+  ld->in = in;
+  ld->cache = cache;
+  ld->index = buf->trigrams != NULL;
+  ld->head = NULL;
+  ld->tail = NULL;
+  ld->queued = 0;
+  ld->done = 0;
+  ld->error = 0;
+  ld->cancel = 0;
+  ld->total = total;
+  ld->loaded = 0;
+
+  if (pipe(ld->wake) == -1) {
+    free(ld);
+    return -1;
+  }
+  pthread_mutex_init(&ld->lock, NULL);
+  pthread_cond_init(&ld->cond, NULL);
+
+  if (editorEventAdd(ld->wake[0], editorLoaderReady, ld) == -1 ||
+      pthread_create(&ld->thread, NULL, editorLoaderThread, ld) != 0) {
+    editorEventRemove(ld->wake[0]);
+    close(ld->wake[0]);
+    close(ld->wake[1]);
+    pthread_mutex_destroy(&ld->lock);
+    pthread_cond_destroy(&ld->cond);
+    free(ld);
+    return -1;
+  }
+
+  buf->loader = ld;
+  return 0;
+}
+
+/***
+ * Stops loading a buffer, the rows read so far are kept
+ *
+ * @param *buf The buffer
+ */
+void editorLoaderCancel(struct editorBuffer *buf) {
+  struct editorLoader *ld = buf->loader;
+  if (ld == NULL) {
+    return;
+  }
+
+  pthread_mutex_lock(&ld->lock);
+  ld->cancel = 1;
+  pthread_cond_signal(&ld->cond);
+  pthread_mutex_unlock(&ld->lock);
+
+  editorLoaderFree(ld);
+}
+
+/***
+ * Appends the rest of a buffer's file before going on, for buffers that
+ * can't be edited until all of it is read
+ *
+ * @param *buf The buffer
+ */
+void editorLoaderWait(struct editorBuffer *buf) {
+  while (buf->loader != NULL) {
+    editorLoaderReady(buf->loader->wake[0], buf->loader);
+  }
+}
+
+/***
+ * Tells how far a buffer is loaded
+ *
+ * @param *buf The buffer
+ * @return the percentage of the file read, -1 if it is not loading
+ */
+int editorLoaderProgress(struct editorBuffer *buf) {
+  struct editorLoader *ld = buf->loader;
+  if (ld == NULL) {
+    return -1;
+  }
+  if (ld->total == 0) {
+    return 0;
+  }
+  return (int)(ld->loaded * 100 / ld->total);
+}
@@ -0,0 +1,15 @@
+#ifndef LOADER_H_
+#define LOADER_H_
+
+#include "typedefs.h"
+
+struct editorStream;
+struct editorRowCache;
+
+int editorLoaderStart(struct editorBuffer *buf, struct editorStream *in,
+                      size_t total, struct editorRowCache *cache);
+void editorLoaderCancel(struct editorBuffer *buf);
+void editorLoaderWait(struct editorBuffer *buf);
+int editorLoaderProgress(struct editorBuffer *buf);
+
+#endif // !#ifndef LOADER_H_
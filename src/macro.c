@@ -0,0 +1,178 @@
+#include "macro.h"
+
+// the keys recorded by q, one list per register a to z
+struct editorMacro {
+  int *keys;
+  int len;
+};
+
+// a macro being replayed, the keys are those of the macro when it started
+struct editorMacroFrame {
+  const int *keys;
+  int len;
+  int pos;
+  int times; // replays left, this one included
+};
+
+static struct editorMacro macros[26];
+static int last_played = 0;
+
+static int recording = 0; // the register recorded into, 0 when none
+static int *reckeys = NULL;
+static int reclen = 0;
+static int reccap = 0;
+
+static struct editorMacroFrame frames[KILO_MACRO_DEPTH];
+static int depth = 0;
+
+/***
+ * Starts recording the keys typed into a register
+ *
+ * @param name The register, a to z
+ * @return 0 on success, -1 for an unknown register or while replaying
+ */
+int editorMacroRecord(int name) {
+  if (name < 'a' || name > 'z' || depth > 0) {
+    return -1;
+  }
+  recording = name;
+  reclen = 0;
+  return 0;
+}
+
+/***
+ * Stops recording, the q that stopped it is not part of the macro
+ */
+void editorMacroStop() {
+  if (recording == 0) {
+    return;
+  }
+  if (reclen > 0) {
+    reclen--;
+  }
+
+  struct editorMacro *m = &macros[recording - 'a'];
+  int *keys = malloc(sizeof(int) * (reclen ? reclen : 1));
+  if (keys != NULL) {
+    memcpy(keys, reckeys, sizeof(int) * reclen);
+    free(m->keys);
+    m->keys = keys;
+    m->len = reclen;
+  }
+  recording = 0;
+}
+
+/***
+ * Tells which register is being recorded
+ *
+ * @return its name, 0 when nothing is recorded
+ */
+int editorMacroRecording() { return recording; }
+
+/***
+ * Records a key read from the terminal
+ *
+ * @param key The decoded key
+ */
+void editorMacroKey(int key) {
+  if (recording == 0) {
+    return;
+  }
+  if (reclen == reccap) {
+    int cap = reccap ? reccap * 2 : 64;
+    int *new = realloc(reckeys, sizeof(int) * cap);
+    if (new == NULL) {
+      return;
+    }
+    reckeys = new;
+    reccap = cap;
+  }
+  reckeys[reclen++] = key;
+}
+
+/***
+ * Queues the keys of a macro to be read instead of the terminal's
+ *
+ * @param name The register, a to z, or @ for the last one replayed
+ * @param times How many times to replay it
+ * @return 0 on success, -1 if the register is empty or macros are nested
+ * too deep
+ */
+int editorMacroPlay(int name, int times) {
+  if (name == '@') {
+    name = last_played;
+  }
+  if (name < 'a' || name > 'z' || macros[name - 'a'].keys == NULL ||
+      depth == KILO_MACRO_DEPTH) {
+    return -1;
+  }
+  last_played = name;
+
+  struct editorMacro *m = &macros[name - 'a'];
+  if (m->len == 0 || times <= 0) {
+    return 0;
+  }
+  frames[depth].keys = m->keys;
+  frames[depth].len = m->len;
+  frames[depth].pos = 0;
+  frames[depth].times = times;
+  depth++;
+  return 0;
+}
+
+/***
+ * Drops the macros that have no keys left
+ */
+static void editorMacroUnwind() {
+  while (depth > 0) {
+    struct editorMacroFrame *f = &frames[depth - 1];
+    if (f->pos < f->len) {
+      return;
+    }
+    if (--f->times > 0) {
+      f->pos = 0;
+      return;
+    }
+    depth--;
+  }
+}
+
+/***
+ * Takes the next key of the macros being replayed
+ *
+ * @param *key Filled with the key
+ * @return 1 if there was one, 0 when nothing is replayed
+ */
+int editorMacroNext(int *key) {
+  editorMacroUnwind();
+  if (depth == 0) {
+    return 0;
+  }
+  struct editorMacroFrame *f = &frames[depth - 1];
+  *key = f->keys[f->pos++];
+  return 1;
+}
+
+/***
+ * Looks at the next key to be replayed without taking it
+ *
+ * @return the key, -1 when nothing is replayed
+ */
+int editorMacroPeek() {
+  editorMacroUnwind();
+  if (depth == 0) {
+    return -1;
+  }
+  struct editorMacroFrame *f = &frames[depth - 1];
+  return f->keys[f->pos];
+}
+
+/***
+ * Tells whether keys are being replayed, the screen is not drawn meanwhile
+ *
+ * @return 1 while replaying, 0 otherwise
+ */
+int editorMacroReplaying() {
+  editorMacroUnwind();
+  return depth > 0;
+}
@@ -0,0 +1,15 @@
+#ifndef MACRO_H_
+#define MACRO_H_
+
+#include "typedefs.h"
+
+int editorMacroRecord(int name);
+void editorMacroStop();
+int editorMacroRecording();
+void editorMacroKey(int key);
+int editorMacroPlay(int name, int times);
+int editorMacroNext(int *key);
+int editorMacroPeek();
+int editorMacroReplaying();
+
+#endif // !#ifndef MACRO_H_
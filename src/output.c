@@ -1,8 +1,19 @@
 #include "output.h"
 #include "append.h"
+#include "cursor.h"
+#include "diff.h"
+#include "gutter.h"
+#include "loader.h"
+#include "macro.h"
+#include "range.h"
 #include "row.h"
 #include "syntax.h"
+#include "theme.h"
 #include "typedefs.h"
+#include "utf8.h"
+#include "window.h"
+#include "writer.h"
+#include <limits.h>
 #include <stdio.h>
 
 /***
@@ -10,8 +21,9 @@
  */
 void editorScroll() {
   E.rx = E.cx;
-  if (E.cy < E.numrows) {
-    E.rx = editorRowToRx(&E.row[E.cy], E.cx);
+  if (E.cy < E.buf->numrows) {
+    E.rx = editorRowToRx(&E.buf->row[E.cy], E.cx - KILO_SIGN_COLUMN) +
+           KILO_SIGN_COLUMN;
   }
 
   // vertical scroll
@@ -23,34 +35,346 @@ void editorScroll() {
   }
 
   // horizontal scroll
-  if (E.rx < E.coloff) {
-    E.coloff = E.rx;
+  if (E.rx - KILO_SIGN_COLUMN < E.coloff) {
+    E.coloff = E.rx - KILO_SIGN_COLUMN;
   }
   if (E.rx >= E.coloff + E.screencols) {
     E.coloff = E.rx - E.screencols + 1;
   }
 }
 
+/***
+ * Sets the style of the theme the next cells are drawn with
+ *
+ * @param *ab The append buffer
+ * @param *style The style set on the terminal, updated
+ * @param to The style wanted
+ */
+static void editorDrawStyle(struct abuf *ab, int *style, int to) {
+  if (to != *style) {
+    int len;
+    const char *seq = editorThemeSeq(*style, to, &len);
+    abAppend(ab, (char *)seq, len);
+    *style = to;
+  }
+}
+
+/***
+ * Draws a single cell, either a byte or a whole grapheme cluster
+ *
+ * @param *ab The append buffer
+ * @param *c The bytes of the cell
+ * @param len The number of bytes in the cell
+ * @param hl The highlight of the cell
+ * @param *style The style currently set on the terminal
+ * @return 1 when drawing the cell turned reverse video off, 0 otherwise
+ */
+static int editorDrawCell(struct abuf *ab, char *c, int len, unsigned char hl,
+                          int *style) {
+  unsigned char u = c[0];
+  if (u < 0x20 || u == 0x7f || (len == 1 && u >= 0x80)) {
+    // control characters and bytes that are not valid UTF-8
+    char sym = (u <= 26) ? '@' + u : '?';
+    abAppend(ab, "\x1b[7m", 4);
+    abAppend(ab, &sym, 1);
+    abAppend(ab, "\x1b[m", 3);
+    int current = *style;
+    *style = THEME_RESET;
+    editorDrawStyle(ab, style, current);
+    return 1;
+  }
+  editorDrawStyle(ab, style, hl);
+  abAppend(ab, c, len);
+  return 0;
+}
+
+/***
+ * Finds where the next extra cursor of a row is drawn
+ *
+ * @param *row The row
+ * @param **cur The cursors of the row left to draw, advanced past it
+ * @param *count The number of cursors left, decremented
+ * @param from Cursors drawn before this offset in the render are skipped
+ * @return the offset of the cursor in the render, INT_MAX if none is left
+ */
+static int editorDrawNextCursor(erow *row, const struct editorCursor **cur,
+                                int *count, int from) {
+  while (*count > 0) {
+    int off = editorRowCxToRender(row, (*cur)->cx - KILO_SIGN_COLUMN);
+    (*cur)++;
+    (*count)--;
+    if (off >= from) {
+      return off;
+    }
+  }
+  return INT_MAX;
+}
+
+/***
+ * Turns reverse video on or off
+ *
+ * @param *ab The append buffer
+ * @param *reversed Whether it is on, updated
+ * @param reverse Whether it should be on
+ */
+static void editorDrawReverse(struct abuf *ab, int *reversed, int reverse) {
+  if (reverse != *reversed) {
+    if (reverse) {
+      abAppend(ab, "\x1b[7m", 4);
+    } else {
+      abAppend(ab, "\x1b[27m", 5);
+    }
+    *reversed = reverse;
+  }
+}
+
+/***
+ * Draws the visible part of a row
+ *
+ * @param *ab The append buffer
+ * @param *row The row to draw
+ * @param textcols The number of columns available for text
+ * @param *sel The visual selection, NULL if there is none
+ * @return the number of columns drawn
+ */
+int editorDrawRow(struct abuf *ab, erow *row, int textcols,
+                  const struct editorRange *sel) {
+  int style = THEME_RESET;
+  int reversed = 0;
+  int drawn = 0;
+  int end_visible;
+
+  struct editorSpanIter it;
+  if (editorSyntaxIterInit(row, &it) == -1) {
+    return 0;
+  }
+
+  int ncur;
+  const struct editorCursor *cur = editorCursorsOnRow(row->idx, &ncur);
+  int mark = editorDrawNextCursor(row, &cur, &ncur, E.coloff);
+
+  // the part of the row inside the selection, as offsets in the render
+  int sel_from = INT_MAX;
+  int sel_to = INT_MAX;
+  int sel_newline = 0;
+  if (sel != NULL && row->idx >= sel->top && row->idx <= sel->bottom) {
+    int from, to;
+    editorRangeRow(sel, row->idx, &from, &to);
+    sel_from = editorRowCxToRender(row, from);
+    sel_to = editorRowCxToRender(row, to);
+    sel_newline = sel->type == RANGE_LINES ||
+                  (sel->type == RANGE_CHARS && row->idx < sel->bottom);
+  }
+
+  if (row->ascii) {
+    int len = row->rsize - E.coloff;
+    if (len < 0) {
+      len = 0;
+    }
+    if (len > textcols) {
+      len = textcols;
+    }
+    char *c = &row->render[E.coloff];
+
+    for (int j = 0; j < len; j++) {
+      int i = E.coloff + j;
+      editorDrawReverse(ab, &reversed,
+                        i == mark || (i >= sel_from && i < sel_to));
+      if (editorDrawCell(ab, &c[j], 1, editorSyntaxAt(&it, i),
+                         &style)) {
+        reversed = 0;
+      }
+      if (i == mark) {
+        mark = editorDrawNextCursor(row, &cur, &ncur, i + 1);
+      }
+    }
+    drawn = len;
+    end_visible = row->rsize >= E.coloff;
+  } else {
+    int col = 0;
+    int i = 0;
+    while (i < row->rsize && col < E.coloff + textcols) {
+      int w;
+      int n = utf8ClusterLen(&row->render[i], row->rsize - i, &w);
+      if (col >= E.coloff) {
+        if (col + w > E.coloff + textcols) {
+          break;
+        }
+        if (mark < i) {
+          mark = editorDrawNextCursor(row, &cur, &ncur, i);
+        }
+        editorDrawReverse(ab, &reversed,
+                          i == mark || (i >= sel_from && i < sel_to));
+        if (editorDrawCell(ab, &row->render[i], n, editorSyntaxAt(&it, i),
+                           &style)) {
+          reversed = 0;
+        }
+      } else if (col + w > E.coloff) {
+        // a wide character cut in half by the left edge
+        editorDrawReverse(ab, &reversed, 0);
+        for (int k = E.coloff; k < col + w; k++) {
+          abAppend(ab, " ", 1);
+        }
+      }
+      col += w;
+      i += n;
+    }
+    drawn = (col > E.coloff) ? col - E.coloff : 0;
+    if (mark < i) {
+      mark = editorDrawNextCursor(row, &cur, &ncur, i);
+    }
+    end_visible = i == row->rsize && col >= E.coloff;
+  }
+
+  // a cursor past the end of the row, or its selected newline
+  if (end_visible && drawn < textcols &&
+      (mark == row->rsize || (sel_newline && sel_to == row->rsize))) {
+    editorDrawReverse(ab, &reversed, 1);
+    abAppend(ab, " ", 1);
+    drawn++;
+  }
+  editorDrawReverse(ab, &reversed, 0);
+  editorDrawStyle(ab, &style, THEME_RESET);
+  return drawn;
+}
+
+/***
+ * Moves the terminal cursor
+ *
+ * @param *ab The append buffer
+ * @param row The terminal row, from 0
+ * @param col The terminal column, from 0
+ */
+static void editorMoveTo(struct abuf *ab, int row, int col) {
+  char buf[32];
+  int len = snprintf(buf, sizeof(buf), "\x1b[%d;%dH", row + 1, col + 1);
+  abAppend(ab, buf, len);
+}
+
+/***
+ * Finishes a window line: clears what is left of it and draws the separator
+ * when another window sits to the right
+ *
+ * @param *ab The append buffer
+ * @param *win The window
+ * @param drawn The number of columns already drawn on the line
+ */
+static void editorDrawLineEnd(struct abuf *ab, struct editorWindow *win,
+                              int drawn) {
+  if (win->left + win->cols >= E.termcols) {
+    abAppend(ab, "\x1b[K", 3); // clear line
+    return;
+  }
+
+  while (drawn++ < win->cols) {
+    abAppend(ab, " ", 1);
+  }
+  abAppend(ab, "\x1b[7m|\x1b[m", 8);
+}
+
+/***
+ * Moves the lines already on the screen when a window only scrolled
+ * vertically, so that just the lines scrolled in need drawing
+ *
+ * The lines are moved with index and reverse index inside a scroll region
+ * (DECSTBM) set around the window, which only works for windows as wide
+ * as the terminal
+ *
+ * @param *ab The append buffer
+ * @param *win The window, it must be loaded into E
+ * @param delta How many rows the window scrolled, positive towards the end
+ * @return 0 if the lines were moved, -1 if the window must be redrawn
+ */
+static int editorScrollRegion(struct abuf *ab, struct editorWindow *win,
+                              int delta) {
+  int n = (delta > 0) ? delta : -delta;
+  if (delta == 0 || n >= E.screenrows || win->left != 0 ||
+      win->cols < E.termcols) {
+    return -1;
+  }
+
+  char buf[32];
+  int len = snprintf(buf, sizeof(buf), "\x1b[%d;%dr", win->top + 1,
+                     win->top + E.screenrows);
+  abAppend(ab, buf, len);
+  // index at the bottom margin pulls the lines up, reverse index at the top
+  // one pushes them down. The letters are apart from the escape so they
+  // aren't read as hex digits
+  if (delta > 0) {
+    editorMoveTo(ab, win->top + E.screenrows - 1, 0);
+    for (int j = 0; j < n; j++) {
+      abAppend(ab, "\x1b" "D", 2);
+    }
+  } else {
+    editorMoveTo(ab, win->top, 0);
+    for (int j = 0; j < n; j++) {
+      abAppend(ab, "\x1b" "M", 2);
+    }
+  }
+  abAppend(ab, "\x1b[r", 3);
+
+  // the damage moves along with the lines, the ones scrolled in are new
+  if (delta > 0) {
+    memmove(win->damage, &win->damage[n], E.screenrows - n);
+    memset(&win->damage[E.screenrows - n], 1, n);
+  } else {
+    memmove(&win->damage[n], win->damage, E.screenrows - n);
+    memset(win->damage, 1, n);
+  }
+  win->drawn_rowoff = E.rowoff;
+  return 0;
+}
+
 /*
- * Draws information to the screen
+ * Draws the damaged lines of a window
+ *
+ * @param *ab The append buffer
+ * @param *win The window, it must be loaded into E
  */
-void editorDrawRows(struct abuf *ab) {
+void editorDrawRows(struct abuf *ab, struct editorWindow *win) {
+  int full = (win->drawn_rowoff != E.rowoff || win->drawn_coloff != E.coloff);
+  if (full && win->drawn_rowoff >= 0 && win->drawn_coloff == E.coloff &&
+      editorScrollRegion(ab, win, E.rowoff - win->drawn_rowoff) == 0) {
+    full = 0;
+  }
+  int textcols = E.screencols - KILO_SIGN_COLUMN;
+  // the selection is only shown in the window it is made in
+  struct editorRange range;
+  struct editorRange *sel = NULL;
+  if (win == E.win && editorVisualRange(&range) == 0) {
+    sel = &range;
+  }
+  // relative numbers follow the cursor, the text next to them does not
+  int gutter = (E.gutter & GUTTER_RELATIVE) && win->drawn_cy != E.cy;
+
   for (int y = 0; y < E.screenrows; y++) {
+    if (!full && !win->damage[y]) {
+      if (gutter) {
+        editorMoveTo(ab, win->top + y, win->left);
+        editorDrawSignColumn(ab, y + E.rowoff);
+      }
+      continue;
+    }
+    win->damage[y] = 0;
+
     int filerow = y + E.rowoff;
+    int drawn = KILO_SIGN_COLUMN;
 
+    editorMoveTo(ab, win->top + y, win->left);
     editorDrawSignColumn(ab, filerow);
 
-    if (filerow >= E.numrows) {
-      if (E.numrows == 0 && filerow == E.screenrows / 3) {
+    if (filerow >= E.buf->numrows) {
+      if (E.buf->numrows == 0 && filerow == E.screenrows / 3) {
         char welcome[80];
         int welcomelen = snprintf(welcome, sizeof(welcome),
                                   "Kilo Editor -- Version %s", KILO_VERSION);
 
-        if (welcomelen > E.screencols) {
-          welcomelen = E.screencols;
+        if (welcomelen > textcols) {
+          welcomelen = textcols;
         }
 
-        int padding = (E.screencols - welcomelen) / 2;
+        int padding = (textcols - welcomelen) / 2;
+        drawn += padding + welcomelen;
         if (padding) {
           // Add some padding
           abAppend(ab, "~", 1);
@@ -64,62 +388,29 @@ void editorDrawRows(struct abuf *ab) {
         abAppend(ab, welcome, welcomelen);
       } else {
         abAppend(ab, "~", 1);
+        drawn++;
       }
     } else {
-      int len = E.row[filerow].rsize - E.coloff;
-      if (len < 0) {
-        len = 0;
-      }
-      if (len > E.screencols) {
-        len = E.screencols;
-      }
-      char *c = &E.row[filerow].render[E.coloff];
-      unsigned char *hl = &E.row[filerow].hl[E.coloff];
-      int current_color = -1;
-
-      for (int j = 0; j < len; j++) {
-        if (iscntrl(c[j])) {
-          char sym = (c[j] <= 26) ? '@' + c[j] : '?';
-          abAppend(ab, "\x1b[7m", 4);
-          abAppend(ab, &sym, 1);
-          abAppend(ab, "\x1b[m", 3);
-          if (current_color != -1) {
-            char buf[16];
-            int clen = snprintf(buf, sizeof buf, "\x1b[%dm", current_color);
-            abAppend(ab, buf, clen);
-          }
-        } else if (hl[j] == HL_NORMAL) {
-          if (current_color != -1) {
-            abAppend(ab, "\x1b[39m", 5);
-            current_color = -1;
-          }
-          abAppend(ab, &c[j], 1);
-        } else {
-          int color = editorSyntaxToColor(hl[j]);
-          if (color != current_color) {
-            current_color = color;
-            char buf[16];
-            int clen = snprintf(buf, sizeof(buf), "\x1b[%dm", color);
-            abAppend(ab, buf, clen);
-          }
-          abAppend(ab, &c[j], 1);
-        }
-      }
-      abAppend(ab, "\x1b[39m", 5);
+      drawn += editorDrawRow(ab, &E.buf->row[filerow], textcols, sel);
     }
 
-    abAppend(ab, "\x1b[K", 3); // clear line
-    abAppend(ab, "\r\n", 2);
+    editorDrawLineEnd(ab, win, drawn);
   }
+
+  win->drawn_rowoff = E.rowoff;
+  win->drawn_coloff = E.coloff;
+  win->drawn_cy = E.cy;
 }
 
 /***
- * Draws the status bar
+ * Draws the status bar of a window
  * https://vt100.net/docs/vt100-ug/chapter3.html#ED
  *
  * @param *ab The append buffer
+ * @param *win The window, it must be loaded into E
  */
-void editorDrawStatusBar(struct abuf *ab) {
+void editorDrawStatusBar(struct abuf *ab, struct editorWindow *win) {
+  editorMoveTo(ab, win->top + win->rows, win->left);
   abAppend(ab, "\x1b[7m", 4); // reverse video bg color = white && text black
 
   char lstatus[80], rstatus[80], mode[80];
@@ -130,17 +421,52 @@ void editorDrawStatusBar(struct abuf *ab) {
   case COMMAND_MODE:
     snprintf(mode, sizeof(mode), "COMMAND");
     break;
+  case VISUAL_MODE:
+    snprintf(mode, sizeof(mode), "VISUAL");
+    break;
+  case VISUAL_LINE_MODE:
+    snprintf(mode, sizeof(mode), "VISUAL LINE");
+    break;
+  case VISUAL_BLOCK_MODE:
+    snprintf(mode, sizeof(mode), "VISUAL BLOCK");
+    break;
   default:
     snprintf(mode, sizeof(mode), "NORMAL");
     break;
   }
+  if (editorMacroRecording()) {
+    size_t n = strlen(mode);
+    snprintf(&mode[n], sizeof(mode) - n, " recording @%c",
+             editorMacroRecording());
+  }
+  if (win != E.win) {
+    mode[0] = '\0';
+  }
+
+  int bufidx = 0;
+  while (bufidx < E.numbuffers && E.buffers[bufidx] != E.buf) {
+    bufidx++;
+  }
 
-  int len = snprintf(lstatus, sizeof(lstatus), " %s %.20s - %d lines %s", mode,
-                     E.filename ? E.filename : "[No Name]", E.numrows,
-                     E.dirty ? "(modified)" : "");
-  int rlen = snprintf(rstatus, sizeof(rstatus), "%s | line %d/%d cols %d/%d",
-                      E.syntax ? E.syntax->filetype : "no ft", E.cy + 1,
-                      E.numrows, E.rx + 1, E.row ? E.row[E.cy].size + 1 : 1);
+  char loading[20] = "";
+  int progress = editorLoaderProgress(E.buf);
+  if (progress != -1) {
+    snprintf(loading, sizeof(loading), " [loading %d%%]", progress);
+  } else if (E.buf->follow != NULL) {
+    snprintf(loading, sizeof(loading), " [follow]");
+  }
+
+  int len = snprintf(lstatus, sizeof(lstatus),
+                     " %s [%d/%d] %.20s - %d lines%s %s", mode, bufidx + 1,
+                     E.numbuffers,
+                     E.buf->filename ? E.buf->filename : "[No Name]",
+                     E.buf->numrows, loading,
+                     E.buf->dirty ? "(modified)" : "");
+  int rlen =
+      snprintf(rstatus, sizeof(rstatus), "%s | line %d/%d cols %d/%d",
+               E.buf->syntax ? E.buf->syntax->filetype : "no ft", E.cy + 1,
+               E.buf->numrows, E.rx - KILO_SIGN_COLUMN + 1,
+               E.cy < E.buf->numrows ? E.buf->row[E.cy].rwidth + 1 : 1);
   if (len > E.screencols) {
     len = E.screencols;
   }
@@ -155,7 +481,10 @@ void editorDrawStatusBar(struct abuf *ab) {
     len++;
   }
   abAppend(ab, "\x1b[m", 3); // normal video bg color = black && text white
-  abAppend(ab, "\r\n", 2);
+
+  if (win->left + win->cols < E.termcols) {
+    abAppend(ab, "\x1b[7m|\x1b[m", 8);
+  }
 }
 
 /***
@@ -164,10 +493,11 @@ void editorDrawStatusBar(struct abuf *ab) {
  * @param *ab The append buffer
  */
 void editorDrawMessageBar(struct abuf *ab) {
+  editorMoveTo(ab, E.termrows - 1, 0);
   abAppend(ab, "\x1b[K", 3); // clear line
   int msglen = strlen(E.statusmsg);
-  if (msglen > E.screencols) {
-    msglen = E.screencols;
+  if (msglen > E.termcols) {
+    msglen = E.termcols;
   }
 
   if (msglen && time(NULL) - E.statusmsg_time < 5) {
@@ -178,32 +508,55 @@ void editorDrawMessageBar(struct abuf *ab) {
 /***
  * Refreshes the screen
  * https://vt100.net/docs/vt100-ug/chapter3.html#ED
+ *
+ * Only the damaged lines of each window are sent to the terminal, the status
+ * and message bars are always redrawn. Nothing is drawn while a macro is
+ * replayed, the damage it leaves is drawn once it is over
+ *
+ * A frame is skipped while the terminal hasn't taken the last one, its
+ * damage is drawn by the frame sent once it catches up. Frames are
+ * wrapped in synchronized update marks so the terminal shows them whole
  */
 void editorRefreshScreen() {
+  if (editorMacroReplaying() || !editorWriterReady()) {
+    return;
+  }
+  E.frame++;
   editorScroll();
+  editorWindowSave(E.win);
 
   struct abuf ab = ABUF_INIT;
-  abAppend(&ab, "\x1b[?25l", 6); // hide cursor
-  abAppend(&ab, "\x1b[H", 3);
+  abAppend(&ab, "\x1b[?2026h", 8); // begin synchronized update
+  abAppend(&ab, "\x1b[?25l", 6);   // hide cursor
+
+  for (int j = 0; j < E.numwindows; j++) {
+    struct editorWindow *win = E.windows[j];
+    editorWindowLoad(win);
+    editorDiffUpdate(E.buf);
+    editorSyntaxAdvance(E.rowoff + E.screenrows);
+    editorDrawRows(&ab, win);
+    editorDrawStatusBar(&ab, win);
+  }
+  editorWindowLoad(E.win);
 
-  editorDrawRows(&ab);
-  editorDrawStatusBar(&ab);
   editorDrawMessageBar(&ab);
 
-  char buf[32];
-  snprintf(buf, sizeof(buf), "\x1b[%d;%dH", (E.cy - E.rowoff) + 1,
-           (E.rx - E.coloff) + 1);
-  abAppend(&ab, buf, strlen(buf));
+  editorMoveTo(&ab, E.win->top + (E.cy - E.rowoff),
+               E.win->left + (E.rx - E.coloff));
 
-  abAppend(&ab, "\x1b[?25h", 6); // show cursor
+  abAppend(&ab, "\x1b[?25h", 6);   // show cursor
+  abAppend(&ab, "\x1b[?2026l", 8); // end synchronized update
 
-  write(STDOUT_FILENO, ab.b, ab.len);
+  editorWriterQueue(ab.b, ab.len);
   abFree(&ab);
 }
 
 /***
  * Draws the sign column with the row number
  *
+ * Each cell is a precomposed span from the gutter cache, only the diff
+ * mark is patched in after copying it
+ *
  * @param numrow current row number
  */
 void editorDrawSignColumn(struct abuf *ab, int numrow) {
@@ -211,31 +564,32 @@ void editorDrawSignColumn(struct abuf *ab, int numrow) {
     return;
   }
 
-  abAppend(ab, "\x1b[48;5;59m", 10);
-  abAppend(ab, "\x1b[38;5;226m", 11);
-  if (numrow < E.numrows) {
-    char buf[32];
-    int rowlength = snprintf(buf, sizeof(buf), "%d", numrow + 1);
-    if (rowlength > E.screencols) {
-      rowlength = E.screencols;
-    }
-    int len = KILO_SIGN_COLUMN - rowlength - 1;
-    if (len < 0) {
-      len = 0;
-    }
-    for (int i = 0; i < len; i++) {
-      abAppend(ab, " ", 1);
-    }
-    abAppend(ab, buf, rowlength);
-    abAppend(ab, "\x1b[m", 3);
-    abAppend(ab, " ", 1);
-  } else {
-    for (int i = 0; i < KILO_SIGN_COLUMN; i++) {
-      if (i == KILO_SIGN_COLUMN - 1) {
-        abAppend(ab, "\x1b[m", 3);
-      }
-      abAppend(ab, " ", 1);
+  int number = -1;
+  if (numrow < E.buf->numrows) {
+    if ((E.gutter & GUTTER_RELATIVE) && numrow != E.cy) {
+      number = (numrow > E.cy) ? numrow - E.cy : E.cy - numrow;
+    } else if (E.gutter & (GUTTER_NUMBER | GUTTER_RELATIVE)) {
+      number = numrow + 1;
     }
   }
-  abAppend(ab, "\x1b[m", 3);
+
+  int len;
+  const char *cell = editorGutterCell(number, &len);
+  abAppend(ab, (char *)cell, len);
+
+  char *end = &ab->b[ab->len];
+  switch (numrow < E.buf->numrows ? editorDiffMark(E.buf, numrow) : 0) {
+  case '+':
+    end[-GUTTER_MARK_COLOR] = '2';
+    end[-GUTTER_MARK] = '+';
+    break;
+  case '~':
+    end[-GUTTER_MARK_COLOR] = '4';
+    end[-GUTTER_MARK] = '~';
+    break;
+  case '-':
+    end[-GUTTER_MARK_COLOR] = '1';
+    end[-GUTTER_MARK] = '-';
+    break;
+  }
 }
@@ -4,8 +4,10 @@
 #include "typedefs.h"
 
 void editorScroll();
-void editorDrawRows(struct abuf *ab);
-void editorDrawStatusBar(struct abuf *ab);
+int editorDrawRow(struct abuf *ab, erow *row, int textcols,
+                  const struct editorRange *sel);
+void editorDrawRows(struct abuf *ab, struct editorWindow *win);
+void editorDrawStatusBar(struct abuf *ab, struct editorWindow *win);
 void editorDrawMessageBar(struct abuf *ab);
 void editorRefreshScreen();
 void editorDrawSignColumn(struct abuf *ab, int numrow);
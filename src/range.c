@@ -0,0 +1,367 @@
+#include "range.h"
+#include "input.h"
+#include "register.h"
+#include "row.h"
+
+/***
+ * Finds the part of a row a range covers
+ *
+ * @param *r The range
+ * @param y The row, between the top and bottom of the range
+ * @param *from Filled with the first byte of the row in the range
+ * @param *to Filled with the byte past the last one
+ */
+void editorRangeRow(const struct editorRange *r, int y, int *from, int *to) {
+  erow *row = &E.buf->row[y];
+  *from = 0;
+  *to = row->size;
+
+  switch (r->type) {
+  case RANGE_CHARS:
+    if (y == r->top) {
+      *from = r->start;
+    }
+    if (y == r->bottom) {
+      *to = r->end;
+    }
+    break;
+  case RANGE_BLOCK:
+    *from = editorRowRxToCx(row, r->start);
+    *to = editorRowRxToCx(row, r->end);
+    break;
+  case RANGE_LINES:
+    break;
+  }
+
+  if (*to > row->size) {
+    *to = row->size;
+  }
+  if (*from > *to) {
+    *from = *to;
+  }
+}
+
+/***
+ * Copies the text of a range into a single block
+ *
+ * @param *r The range
+ * @param *len Filled with the length of the text
+ * @return the text, to be freed, NULL if out of memory
+ */
+char *editorRangeText(const struct editorRange *r, size_t *len) {
+  size_t size = 0;
+  for (int y = r->top; y <= r->bottom; y++) {
+    int from, to;
+    editorRangeRow(r, y, &from, &to);
+    size += to - from + 1;
+  }
+
+  char *text = malloc(size + 1);
+  if (text == NULL) {
+    return NULL;
+  }
+
+  size_t n = 0;
+  for (int y = r->top; y <= r->bottom; y++) {
+    int from, to;
+    editorRangeRow(r, y, &from, &to);
+    memcpy(&text[n], &E.buf->row[y].chars[from], to - from);
+    n += to - from;
+    if (r->type == RANGE_LINES || y < r->bottom) {
+      text[n++] = '\n';
+    }
+  }
+  text[n] = '\0';
+  *len = n;
+  return text;
+}
+
+/***
+ * Copies a range into a register
+ *
+ * @param *r The range
+ * @param name The register
+ * @return 0 on success, -1 if out of memory
+ */
+int editorRangeYank(const struct editorRange *r, int name) {
+  size_t len;
+  char *text = editorRangeText(r, &len);
+  if (text == NULL) {
+    return -1;
+  }
+  editorRegisterSet(name, r->type, text, len);
+  return 0;
+}
+
+/***
+ * Deletes a range, whole rows go with a single move of the rows below and
+ * the cursor is left where the range started
+ *
+ * @param *r The range
+ */
+void editorRangeDelete(const struct editorRange *r) {
+  int from, to;
+  editorRangeRow(r, r->top, &from, &to);
+
+  switch (r->type) {
+  case RANGE_LINES:
+    editorDelRows(r->top, r->bottom - r->top + 1);
+    from = 0;
+    break;
+  case RANGE_CHARS:
+    if (r->top == r->bottom) {
+      editorRowDelChars(&E.buf->row[r->top], from, to - from);
+      break;
+    }
+    erow *top = &E.buf->row[r->top];
+    erow *bottom = &E.buf->row[r->bottom];
+    editorRowDelChars(top, from, top->size - from);
+    editorRowAppendString(top, &bottom->chars[r->end], bottom->size - r->end);
+    editorDelRows(r->top + 1, r->bottom - r->top);
+    break;
+  case RANGE_BLOCK:
+    for (int y = r->top; y <= r->bottom; y++) {
+      int start, end;
+      editorRangeRow(r, y, &start, &end);
+      editorRowDelChars(&E.buf->row[y], start, end - start);
+    }
+    break;
+  }
+
+  E.cy = r->top;
+  if (E.cy > E.buf->numrows) {
+    E.cy = E.buf->numrows;
+  }
+  E.cx = KILO_SIGN_COLUMN;
+  if (E.cy < E.buf->numrows && from <= E.buf->row[E.cy].size) {
+    E.cx += from;
+  }
+}
+
+/***
+ * Puts lines below or above the cursor row
+ */
+static void editorRangePutLines(const struct editorRegister *reg,
+                                int before) {
+  int at = before ? E.cy : E.cy + 1;
+  if (at > E.buf->numrows) {
+    at = E.buf->numrows;
+  }
+  if (editorInsertRows(at, reg->text, reg->len) > 0) {
+    E.cy = at;
+    E.cx = KILO_SIGN_COLUMN;
+  }
+}
+
+/***
+ * Puts characters after or before the cursor, the cursor row is split
+ * around them when they span rows
+ */
+static void editorRangePutChars(const struct editorRegister *reg,
+                                int before) {
+  if (E.cy == E.buf->numrows) {
+    editorInsertRow(E.buf->numrows, "", 0);
+  }
+  erow *row = &E.buf->row[E.cy];
+  int at = E.cx - KILO_SIGN_COLUMN;
+  if (!before) {
+    at = editorRowNextCx(row, at);
+  }
+
+  char *nl = memchr(reg->text, '\n', reg->len);
+  if (nl == NULL) {
+    editorRowInsertBytes(row, at, reg->text, reg->len);
+    E.cx = editorRowPrevCx(row, at + reg->len) + KILO_SIGN_COLUMN;
+    return;
+  }
+
+  // the rest of the text and what followed the cursor become new rows
+  size_t first = nl - reg->text;
+  size_t rest = reg->len - first - 1;
+  size_t tail = row->size - at;
+  char *text = malloc(rest + tail + 1);
+  if (text == NULL) {
+    return;
+  }
+  memcpy(text, nl + 1, rest);
+  memcpy(&text[rest], &row->chars[at], tail);
+  text[rest + tail] = '\n';
+
+  editorRowDelChars(row, at, tail);
+  editorRowInsertBytes(row, at, reg->text, first);
+  editorInsertRows(E.cy + 1, text, rest + tail + 1);
+  free(text);
+  E.cx = at + KILO_SIGN_COLUMN;
+}
+
+/***
+ * Puts a block after or before the cursor column, one line per row from
+ * the cursor row down, rows too short are padded with spaces
+ */
+static void editorRangePutBlock(const struct editorRegister *reg,
+                                int before) {
+  int col = 0;
+  if (E.cy < E.buf->numrows) {
+    erow *row = &E.buf->row[E.cy];
+    int at = E.cx - KILO_SIGN_COLUMN;
+    col = editorRowToRx(row, before ? at : editorRowNextCx(row, at));
+  }
+
+  char *line = reg->text;
+  char *end = reg->text + reg->len;
+  for (int y = E.cy; line <= end; y++) {
+    char *nl = memchr(line, '\n', end - line);
+    size_t len = nl ? (size_t)(nl - line) : (size_t)(end - line);
+
+    if (y == E.buf->numrows) {
+      editorInsertRow(E.buf->numrows, "", 0);
+    }
+    erow *row = &E.buf->row[y];
+    int width = editorRowToRx(row, row->size);
+    int pad = (width < col) ? col - width : 0;
+
+    char *bytes = malloc(pad + len + 1);
+    if (bytes == NULL) {
+      return;
+    }
+    memset(bytes, ' ', pad);
+    memcpy(&bytes[pad], line, len);
+    editorRowInsertBytes(row, editorRowRxToCx(row, col), bytes, pad + len);
+    free(bytes);
+
+    if (nl == NULL) {
+      break;
+    }
+    line = nl + 1;
+  }
+
+  E.cx = editorRowRxToCx(&E.buf->row[E.cy], col) + KILO_SIGN_COLUMN;
+}
+
+/***
+ * Puts the contents of a register at the cursor
+ *
+ * @param name The register
+ * @param before Whether to put them before the cursor instead of after
+ */
+void editorRangePut(int name, int before) {
+  const struct editorRegister *reg = editorRegisterGet(name);
+  if (reg == NULL) {
+    editorSetStatusMessage("Nothing in register %c", name);
+    return;
+  }
+
+  switch (reg->type) {
+  case RANGE_LINES:
+    editorRangePutLines(reg, before);
+    break;
+  case RANGE_CHARS:
+    editorRangePutChars(reg, before);
+    break;
+  case RANGE_BLOCK:
+    editorRangePutBlock(reg, before);
+    break;
+  }
+}
+
+/***
+ * Builds the range between two places of the text, given in either order
+ *
+ * @param *r Filled with the range
+ * @param type RANGE_LINES for the rows of both places and those between,
+ * RANGE_CHARS for the characters from the first place up to the second
+ * @param ax The byte offset of one place in its row
+ * @param ay The row of that place
+ * @param bx The byte offset of the other place
+ * @param by Its row
+ * @return 0 on success, -1 when the range is empty
+ */
+int editorRangeBetween(struct editorRange *r, enum editorRangeType type,
+                       int ax, int ay, int bx, int by) {
+  if (by < ay || (by == ay && bx < ax)) {
+    int t = ay;
+    ay = by;
+    by = t;
+    t = ax;
+    ax = bx;
+    bx = t;
+  }
+
+  // the row past the end of the text ends the range at the end of the last
+  if (by >= E.buf->numrows) {
+    by = E.buf->numrows - 1;
+    bx = (by >= 0) ? E.buf->row[by].size : 0;
+  }
+  if (ay > by) {
+    return -1;
+  }
+
+  r->type = type;
+  r->top = ay;
+  r->bottom = by;
+  r->start = (type == RANGE_CHARS) ? ax : 0;
+  r->end = (type == RANGE_CHARS) ? bx : 0;
+  if (type == RANGE_CHARS && ay == by && ax >= bx) {
+    return -1;
+  }
+  return 0;
+}
+
+/***
+ * Gets the range selected in visual mode
+ *
+ * @param *r Filled with the selection
+ * @return 0 on success, -1 when nothing is selected
+ */
+int editorVisualRange(struct editorRange *r) {
+  if (E.buf->numrows == 0 ||
+      (E.mode != VISUAL_MODE && E.mode != VISUAL_LINE_MODE &&
+       E.mode != VISUAL_BLOCK_MODE)) {
+    return -1;
+  }
+
+  int ay = E.vcy < E.buf->numrows ? E.vcy : E.buf->numrows - 1;
+  int by = E.cy < E.buf->numrows ? E.cy : E.buf->numrows - 1;
+  int ax = E.vcx - KILO_SIGN_COLUMN;
+  int bx = (E.cy < E.buf->numrows) ? E.cx - KILO_SIGN_COLUMN : 0;
+  if (ax > E.buf->row[ay].size) {
+    ax = E.buf->row[ay].size;
+  }
+  if (by < ay || (by == ay && bx < ax)) {
+    int t = ay;
+    ay = by;
+    by = t;
+    t = ax;
+    ax = bx;
+    bx = t;
+  }
+
+  r->top = ay;
+  r->bottom = by;
+  switch (E.mode) {
+  case VISUAL_LINE_MODE:
+    r->type = RANGE_LINES;
+    r->start = 0;
+    r->end = 0;
+    break;
+  case VISUAL_BLOCK_MODE: {
+    // the columns of both corners, the wider character wins
+    erow *a = &E.buf->row[ay];
+    erow *b = &E.buf->row[by];
+    int a0 = editorRowToRx(a, ax);
+    int a1 = (ax < a->size) ? editorRowToRx(a, editorRowNextCx(a, ax)) : a0 + 1;
+    int b0 = editorRowToRx(b, bx);
+    int b1 = (bx < b->size) ? editorRowToRx(b, editorRowNextCx(b, bx)) : b0 + 1;
+    r->type = RANGE_BLOCK;
+    r->start = a0 < b0 ? a0 : b0;
+    r->end = a1 > b1 ? a1 : b1;
+  } break;
+  default:
+    // the character under the cursor is selected too
+    r->type = RANGE_CHARS;
+    r->start = ax;
+    r->end = editorRowNextCx(&E.buf->row[by], bx);
+    break;
+  }
+  return 0;
+}
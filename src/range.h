@@ -0,0 +1,15 @@
+#ifndef RANGE_H_
+#define RANGE_H_
+
+#include "typedefs.h"
+
+void editorRangeRow(const struct editorRange *r, int y, int *from, int *to);
+char *editorRangeText(const struct editorRange *r, size_t *len);
+int editorRangeYank(const struct editorRange *r, int name);
+void editorRangeDelete(const struct editorRange *r);
+void editorRangePut(int name, int before);
+int editorRangeBetween(struct editorRange *r, enum editorRangeType type,
+                       int ax, int ay, int bx, int by);
+int editorVisualRange(struct editorRange *r);
+
+#endif // !#ifndef RANGE_H_
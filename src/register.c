@@ -0,0 +1,66 @@
+#include "register.h"
+
+// the unnamed register " and a to z
+static struct editorRegister registers[27];
+
+/***
+ * Finds the slot of a register
+ *
+ * @param name The name of the register
+ * @return the register, NULL if there is none by that name
+ */
+static struct editorRegister *editorRegisterSlot(int name) {
+  if (name == '"') {
+    return &registers[0];
+  }
+  if (name >= 'a' && name <= 'z') {
+    return &registers[name - 'a' + 1];
+  }
+  return NULL;
+}
+
+/***
+ * Stores text in a register, the unnamed register always gets a copy
+ *
+ * @param name The name of the register
+ * @param type How the text was taken and is to be put back
+ * @param *text The text, owned by the register from now on
+ * @param len The length of the text
+ */
+void editorRegisterSet(int name, enum editorRangeType type, char *text,
+                       size_t len) {
+  struct editorRegister *reg = editorRegisterSlot(name);
+  if (reg == NULL) {
+    reg = &registers[0];
+  }
+
+  if (reg != &registers[0]) {
+    char *copy = malloc(len + 1);
+    if (copy != NULL) {
+      memcpy(copy, text, len);
+      free(registers[0].text);
+      registers[0].type = type;
+      registers[0].text = copy;
+      registers[0].len = len;
+    }
+  }
+
+  free(reg->text);
+  reg->type = type;
+  reg->text = text;
+  reg->len = len;
+}
+
+/***
+ * Gets the contents of a register
+ *
+ * @param name The name of the register
+ * @return the register, NULL if it is unknown or empty
+ */
+const struct editorRegister *editorRegisterGet(int name) {
+  struct editorRegister *reg = editorRegisterSlot(name);
+  if (reg == NULL || reg->text == NULL) {
+    return NULL;
+  }
+  return reg;
+}
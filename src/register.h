@@ -0,0 +1,18 @@
+#ifndef REGISTER_H_
+#define REGISTER_H_
+
+#include "typedefs.h"
+
+// yanked or deleted text, the rows are separated by \n and lines ones end
+// with it too
+struct editorRegister {
+  enum editorRangeType type;
+  char *text;
+  size_t len;
+};
+
+void editorRegisterSet(int name, enum editorRangeType type, char *text,
+                       size_t len);
+const struct editorRegister *editorRegisterGet(int name);
+
+#endif // !#ifndef REGISTER_H_
@@ -0,0 +1,91 @@
+#include "resize.h"
+#include "event.h"
+#include "window.h"
+#include <signal.h>
+#include <sys/timerfd.h>
+
+// the signal handler writes to pipefd[1], the event loop reads pipefd[0]
+static int pipefd[2] = {-1, -1};
+static int timerfd = -1;
+
+/***
+ * Tells the event loop the terminal was resized, a signal handler may only
+ * write to the pipe
+ *
+ * @param sig Unused
+ */
+static void editorResizeSignal(int sig) {
+  (void)sig;
+  int saved = errno;
+  write(pipefd[1], "", 1);
+  errno = saved;
+}
+
+/***
+ * Lays the windows out again for the new size of the terminal
+ *
+ * The rows keep their render and highlight, only the windows are placed
+ * again and drawn whole
+ *
+ * @param fd The timer
+ * @param *arg Unused
+ */
+static void editorResizeApply(int fd, void *arg) {
+  (void)arg;
+  uint64_t expirations;
+  read(fd, &expirations, sizeof(expirations));
+
+  struct winsize ws;
+  if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == -1 || ws.ws_col == 0 ||
+      (ws.ws_row == E.termrows && ws.ws_col == E.termcols)) {
+    return;
+  }
+  E.termrows = ws.ws_row;
+  E.termcols = ws.ws_col;
+  editorWindowLayout();
+}
+
+/***
+ * Waits for the resizes to settle before laying out, a window manager
+ * dragging the terminal sends many of them in a row
+ *
+ * @param fd The read end of the pipe
+ * @param *arg Unused
+ */
+static void editorResizeRead(int fd, void *arg) {
+  (void)arg;
+  char buf[64];
+  while (read(fd, buf, sizeof(buf)) > 0) {
+  }
+
+  // each resize pushes the deadline back
+  struct itimerspec settle = {{0, 0}, {0, KILO_RESIZE_MS * 1000000L}};
+  timerfd_settime(timerfd, 0, &settle, NULL);
+}
+
+/***
+ * Starts listening for resizes of the terminal
+ */
+void editorResizeInit() {
+  if (pipe(pipefd) == -1) {
+    return;
+  }
+  for (int j = 0; j < 2; j++) {
+    fcntl(pipefd[j], F_SETFL, fcntl(pipefd[j], F_GETFL) | O_NONBLOCK);
+    fcntl(pipefd[j], F_SETFD, FD_CLOEXEC);
+  }
+
+  timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (timerfd == -1) {
+    return;
+  }
+  editorEventAdd(pipefd[0], editorResizeRead, NULL);
+  editorEventAdd(timerfd, editorResizeApply, NULL);
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = editorResizeSignal;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_RESTART;
+  sigaction(SIGWINCH, &sa, NULL);
+}
@@ -0,0 +1,8 @@
+#ifndef RESIZE_H_
+#define RESIZE_H_
+
+#include "typedefs.h"
+
+void editorResizeInit();
+
+#endif // !#ifndef RESIZE_H_
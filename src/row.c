@@ -1,5 +1,10 @@
 #include "row.h"
+#include "journal.h"
 #include "syntax.h"
+#include "trigram.h"
+#include "utf8.h"
+#include "window.h"
+#include <limits.h>
 
 /***
  * Converts char index into render index
@@ -8,12 +13,23 @@
  * @param cx The char index
  */
 int editorRowToRx(erow *row, int cx) {
+  if (cx > row->size) {
+    cx = row->size;
+  }
+
   int rx = 0;
-  for (int j = 0; j < cx; j++) {
+  int j = 0;
+  while (j < cx) {
     if (row->chars[j] == '\t') {
       rx += (KILO_TAB_STOPS - 1) - (rx % KILO_TAB_STOPS);
+    } else if (!row->ascii && (unsigned char)row->chars[j] >= 0x80) {
+      int w;
+      j += utf8ClusterLen(&row->chars[j], row->size - j, &w);
+      rx += w;
+      continue;
     }
     rx++;
+    j++;
   }
   return rx;
 }
@@ -21,37 +37,129 @@ int editorRowToRx(erow *row, int cx) {
 int editorRowRxToCx(erow *row, int rx) {
   int cur_rx = 0;
 
-  int cx;
-  for (cx = 0; cx < row->size; cx++) {
+  int cx = 0;
+  while (cx < row->size) {
+    int n = 1;
     if (row->chars[cx] == '\t') {
       cur_rx += (KILO_TAB_STOPS - 1) - (cur_rx % KILO_TAB_STOPS);
+      cur_rx++;
+    } else if (!row->ascii && (unsigned char)row->chars[cx] >= 0x80) {
+      int w;
+      n = utf8ClusterLen(&row->chars[cx], row->size - cx, &w);
+      cur_rx += w;
+    } else {
+      cur_rx++;
     }
-    cur_rx++;
 
     if (cur_rx > rx) {
       return cx;
     }
+    cx += n;
   }
 
   return cx;
 }
 
 /***
- * Updates the row render with tabs
+ * Converts a byte offset in the render into a display column
  *
- * @param row The row to update
+ * @param *row Pointer to the row to convert
+ * @param off The byte offset in row->render
  */
-void editorUpdateRow(erow *row) {
-  int tabs = 0;
+int editorRowRenderToRx(erow *row, int off) {
+  if (row->ascii) {
+    return off;
+  }
+  return utf8StringWidth(row->render, off);
+}
 
-  for (int j = 0; j < row->size; j++) {
+/***
+ * Converts a char index into a byte offset in the render
+ *
+ * @param *row Pointer to the row to convert
+ * @param cx The char index
+ */
+int editorRowCxToRender(erow *row, int cx) {
+  if (cx > row->size) {
+    cx = row->size;
+  }
+
+  int off = 0;
+  for (int j = 0; j < cx; j++) {
     if (row->chars[j] == '\t') {
-      tabs++;
+      do {
+        off++;
+      } while (off % KILO_TAB_STOPS != 0);
+      continue;
     }
+    off++;
+  }
+  return off;
+}
+
+/***
+ * Finds the char index of the cluster before the given one
+ *
+ * @param *row Pointer to the row
+ * @param cx The char index
+ */
+int editorRowPrevCx(erow *row, int cx) {
+  if (cx <= 0) {
+    return 0;
+  }
+  if (row->ascii) {
+    return cx - 1;
+  }
+  return utf8ClusterStart(row->chars, row->size, cx - 1);
+}
+
+/***
+ * Finds the char index of the cluster after the given one
+ *
+ * @param *row Pointer to the row
+ * @param cx The char index
+ */
+int editorRowNextCx(erow *row, int cx) {
+  if (cx >= row->size) {
+    return row->size;
+  }
+  if (row->ascii) {
+    return cx + 1;
   }
 
+  int w;
+  return cx + utf8ClusterLen(&row->chars[cx], row->size - cx, &w);
+}
+
+/***
+ * Builds the render of a row, tabs expanded to spaces
+ *
+ * @param *row The row
+ * @param tabs The number of tabs in the row, any number above 0 when only
+ * their presence is known
+ */
+static void editorRowRender(erow *row, int tabs) {
+  if (row->render != NULL) {
+    E.buf->cachebytes -= row->rsize + 1;
+  }
   free(row->render);
-  row->render = malloc(row->size + tabs * (KILO_TAB_STOPS - 1) + 1);
+
+  if (tabs == 0) {
+    row->render = malloc(row->size + 1);
+    memcpy(row->render, row->chars, row->size);
+    row->render[row->size] = '\0';
+    row->rsize = row->size;
+    E.buf->cachebytes += row->rsize + 1;
+    return;
+  }
+
+  int count = 0;
+  for (int j = 0; j < row->size; j++) {
+    if (row->chars[j] == '\t') {
+      count++;
+    }
+  }
+  row->render = malloc(row->size + count * (KILO_TAB_STOPS - 1) + 1);
 
   int idx = 0;
   for (int j = 0; j < row->size; j++) {
@@ -66,39 +174,467 @@ void editorUpdateRow(erow *row) {
 
   row->render[idx] = '\0';
   row->rsize = idx;
+  E.buf->cachebytes += row->rsize + 1;
+}
 
+/***
+ * Updates the row render with tabs
+ *
+ * @param row The row to update
+ */
+void editorUpdateRow(erow *row) {
+  editorSyntaxFree(row);
+  editorRowRender(row, memchr(row->chars, '\t', row->size) != NULL);
+
+  // pure ASCII rows keep the one byte per column fast path
+  row->ascii = utf8Validate(row->render, row->rsize) == row->rsize;
+  row->rwidth =
+      row->ascii ? row->rsize : utf8StringWidth(row->render, row->rsize);
+
+  row->hash = editorRowHash(row->chars, row->size);
   editorUpdateSyntax(row);
+  editorTrigramRow(row);
+}
+
+/***
+ * Hashes the contents of a row
+ *
+ * Eight bytes are mixed at a time, rows are compared by size and hash to
+ * find what changed without comparing their text
+ *
+ * @param *s The text
+ * @param len The length of the text
+ * @return the hash
+ */
+uint64_t editorRowHash(const char *s, size_t len) {
+  uint64_t h = 0x9e3779b97f4a7c15ULL ^ len;
+  size_t j = 0;
+
+  for (; j + 8 <= len; j += 8) {
+    uint64_t w;
+    memcpy(&w, &s[j], 8);
+    h = (h ^ w) * 0xff51afd7ed558ccdULL;
+    h ^= h >> 32;
+  }
+
+  uint64_t w = 0;
+  memcpy(&w, &s[j], len - j);
+  h = (h ^ w) * 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 29;
+  return h;
+}
+
+/***
+ * Makes room for more rows in the row array
+ *
+ * The array grows geometrically so appending rows one by one stays linear
+ *
+ * @param n The number of rows to add
+ * @return 0 on success, -1 if the memory could not be allocated
+ */
+static int editorRowReserve(int n) {
+  if (E.buf->numrows + n <= E.buf->rowcap) {
+    return 0;
+  }
+
+  int cap = E.buf->rowcap ? E.buf->rowcap * 2 : 64;
+  while (cap < E.buf->numrows + n) {
+    cap *= 2;
+  }
+
+  erow *new = realloc(E.buf->row, sizeof(erow) * cap);
+  if (new == NULL) {
+    return -1;
+  }
+  E.buf->row = new;
+  E.buf->rowcap = cap;
+  return 0;
+}
+
+/***
+ * Fills a row slot with a copy of a string
+ *
+ * @param at The index of the row
+ * @param s The contents of the row
+ * @param len The length of the contents
+ * @param block The block of the search index the row goes in
+ */
+static void editorRowInit(int at, char *s, size_t len, int block) {
+  erow *row = &E.buf->row[at];
+
+  row->idx = at;
+  row->block = block;
+  row->size = len;
+  row->chars = malloc(len + 1);
+  memcpy(row->chars, s, len);
+  row->chars[len] = '\0';
+
+  row->rsize = 0;
+  row->render = NULL;
+  row->hl = NULL;
+  row->nhl = -1;
+  row->hl_start = -1;
+  row->hl_open_comment = 0;
+  editorUpdateRow(row);
+}
+
+/***
+ * Fills a row slot with a line whose width, hash and lexer states were kept
+ * by the row cache, only the render is built
+ *
+ * @param at The index of the row
+ * @param s The contents of the row
+ * @param *info What is known of the row
+ * @param block The block of the search index the row goes in
+ */
+static void editorRowInitKnown(int at, char *s,
+                               const struct editorRowInfo *info, int block) {
+  erow *row = &E.buf->row[at];
+
+  row->idx = at;
+  row->block = block;
+  row->size = info->size;
+  row->chars = malloc(row->size + 1);
+  memcpy(row->chars, s, row->size);
+  row->chars[row->size] = '\0';
+
+  row->rsize = 0;
+  row->render = NULL;
+  editorRowRender(row, info->flags & ROW_INFO_TABS);
+  row->ascii = (info->flags & ROW_INFO_ASCII) != 0;
+  row->rwidth = info->flags >> ROW_INFO_WIDTH_SHIFT;
+  row->hash = info->hash;
+
+  row->hl = NULL;
+  row->nhl = -1;
+  row->hl_start = -1;
+  row->hl_open_comment = 0;
+  if (info->flags & ROW_INFO_LEXED) {
+    row->hl_start = (info->flags & ROW_INFO_START) != 0;
+    row->hl_open_comment = (info->flags & ROW_INFO_END) != 0;
+  }
+  editorTrigramRow(row);
 }
 
 /***
  * Appends a new row to the end of the row array
  */
 void editorInsertRow(int at, char *s, size_t len) {
-  if (at < 0 || at > E.numrows) {
+  if (at < 0 || at > E.buf->numrows) {
     return;
   }
 
-  E.row = realloc(E.row, sizeof(erow) * (E.numrows + 1));
-  memmove(&E.row[at + 1], &E.row[at], sizeof(erow) * (E.numrows - at));
-	for (int j = at + 1; j <= E.numrows; j++) {
-		E.row[j].idx++;
-	}
+  if (editorRowReserve(1) == -1) {
+    return;
+  }
+  editorJournalOp(JOURNAL_INSERT_ROW, at, 0, s, len);
+  memmove(&E.buf->row[at + 1], &E.buf->row[at],
+          sizeof(erow) * (E.buf->numrows - at));
+  for (int j = at + 1; j <= E.buf->numrows; j++) {
+    E.buf->row[j].idx++;
+    editorSyntaxMoved(&E.buf->row[j]);
+  }
+
+  editorRowInit(at, s, len, editorTrigramPlace(at, at == E.buf->numrows));
+
+  E.buf->numrows++;
+  E.buf->dirty++;
+  editorWindowDamage(E.buf, at, INT_MAX);
+}
+
+/***
+ * Splits rows at many places at once, as if a new line was typed at each
+ *
+ * The row array is moved once, from the bottom up, instead of once per new
+ * row. The splits are journaled as if made one at a time from the last
+ * place to the first
+ *
+ * @param *at The places, sorted by row and offset, on existing rows
+ * @param n The number of places
+ * @return 0 on success, -1 if out of memory
+ */
+int editorRowSplitMany(const struct editorRowPos *at, int n) {
+  if (n == 0) {
+    return 0;
+  }
+  if (editorRowReserve(n) == -1) {
+    return -1;
+  }
+
+  for (int k = n - 1; k >= 0; k--) {
+    erow *row = &E.buf->row[at[k].row];
+    int end = (k + 1 < n && at[k + 1].row == at[k].row) ? at[k + 1].at
+                                                          : row->size;
+    editorJournalOp(JOURNAL_INSERT_ROW, at[k].row + 1, 0,
+                    &row->chars[at[k].at], end - at[k].at);
+    if (end > at[k].at) {
+      editorJournalOp(JOURNAL_DELETE, at[k].row, at[k].at, NULL,
+                      end - at[k].at);
+    }
+  }
 
-	E.row[at].idx = at;
+  // every row moves down by the number of splits above it, the slot it
+  // moves to only ever held rows already moved
+  int shift = n;
+  int k = n - 1;
+  for (int src = E.buf->numrows - 1; shift > 0; src--) {
+    erow row = E.buf->row[src];
+    int end = row.size;
+    while (k >= 0 && at[k].row == src) {
+      editorRowInit(src + shift, &row.chars[at[k].at], end - at[k].at,
+                    row.block);
+      end = at[k].at;
+      shift--;
+      k--;
+    }
+
+    erow *dst = &E.buf->row[src + shift];
+    *dst = row;
+    dst->idx = src + shift;
+    editorSyntaxMoved(dst);
+    if (end < row.size) {
+      dst->size = end;
+      dst->chars[end] = '\0';
+      editorUpdateRow(dst);
+    }
+  }
+
+  E.buf->numrows += n;
+  E.buf->dirty++;
+  editorWindowDamage(E.buf, at[0].row, INT_MAX);
+  return 0;
+}
+
+/***
+ * Joins many rows to the ones above them at once, as if the new line
+ * before each was deleted
+ *
+ * The row array is compacted in one pass and every row that grows is
+ * reallocated and rendered once. The joins are journaled as if made one at
+ * a time from the first row to the last
+ *
+ * @param *rows The rows to join, sorted and none of them the first
+ * @param n The number of rows
+ */
+void editorRowJoinMany(const int *rows, int n) {
+  if (n == 0) {
+    return;
+  }
+
+  int k = 0;
+  int src = rows[0] - 1;
+  int dst = src;
+  while (src < E.buf->numrows) {
+    erow *into = &E.buf->row[src];
+    int end = src + 1;
+    while (k < n && rows[k] == end) {
+      end++;
+      k++;
+    }
+
+    if (end > src + 1) {
+      int size = into->size;
+      for (int r = src + 1; r < end; r++) {
+        size += E.buf->row[r].size;
+      }
+      char *chars = realloc(into->chars, size + 1);
+      if (chars == NULL) {
+        break;
+      }
+      into->chars = chars;
+
+      for (int r = src + 1; r < end; r++) {
+        erow *row = &E.buf->row[r];
+        editorJournalOp(JOURNAL_INSERT, dst, into->size, row->chars,
+                        row->size);
+        editorJournalOp(JOURNAL_DELETE_ROW, dst + 1, 0, NULL, 0);
+        memcpy(&into->chars[into->size], row->chars, row->size);
+        into->size += row->size;
+        if (row->render != NULL) {
+          E.buf->cachebytes -= row->rsize + 1;
+        }
+        editorFreeRow(row);
+      }
+      into->chars[into->size] = '\0';
+    }
+
+    if (dst != src) {
+      E.buf->row[dst] = *into;
+      E.buf->row[dst].idx = dst;
+      editorSyntaxMoved(&E.buf->row[dst]);
+    }
+    if (end > src + 1) {
+      editorUpdateRow(&E.buf->row[dst]);
+    }
+    dst++;
+    src = end;
+  }
+
+  // rows left behind when out of memory
+  while (src < E.buf->numrows) {
+    E.buf->row[dst] = E.buf->row[src++];
+    E.buf->row[dst].idx = dst;
+    editorSyntaxMoved(&E.buf->row[dst]);
+    dst++;
+  }
+
+  E.buf->numrows = dst;
+  E.buf->dirty++;
+  editorSyntaxInvalidate(rows[0] - 1);
+  editorWindowDamage(E.buf, rows[0] - 1, INT_MAX);
+}
+
+/***
+ * Replaces a range of rows with the lines of a block of text
+ *
+ * This is the bulk path used to bring file contents in: the row array is
+ * moved once, only the new rows are rendered, and the buffer is not marked
+ * as modified. A last line without a newline counts
+ * too, so callers should hand over whole lines.
+ *
+ * @param at The first row to replace
+ * @param del The number of rows to replace
+ * @param *data The text, lines end with \n and optionally \r
+ * @param len The length of the text
+ * @return the number of rows inserted, -1 if out of memory
+ */
+int editorReplaceRows(int at, int del, char *data, size_t len) {
+  int lines = 0;
+  for (char *p = data; (p = memchr(p, '\n', data + len - p)) != NULL; p++) {
+    lines++;
+  }
+  if (len > 0 && data[len - 1] != '\n') {
+    lines++;
+  }
+  if (lines > del && editorRowReserve(lines - del) == -1) {
+    return -1;
+  }
 
-  E.row[at].size = len;
-  E.row[at].chars = malloc(len + 1);
-  memcpy(E.row[at].chars, s, len);
-  E.row[at].chars[len] = '\0';
+  for (int j = at; j < at + del; j++) {
+    if (E.buf->row[j].render != NULL) {
+      E.buf->cachebytes -= E.buf->row[j].rsize + 1;
+    }
+    editorFreeRow(&E.buf->row[j]);
+  }
 
-  E.row[at].rsize = 0;
-  E.row[at].render = NULL;
-  E.row[at].hl = NULL;
-	E.row[at].hl_open_comment = 0;
-  editorUpdateRow(&E.row[at]);
+  int tail = E.buf->numrows - at - del;
+  if (lines != del) {
+    memmove(&E.buf->row[at + lines], &E.buf->row[at + del],
+            sizeof(erow) * tail);
+    for (int j = at + lines; j < at + lines + tail; j++) {
+      E.buf->row[j].idx = j;
+      editorSyntaxMoved(&E.buf->row[j]);
+    }
+  }
+
+  // the rows below check their lexer states against the new ones when
+  // they are drawn again
+  editorSyntaxInvalidate(at);
+  int row = at;
+  char *p = data;
+  char *end = data + len;
+  while (p < end) {
+    char *nl = memchr(p, '\n', end - p);
+    size_t linelen = nl ? (size_t)(nl - p) : (size_t)(end - p);
+    while (linelen > 0 && p[linelen - 1] == '\r') {
+      linelen--;
+    }
 
-  E.numrows++;
-  E.dirty++;
+    editorRowInit(row, p, linelen, editorTrigramPlace(row, tail == 0));
+    row++;
+    p = nl ? nl + 1 : end;
+  }
+  E.buf->numrows = at + lines + tail;
+
+  editorWindowDamage(E.buf, at, lines == del ? at + lines - 1 : INT_MAX);
+  return lines;
+}
+
+/***
+ * Inserts the lines of a block of text as new rows, an edit unlike
+ * editorReplaceRows
+ *
+ * @param at Where the first new row goes
+ * @param *text The lines, each ending with \n, a \r before it is dropped
+ * @param len The length of the text
+ * @return the number of rows inserted, -1 if out of memory
+ */
+int editorInsertRows(int at, char *text, size_t len) {
+  if (at < 0 || at > E.buf->numrows) {
+    return -1;
+  }
+
+  editorJournalOp(JOURNAL_INSERT_ROWS, at, 0, text, len);
+  int lines = editorReplaceRows(at, 0, text, len);
+  if (lines > 0) {
+    E.buf->dirty++;
+  }
+  return lines;
+}
+
+/***
+ * Deletes a run of rows with a single move of the rows below
+ *
+ * @param at The first row to delete
+ * @param n The number of rows
+ */
+void editorDelRows(int at, int n) {
+  if (at < 0 || at >= E.buf->numrows || n <= 0) {
+    return;
+  }
+  if (at + n > E.buf->numrows) {
+    n = E.buf->numrows - at;
+  }
+
+  editorJournalOp(JOURNAL_DELETE_ROWS, at, n, NULL, 0);
+  editorReplaceRows(at, n, "", 0);
+  E.buf->dirty++;
+}
+
+/***
+ * Appends every line of a block of text as new rows
+ *
+ * @param *data The text, lines end with \n and optionally \r
+ * @param len The length of the text
+ * @return the number of rows appended
+ */
+int editorAppendLines(char *data, size_t len) {
+  int lines = editorReplaceRows(E.buf->numrows, 0, data, len);
+  return lines < 0 ? 0 : lines;
+}
+
+/***
+ * Appends lines the row cache knows, they are split where it says without
+ * looking for their newlines and their rows are not measured again
+ *
+ * @param *data The lines, already checked against info
+ * @param *info What is known of each line
+ * @param n The number of lines
+ * @return the number of rows appended, -1 if out of memory
+ */
+int editorAppendKnownLines(char *data, const struct editorRowInfo *info,
+                           int n) {
+  if (editorRowReserve(n) == -1) {
+    return -1;
+  }
+
+  int at = E.buf->numrows;
+  char *p = data;
+  for (int j = 0; j < n; j++) {
+    editorRowInitKnown(at + j, p, &info[j], editorTrigramPlace(at + j, 1));
+    p += info[j].size + 1;
+  }
+  E.buf->numrows += n;
+
+  // the lexer states kept carry on from the rows above, as far as they go
+  if (E.buf->hlvalid == at) {
+    while (E.buf->hlvalid < E.buf->numrows &&
+           E.buf->row[E.buf->hlvalid].hl_start != -1) {
+      E.buf->hlvalid++;
+    }
+  }
+  editorWindowDamage(E.buf, at, INT_MAX);
+  return n;
 }
 
 /***
@@ -107,9 +643,9 @@ void editorInsertRow(int at, char *s, size_t len) {
  * @param *row The row to free
  */
 void editorFreeRow(erow *row) {
+  editorSyntaxFree(row);
   free(row->render);
   free(row->chars);
-  free(row->hl);
 }
 
 /***
@@ -118,20 +654,26 @@ void editorFreeRow(erow *row) {
  * @param at The index of the row to delete
  */
 void editorDelRow(int at) {
-  if (at < 0 || at >= E.numrows) {
+  if (at < 0 || at >= E.buf->numrows) {
     // There is no row to delete
     return;
   }
 
-  editorFreeRow(&E.row[at]);
-  memmove(&E.row[at], &E.row[at + 1], sizeof(erow) * (E.numrows - at - 1));
+  editorJournalOp(JOURNAL_DELETE_ROW, at, 0, NULL, 0);
+  E.buf->cachebytes -= E.buf->row[at].rsize + 1;
+  editorFreeRow(&E.buf->row[at]);
+  memmove(&E.buf->row[at], &E.buf->row[at + 1],
+          sizeof(erow) * (E.buf->numrows - at - 1));
 
-	for (int j = at; j < E.numrows -1; j++) {
-		E.row[j].idx--;
+	for (int j = at; j < E.buf->numrows -1; j++) {
+		E.buf->row[j].idx--;
+		editorSyntaxMoved(&E.buf->row[j]);
 	}
 
-  E.numrows--;
-  E.dirty++;
+  E.buf->numrows--;
+  editorSyntaxInvalidate(at);
+  E.buf->dirty++;
+  editorWindowDamage(E.buf, at, INT_MAX);
 }
 
 /***
@@ -139,19 +681,91 @@ void editorDelRow(int at) {
  *
  * @param *row The row to insert into
  * @param at The index to insert at
- * @param c The character to insert
+ * @param c The codepoint to insert
+ * @return the number of bytes inserted
+ */
+int editorRowInsertChar(erow *row, int at, int c) {
+  char buf[4];
+  int len = utf8Encode(c, buf);
+
+  editorRowInsertBytes(row, at, buf, len);
+  return len;
+}
+
+/***
+ * Inserts a run of bytes into a row
+ *
+ * @param *row The row to insert into
+ * @param at The index to insert at, past the end appends
+ * @param *s The bytes to insert
+ * @param len The number of bytes
  */
-void editorRowInsertChar(erow *row, int at, int c) {
+void editorRowInsertBytes(erow *row, int at, const char *s, size_t len) {
   if (at < 0 || at > row->size) {
     at = row->size;
   }
 
-  row->chars = realloc(row->chars, row->size + 2);
-  memmove(&row->chars[at + 1], &row->chars[at], row->size - at + 1);
-  row->size++;
-  row->chars[at] = c;
+  editorJournalOp(JOURNAL_INSERT, row->idx, at, s, len);
+  row->chars = realloc(row->chars, row->size + len + 1);
+  memmove(&row->chars[at + len], &row->chars[at], row->size - at + 1);
+  memcpy(&row->chars[at], s, len);
+  row->size += len;
   editorUpdateRow(row);
-  E.dirty++;
+  E.buf->dirty++;
+}
+
+/***
+ * Applies many changes to a row at once
+ *
+ * The row is reallocated and rendered once, however many changes there
+ * are. They are journaled as if made one at a time from the last to the
+ * first, so the offsets of the ones left stay valid
+ *
+ * @param *row The row to change
+ * @param *edits The changes, sorted by offset and not overlapping
+ * @param n The number of changes
+ */
+void editorRowEditMany(erow *row, const struct editorRowEdit *edits, int n) {
+  if (n == 0) {
+    return;
+  }
+
+  int size = row->size;
+  for (int k = 0; k < n; k++) {
+    size += edits[k].len - edits[k].del;
+  }
+  char *chars = malloc(size + 1);
+  if (chars == NULL) {
+    return;
+  }
+
+  for (int k = n - 1; k >= 0; k--) {
+    if (edits[k].del > 0) {
+      editorJournalOp(JOURNAL_DELETE, row->idx, edits[k].at, NULL,
+                      edits[k].del);
+    }
+    if (edits[k].len > 0) {
+      editorJournalOp(JOURNAL_INSERT, row->idx, edits[k].at, edits[k].s,
+                      edits[k].len);
+    }
+  }
+
+  int from = 0;
+  int to = 0;
+  for (int k = 0; k < n; k++) {
+    memcpy(&chars[to], &row->chars[from], edits[k].at - from);
+    to += edits[k].at - from;
+    memcpy(&chars[to], edits[k].s, edits[k].len);
+    to += edits[k].len;
+    from = edits[k].at + edits[k].del;
+  }
+  memcpy(&chars[to], &row->chars[from], row->size - from + 1);
+
+  free(row->chars);
+  row->chars = chars;
+  row->size = size;
+  editorUpdateRow(row);
+  E.buf->dirty++;
 }
 
 /***
@@ -162,12 +776,7 @@ void editorRowInsertChar(erow *row, int at, int c) {
  * @param len The length of the string to append
  */
 void editorRowAppendString(erow *row, char *s, size_t len) {
-  row->chars = realloc(row->chars, row->size + len + 1);
-  memcpy(&row->chars[row->size], s, len);
-  row->size += len;
-  row->chars[row->size] = '\0';
-  editorUpdateRow(row);
-  E.dirty++;
+  editorRowInsertBytes(row, row->size, s, len);
 }
 
 /***
@@ -176,13 +785,26 @@ void editorRowAppendString(erow *row, char *s, size_t len) {
  * @param *row The row to delete from
  * @param at The index to delete
  */
-void editorRowDelChar(erow *row, int at) {
-  if (at < 0 || at >= row->size) {
+void editorRowDelChar(erow *row, int at) { editorRowDelChars(row, at, 1); }
+
+/***
+ * Deletes a run of bytes at the given position
+ *
+ * @param *row The row to delete from
+ * @param at The index of the first byte to delete
+ * @param len The number of bytes to delete
+ */
+void editorRowDelChars(erow *row, int at, int len) {
+  if (at < 0 || at >= row->size || len <= 0) {
     return;
   }
+  if (at + len > row->size) {
+    len = row->size - at;
+  }
 
-  memmove(&row->chars[at], &row->chars[at + 1], row->size - at);
-  row->size--;
+  editorJournalOp(JOURNAL_DELETE, row->idx, at, NULL, len);
+  memmove(&row->chars[at], &row->chars[at + len], row->size - at - len + 1);
+  row->size -= len;
   editorUpdateRow(row);
-  E.dirty++;
+  E.buf->dirty++;
 }
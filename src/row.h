@@ -5,12 +5,28 @@
 
 int editorRowToRx(erow *row, int cx);
 int editorRowRxToCx(erow *row, int rx);
+int editorRowRenderToRx(erow *row, int off);
+int editorRowCxToRender(erow *row, int cx);
+int editorRowPrevCx(erow *row, int cx);
+int editorRowNextCx(erow *row, int cx);
+uint64_t editorRowHash(const char *s, size_t len);
 void editorUpdateRow(erow *row);
 void editorInsertRow(int at, char *s, size_t len);
+int editorRowSplitMany(const struct editorRowPos *at, int n);
+void editorRowJoinMany(const int *rows, int n);
+int editorReplaceRows(int at, int del, char *data, size_t len);
+int editorAppendLines(char *data, size_t len);
+int editorAppendKnownLines(char *data, const struct editorRowInfo *info,
+                           int n);
+int editorInsertRows(int at, char *text, size_t len);
+void editorDelRows(int at, int n);
 void editorFreeRow(erow *row);
 void editorDelRow(int at);
-void editorRowInsertChar(erow *row, int at, int c);
+int editorRowInsertChar(erow *row, int at, int c);
+void editorRowInsertBytes(erow *row, int at, const char *s, size_t len);
+void editorRowEditMany(erow *row, const struct editorRowEdit *edits, int n);
 void editorRowAppendString(erow *row, char *s, size_t len);
 void editorRowDelChar(erow *row, int at);
+void editorRowDelChars(erow *row, int at, int len);
 
 #endif // !ROW_H_
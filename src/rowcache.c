@@ -0,0 +1,422 @@
+#include "rowcache.h"
+#include "compress.h"
+#include "file.h"
+#include "row.h"
+#include <dirent.h>
+#include <sys/mman.h>
+
+#define KILO_ROWCACHE_MAGIC "KILOROW1"
+
+// identifies the file the rows were worked out from, the rows follow it
+struct editorRowCacheHeader {
+  char magic[8];
+  int64_t dev;
+  int64_t ino;
+  int64_t size;
+  int64_t mtime_sec;
+  int64_t mtime_nsec;
+  uint64_t sample; // hash of the start and the end of the file
+  uint64_t syntax; // language the lexer states are for, 0 for none
+  int32_t tabstop; // the renders were measured with
+  int32_t numrows;
+  int32_t hlvalid; // rows whose lexer states are kept
+  int32_t pad;
+};
+
+// a cache mapped while its file is read in
+struct editorRowCache {
+  void *map;
+  size_t maplen;
+  const struct editorRowInfo *info;
+  int numrows;
+  int next; // the record of the next row appended
+};
+
+// a file of the cache directory, while it is pruned
+struct editorRowCacheEntry {
+  char *name;
+  off_t size;
+  time_t used;
+};
+
+// cleared by :set norowcache, caches are then neither read nor written
+static int enabled = 1;
+
+/***
+ * Turns the row caches on or off for the files opened from now on
+ *
+ * @param on Whether to read and write them
+ */
+void editorRowCacheEnable(int on) { enabled = on; }
+
+/***
+ * Builds the name of a file's row cache, named after the hash of its full
+ * path under the user's cache directory
+ *
+ * @param *filename The name of the file
+ * @param create Whether to create the directories on the way
+ * @return the name of the cache, to be freed, NULL if there is none
+ */
+static char *editorRowCachePath(const char *filename, int create) {
+  char *full = realpath(filename, NULL);
+  char *dir = editorFileXdgPath("XDG_CACHE_HOME", ".cache", "kilo/rows");
+  char *path = NULL;
+
+  if (full && dir) {
+    if (create) {
+      for (char *p = strchr(dir + 1, '/'); p; p = strchr(p + 1, '/')) {
+        *p = '\0';
+        mkdir(dir, 0700);
+        *p = '/';
+      }
+      mkdir(dir, 0700);
+    }
+    path = malloc(strlen(dir) + 24);
+    if (path) {
+      sprintf(path, "%s/%016llx", dir,
+              (unsigned long long)editorRowHash(full, strlen(full)));
+    }
+  }
+
+  free(full);
+  free(dir);
+  return path;
+}
+
+/***
+ * Hashes the first and last KILO_ROWCACHE_SAMPLE bytes of a file, a file
+ * rewritten without its size or time changing is caught without reading
+ * all of it
+ *
+ * @param fd The file
+ * @param size The size of the file
+ * @return the hash, 0 if the file can't be read
+ */
+static uint64_t editorRowCacheSample(int fd, off_t size) {
+  char *block = malloc(KILO_ROWCACHE_SAMPLE);
+  if (block == NULL) {
+    return 0;
+  }
+
+  off_t at[2] = {0, size - KILO_ROWCACHE_SAMPLE};
+  uint64_t h = 0;
+  for (int j = 0; j < 2; j++) {
+    ssize_t n = pread(fd, block, KILO_ROWCACHE_SAMPLE, at[j] > 0 ? at[j] : 0);
+    if (n < 0) {
+      free(block);
+      return 0;
+    }
+    h = (h ^ editorRowHash(block, n)) * 0x100000001b3ULL;
+  }
+  free(block);
+  return h;
+}
+
+/***
+ * Hashes the language of a buffer, lexer states are only kept for the one
+ * they were worked out with
+ */
+static uint64_t editorRowCacheSyntax(struct editorBuffer *buf) {
+  if (buf->syntax == NULL) {
+    return 0;
+  }
+  const char *name = buf->syntax->filetype;
+  return editorRowHash(name, strlen(name)) ^ (uint64_t)buf->syntax->flags;
+}
+
+/***
+ * Fills the header describing a buffer's file as it is on disk
+ *
+ * @param *h The header to fill
+ * @param *buf The buffer
+ * @param fd The file
+ */
+static void editorRowCacheHeaderInit(struct editorRowCacheHeader *h,
+                                     struct editorBuffer *buf, int fd) {
+  memset(h, 0, sizeof(*h));
+  memcpy(h->magic, KILO_ROWCACHE_MAGIC, sizeof(h->magic));
+  h->dev = buf->disk.st_dev;
+  h->ino = buf->disk.st_ino;
+  h->size = buf->disk.st_size;
+  h->mtime_sec = buf->disk.st_mtim.tv_sec;
+  h->mtime_nsec = buf->disk.st_mtim.tv_nsec;
+  h->sample = editorRowCacheSample(fd, buf->disk.st_size);
+  h->syntax = editorRowCacheSyntax(buf);
+  h->tabstop = KILO_TAB_STOPS;
+}
+
+/***
+ * Maps the row cache of a file about to be read in, when it was made from
+ * the same file
+ *
+ * @param *buf The buffer the file goes in, stamped with the file's identity
+ * @param fd The file
+ * @return the cache, NULL if there is none or it is for another file
+ */
+struct editorRowCache *editorRowCacheOpen(struct editorBuffer *buf, int fd) {
+  if (!enabled) {
+    return NULL;
+  }
+  char *path = editorRowCachePath(buf->filename, 0);
+  int cfd = path ? open(path, O_RDONLY) : -1;
+  free(path);
+  struct stat st;
+  if (cfd == -1 || fstat(cfd, &st) == -1 ||
+      st.st_size < (off_t)sizeof(struct editorRowCacheHeader)) {
+    if (cfd != -1) {
+      close(cfd);
+    }
+    return NULL;
+  }
+
+  // private, the lexer states of another language are cleared in place
+  void *map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                   cfd, 0);
+  close(cfd);
+  if (map == MAP_FAILED) {
+    return NULL;
+  }
+
+  struct editorRowCacheHeader want, *h = map;
+  editorRowCacheHeaderInit(&want, buf, fd);
+  if (memcmp(h, &want, offsetof(struct editorRowCacheHeader, syntax)) != 0 ||
+      h->tabstop != KILO_TAB_STOPS || h->numrows < 0 ||
+      (size_t)st.st_size !=
+          sizeof(*h) + sizeof(struct editorRowInfo) * h->numrows) {
+    munmap(map, st.st_size);
+    return NULL;
+  }
+
+  struct editorRowCache *rc = malloc(sizeof(struct editorRowCache));
+  if (rc == NULL) {
+    munmap(map, st.st_size);
+    return NULL;
+  }
+  rc->map = map;
+  rc->maplen = st.st_size;
+  rc->info = (const struct editorRowInfo *)(h + 1);
+  rc->numrows = h->numrows;
+  rc->next = 0;
+
+  // the time of a cache is when it was last used, the old ones are pruned
+  path = editorRowCachePath(buf->filename, 0);
+  if (path != NULL) {
+    utimensat(AT_FDCWD, path, NULL, 0);
+    free(path);
+  }
+
+  // lexer states of another language are ignored, the rest is still good
+  buf->hlcached = 0;
+  if (h->syntax == want.syntax) {
+    buf->hlcached = h->hlvalid;
+  } else {
+    for (int j = 0; j < h->hlvalid; j++) {
+      ((struct editorRowInfo *)rc->info)[j].flags &= ~ROW_INFO_LEXED;
+    }
+  }
+  return rc;
+}
+
+/***
+ * Appends a block of whole lines to the current buffer with what the cache
+ * knows of them
+ *
+ * @param *rc The cache
+ * @param *data The lines
+ * @param len The length of the lines
+ * @return the number of rows appended, -1 if the lines are not the ones of
+ * the cache, nothing is appended then
+ */
+int editorRowCacheAppend(struct editorRowCache *rc, char *data, size_t len) {
+  // the lines end where the cache says, and nowhere else is checked
+  size_t pos = 0;
+  int n = 0;
+  while (pos < len && rc->next + n < rc->numrows) {
+    size_t size = rc->info[rc->next + n].size;
+    if (pos + size > len || (pos + size < len && data[pos + size] != '\n')) {
+      return -1;
+    }
+    pos += (pos + size < len) ? size + 1 : size;
+    n++;
+  }
+  if (pos < len) {
+    return -1;
+  }
+
+  int lines = editorAppendKnownLines(data, &rc->info[rc->next], n);
+  if (lines != -1) {
+    rc->next += lines;
+  }
+  return lines;
+}
+
+/***
+ * Unmaps a cache
+ *
+ * @param *rc The cache, NULL does nothing
+ */
+void editorRowCacheClose(struct editorRowCache *rc) {
+  if (rc == NULL) {
+    return;
+  }
+  munmap(rc->map, rc->maplen);
+  free(rc);
+}
+
+/***
+ * Orders the entries of the cache directory from the most recently used
+ */
+static int editorRowCacheCompareUsed(const void *a, const void *b) {
+  const struct editorRowCacheEntry *x = a;
+  const struct editorRowCacheEntry *y = b;
+  return (x->used < y->used) - (x->used > y->used);
+}
+
+/***
+ * Removes the caches not used for KILO_ROWCACHE_AGE, then the least
+ * recently used ones until they all fit in KILO_ROWCACHE_BUDGET
+ *
+ * @param *path The cache just written, it is kept
+ */
+static void editorRowCachePrune(const char *path) {
+  char *dir = strdup(path);
+  char *slash = dir ? strrchr(dir, '/') : NULL;
+  DIR *d = slash ? (*slash = '\0', opendir(dir)) : NULL;
+  if (d == NULL) {
+    free(dir);
+    return;
+  }
+
+  struct editorRowCacheEntry *entries = NULL;
+  int n = 0;
+  int cap = 0;
+  struct dirent *de;
+  while ((de = readdir(d)) != NULL) {
+    struct stat st;
+    if (de->d_name[0] == '.' || strcmp(de->d_name, slash + 1) == 0 ||
+        fstatat(dirfd(d), de->d_name, &st, 0) == -1 || !S_ISREG(st.st_mode)) {
+      continue;
+    }
+    if (n == cap) {
+      cap = cap ? cap * 2 : 64;
+      struct editorRowCacheEntry *new =
+          realloc(entries, sizeof(*entries) * cap);
+      if (new == NULL) {
+        break;
+      }
+      entries = new;
+    }
+    entries[n].name = strdup(de->d_name);
+    entries[n].size = st.st_size;
+    entries[n].used = st.st_mtime;
+    if (entries[n].name != NULL) {
+      n++;
+    }
+  }
+
+  struct stat st;
+  off_t total = (stat(path, &st) == 0) ? st.st_size : 0;
+  time_t oldest = time(NULL) - KILO_ROWCACHE_AGE;
+  qsort(entries, n, sizeof(*entries), editorRowCacheCompareUsed);
+  for (int j = 0; j < n; j++) {
+    total += entries[j].size;
+    if (entries[j].used < oldest || total > KILO_ROWCACHE_BUDGET) {
+      unlinkat(dirfd(d), entries[j].name, 0);
+    }
+    free(entries[j].name);
+  }
+
+  free(entries);
+  closedir(d);
+  free(dir);
+}
+
+/***
+ * Keeps what was worked out from the rows of a buffer for the next time its
+ * file is opened
+ *
+ * Only big files read in the background are kept, and only while the
+ * buffer holds what is on disk. The cache is written again when more lexer
+ * states are known than it has
+ *
+ * @param *buf The buffer
+ */
+void editorRowCacheSave(struct editorBuffer *buf) {
+  if (!enabled || buf->filename == NULL || buf->loader != NULL || buf->follow != NULL ||
+      buf->dirty || buf->cold || buf->disk.st_ino == 0 ||
+      buf->hlvalid <= buf->hlcached ||
+      (buf->disk.st_size < KILO_LOAD_ASYNC &&
+       buf->compression == COMPRESS_NONE) ||
+      editorFileChanged(buf)) {
+    return;
+  }
+
+  int fd = open(buf->filename, O_RDONLY);
+  if (fd == -1) {
+    return;
+  }
+  struct editorRowCacheHeader h;
+  editorRowCacheHeaderInit(&h, buf, fd);
+  close(fd);
+  h.numrows = buf->numrows;
+  h.hlvalid = buf->hlvalid;
+
+  size_t size = sizeof(h) + sizeof(struct editorRowInfo) * buf->numrows;
+  char *blob = malloc(size);
+  if (blob == NULL) {
+    return;
+  }
+  memcpy(blob, &h, sizeof(h));
+
+  struct editorRowInfo *info = (struct editorRowInfo *)(blob + sizeof(h));
+  int64_t total = 0;
+  for (int j = 0; j < buf->numrows; j++) {
+    erow *row = &buf->row[j];
+    if ((uint32_t)row->rwidth >= (UINT32_C(1) << (32 - ROW_INFO_WIDTH_SHIFT))) {
+      free(blob);
+      return;
+    }
+    total += row->size + 1;
+    info[j].hash = row->hash;
+    info[j].size = row->size;
+    info[j].flags = (uint32_t)row->rwidth << ROW_INFO_WIDTH_SHIFT;
+    if (row->ascii) {
+      info[j].flags |= ROW_INFO_ASCII;
+    }
+    if (memchr(row->chars, '\t', row->size) != NULL) {
+      info[j].flags |= ROW_INFO_TABS;
+    }
+    if (j < buf->hlvalid) {
+      info[j].flags |= ROW_INFO_LEXED;
+      info[j].flags |= row->hl_start ? ROW_INFO_START : 0;
+      info[j].flags |= row->hl_open_comment ? ROW_INFO_END : 0;
+    }
+  }
+
+  // lines ending with \r\n lose the \r in their rows, the cache could not
+  // find their newlines again
+  if (buf->compression == COMPRESS_NONE && total != h.size &&
+      total != h.size + 1) {
+    free(blob);
+    return;
+  }
+
+  // written under a temporary name so another editor never maps half of it
+  char *path = editorRowCachePath(buf->filename, 1);
+  char *tmp = path ? malloc(strlen(path) + 16) : NULL;
+  if (tmp != NULL) {
+    sprintf(tmp, "%s.%d", path, (int)getpid());
+    int cfd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (cfd != -1) {
+      int ok = write(cfd, blob, size) == (ssize_t)size;
+      if (close(cfd) == 0 && ok && rename(tmp, path) == 0) {
+        buf->hlcached = buf->hlvalid;
+        editorRowCachePrune(path);
+      }
+    }
+    unlink(tmp);
+  }
+  free(tmp);
+  free(path);
+  free(blob);
+}
@@ -0,0 +1,14 @@
+#ifndef ROWCACHE_H_
+#define ROWCACHE_H_
+
+#include "typedefs.h"
+
+struct editorRowCache;
+
+struct editorRowCache *editorRowCacheOpen(struct editorBuffer *buf, int fd);
+int editorRowCacheAppend(struct editorRowCache *rc, char *data, size_t len);
+void editorRowCacheClose(struct editorRowCache *rc);
+void editorRowCacheSave(struct editorBuffer *buf);
+void editorRowCacheEnable(int on);
+
+#endif // !#ifndef ROWCACHE_H_
@@ -0,0 +1,169 @@
+#ifndef SCAN_H_
+#define SCAN_H_
+
+#include "typedefs.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// the scanners are called once per token by every lexer, so they are
+// defined here to be inlined into the generated and the loaded lexers alike
+
+#ifdef __SSE2__
+/***
+ * Classifies 16 characters as identifier characters
+ *
+ * @param *s The characters
+ * @return a bit per character, set for letters, digits, _ and bytes of
+ * UTF-8 sequences
+ */
+static inline int editorScanIdentMask(const unsigned char *s) {
+  __m128i v = _mm_loadu_si128((const __m128i *)s);
+
+  // a range test is a single signed compare once the range is moved to
+  // the bottom of the signed bytes
+  __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+  __m128i alpha = _mm_add_epi8(lower, _mm_set1_epi8(0x80 - 'a'));
+  __m128i digit = _mm_add_epi8(v, _mm_set1_epi8(0x80 - '0'));
+  alpha = _mm_cmplt_epi8(alpha, _mm_set1_epi8(-128 + 26));
+  digit = _mm_cmplt_epi8(digit, _mm_set1_epi8(-128 + 10));
+  __m128i under = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+  __m128i high = _mm_cmplt_epi8(v, _mm_setzero_si128());
+
+  __m128i ident =
+      _mm_or_si128(_mm_or_si128(alpha, digit), _mm_or_si128(under, high));
+  return _mm_movemask_epi8(ident);
+}
+#endif
+
+/***
+ * Skips a run of spaces, tabs are already spaces in the render
+ *
+ * @param *s The render of a row
+ * @param i Where the run starts
+ * @param n The length of the render
+ * @return the index of the first character that is not a space
+ */
+static inline int editorScanSpaces(const unsigned char *s, int i, int n) {
+  // most runs are a single space between two tokens
+  if (i < n && s[i] != ' ') {
+    return i;
+  }
+#ifdef __SSE2__
+  const __m128i space = _mm_set1_epi8(' ');
+  while (i + 16 <= n) {
+    __m128i v = _mm_loadu_si128((const __m128i *)&s[i]);
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, space));
+    if (mask != 0xffff) {
+      return i + __builtin_ctz(~mask);
+    }
+    i += 16;
+  }
+#endif
+  while (i < n && s[i] == ' ') {
+    i++;
+  }
+  return i;
+}
+
+/***
+ * Skips the rest of a word
+ *
+ * A word ends at a separator or at a character that may start a comment or
+ * a string. Runs of identifier characters are skipped 16 at a time when the
+ * language lets none of them end a word
+ *
+ * @param *class The character classes of the language
+ * @param fast Whether identifier characters never end a word
+ * @param *s The render of a row
+ * @param i Where the rest of the word starts
+ * @param n The length of the render
+ * @return the index of the character ending the word, n at the end
+ */
+static inline int editorScanWord(const unsigned char *class, int fast,
+                                 const unsigned char *s, int i, int n) {
+  (void)fast;
+
+  // most words are short, the vectors only pay off past the first few
+  // characters
+  int head = (n - i < 8) ? n : i + 8;
+  while (i < head) {
+    if (class[s[i]] & (CLASS_SEP | CLASS_STOP)) {
+      return i;
+    }
+    i++;
+  }
+
+  while (i < n) {
+#ifdef __SSE2__
+    if (fast && i + 16 <= n) {
+      int mask = editorScanIdentMask(&s[i]);
+      if (mask == 0xffff) {
+        i += 16;
+        continue;
+      }
+      i += __builtin_ctz(~mask);
+    }
+#endif
+    if (class[s[i]] & (CLASS_SEP | CLASS_STOP)) {
+      break;
+    }
+    i++;
+  }
+  return i;
+}
+
+/***
+ * Skips the inside of a string up to its closing quote or an escape
+ *
+ * @param *s The render of a row
+ * @param i Where the run starts
+ * @param n The length of the render
+ * @param quote The quote that opened the string
+ * @return the index of the quote or backslash, n if there is none
+ */
+static inline int editorScanString(const unsigned char *s, int i, int n,
+                                   int quote) {
+  int head = (n - i < 8) ? n : i + 8;
+  while (i < head) {
+    if (s[i] == quote || s[i] == '\\') {
+      return i;
+    }
+    i++;
+  }
+#ifdef __SSE2__
+  const __m128i q = _mm_set1_epi8(quote);
+  const __m128i backslash = _mm_set1_epi8('\\');
+  while (i + 16 <= n) {
+    __m128i v = _mm_loadu_si128((const __m128i *)&s[i]);
+    int mask = _mm_movemask_epi8(
+        _mm_or_si128(_mm_cmpeq_epi8(v, q), _mm_cmpeq_epi8(v, backslash)));
+    if (mask) {
+      return i + __builtin_ctz(mask);
+    }
+    i += 16;
+  }
+#endif
+  while (i < n && s[i] != quote && s[i] != '\\') {
+    i++;
+  }
+  return i;
+}
+
+/***
+ * Skips the inside of a multiline comment up to what may be its end
+ *
+ * @param *s The render of a row
+ * @param i Where the run starts
+ * @param n The length of the render
+ * @param end The first character of the comment end
+ * @return the index of the next end character, n if there is none
+ */
+static inline int editorScanComment(const unsigned char *s, int i, int n,
+                                    int end) {
+  const unsigned char *p = memchr(&s[i], end, n - i);
+  return p ? p - s : n;
+}
+
+#endif // !#ifndef SCAN_H_
@@ -1,239 +1,361 @@
 #include "syntax.h"
+#include "language.h"
+#include "scan.h"
 #include "typedefs.h"
+#include "window.h"
 #include <string.h>
 #include <unistd.h>
 
-char *C_HL_extensions[] = {".c", ".h", ".cpp", NULL};
-char *C_HL_keywords[] = {
-    "switch",    "if",        "while",    "for",      "break",   "continue",
-    "return",    "else",      "struct",   "union",    "typedef", "static",
-    "enum",      "case",      "default",  "class",    "public",  "private",
-    "protected", "virtual",   "inline",   "volatile", "const",   "goto",
-    "sizeof",    "NULL",      "extern",
-
-    "#define?",  "#include?", "#ifndef?", "#endif?",
-
-    "int|",      "long|",     "double|",  "float|",   "char|",   "unsigned|",
-    "signed|",   "void|",     NULL};
-char *MD_HL_extensions[] = {".md", NULL};
-char *MD_HL_keywords[] = {"#|",     "##|",     "###|", "####|",
-                          "#####|", "######|", NULL};
-
-struct editorSyntax HLDB[] = {{
-                                  "c",
-                                  C_HL_extensions,
-                                  C_HL_keywords,
-                                  "//",
-                                  "/*",
-                                  "*/",
-                                  HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS,
-                              },
-                              {
-                                  "markdown",
-                                  MD_HL_extensions,
-                                  MD_HL_keywords,
-                                  NULL,
-                                  "```",
-                                  "```",
-                                  HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS,
-                              }};
+/***
+ * Looks a word up in the keyword table of a generated lexer
+ *
+ * @param *table The open addressed table, indexed by FNV-1a hash
+ * @param mask The size of the table minus one
+ * @param *s The word
+ * @param len The length of the word
+ * @return the highlight of the keyword, HL_NORMAL if it is not one
+ */
+static inline int editorSyntaxKeyword(const struct editorKeyword *table,
+                                      unsigned int mask, const char *s,
+                                      int len) {
+  unsigned int h = 2166136261u;
+  for (int j = 0; j < len; j++) {
+    h ^= (unsigned char)s[j];
+    h *= 16777619u;
+  }
+
+  for (unsigned int slot = h & mask; table[slot].word;
+       slot = (slot + 1) & mask) {
+    if (table[slot].len == len && memcmp(table[slot].word, s, len) == 0) {
+      return table[slot].hl;
+    }
+  }
+  return HL_NORMAL;
+}
+
+#include "syntax_tables.h"
 
 #define HLDB_ENTRIES (sizeof(HLDB) / sizeof(HLDB[0]))
 
+// put before the spans of a row, links the highlighted rows of all buffers
+// from the most recently drawn to the least
+struct editorHlNode {
+  struct editorHlNode *prev;
+  struct editorHlNode *next;
+  struct editorBuffer *buf;
+  int idx;           // of the row, kept by editorSyntaxMoved
+  unsigned int used; // frame the highlight was last used in
+};
+
+static struct editorHlNode lru = {&lru, &lru, NULL, 0, 0};
+
 /***
- * define if a character is a separator
- *
- * @param c the character
- * @returns whether the character is a separator or not
+ * Gets the node put before the spans of a row that has some
  */
-int is_separator(int c) {
-  return isspace(c) || c == '\0' || strchr(",.()+-/*=~%<>[];\"", c) != NULL;
+static inline struct editorHlNode *editorSyntaxNode(erow *row) {
+  return (struct editorHlNode *)row->hl - 1;
 }
 
-void editorUpdateSyntax(erow *row) {
-  row->hl = realloc(row->hl, row->size);
-  memset(row->hl, HL_NORMAL, row->size);
+/***
+ * Moves a node to the most recently drawn end of the list
+ */
+static void editorSyntaxTouch(struct editorHlNode *node) {
+  node->prev->next = node->next;
+  node->next->prev = node->prev;
+  node->prev = &lru;
+  node->next = lru.next;
+  lru.next->prev = node;
+  lru.next = node;
+  node->used = E.frame;
+}
 
-  if (E.syntax == NULL) {
-    // with no filt type defined, no syntax highlighting needed
+/***
+ * Frees the highlight of a row, it is rebuilt when the row is drawn again
+ *
+ * @param *row The row
+ */
+void editorSyntaxFree(erow *row) {
+  if (row->nhl == -1) {
     return;
   }
+  if (row->nhl > 0) {
+    struct editorHlNode *node = editorSyntaxNode(row);
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    free(node);
+    E.hlbytes -= sizeof(struct editorHlNode);
+  }
+  E.hlbytes -= sizeof(struct editorSpan) * row->nhl;
+  row->hl = NULL;
+  row->nhl = -1;
+}
 
-  char **keywords = E.syntax->keywords;
+/***
+ * Follows a row moved in the row array, once its idx is updated
+ *
+ * @param *row The row
+ */
+void editorSyntaxMoved(erow *row) {
+  if (row->nhl > 0) {
+    editorSyntaxNode(row)->idx = row->idx;
+  }
+}
 
-  char *scs = E.syntax->singleline_comment_start;
-  char *mcs = E.syntax->multiline_comment_start;
-  char *mce = E.syntax->multiline_comment_end;
+/***
+ * Forgets the highlight of a row whose contents or language changed
+ *
+ * Nothing is lexed here, the rows are highlighted when they are drawn
+ *
+ * @param *row The row
+ */
+void editorUpdateSyntax(erow *row) {
+  editorSyntaxFree(row);
+  row->hl_start = -1;
+  editorSyntaxInvalidate(row->idx);
+  editorWindowDamage(E.buf, row->idx, row->idx);
+}
 
-  int scs_len = scs ? strlen(scs) : 0;
-  int mcs_len = mcs ? strlen(mcs) : 0;
-  int mce_len = mce ? strlen(mce) : 0;
+/***
+ * Marks the lexer states from a row on as out of date, for rows whose
+ * predecessor changed without them changing themselves
+ *
+ * @param at The first row to check again
+ */
+void editorSyntaxInvalidate(int at) {
+  if (E.buf->hlvalid > at) {
+    E.buf->hlvalid = at;
+  }
+}
 
-  int prev_sep = 1;
-  int in_string = 0;
-  int in_comment = (row->idx > 0 && E.row[row->idx - 1].hl_open_comment);
+/***
+ * Highlights a row into a scratch buffer shared by all rows
+ *
+ * @param *row The row
+ * @param start The lexer state the row starts in
+ * @param *end Filled with the lexer state the row ends in
+ * @return the highlight of every character, NULL if out of memory
+ */
+static unsigned char *editorSyntaxLex(erow *row, int start, int *end) {
+  static unsigned char *scratch = NULL;
+  static int scratchsize = 0;
 
-  int i = 0;
-  while (i < row->rsize) {
-    char c = row->render[i];
-    unsigned char prev_hl = (i > 0) ? row->hl[i - 1] : HL_NORMAL;
+  // never empty, so an empty row still gets a buffer
+  if (row->rsize + 1 > scratchsize) {
+    unsigned char *new = realloc(scratch, row->rsize + 1);
+    if (new == NULL) {
+      return NULL;
+    }
+    scratch = new;
+    scratchsize = row->rsize + 1;
+  }
+
+  memset(scratch, HL_NORMAL, row->rsize);
+  *end = 0;
+  if (E.buf->syntax != NULL) {
+    *end = E.buf->syntax->lex(E.buf->syntax, row, scratch, start);
+  }
+  return scratch;
+}
+
+/***
+ * Brings the lexer states of the current buffer up to date
+ *
+ * Rows whose start state did not change keep their end state, only the
+ * others are lexed again, just for the state they end in. Their spans are
+ * dropped and rebuilt when they are drawn
+ *
+ * @param to The number of rows that need their states
+ */
+void editorSyntaxAdvance(int to) {
+  if (to > E.buf->numrows) {
+    to = E.buf->numrows;
+  }
 
-    if (scs_len && !in_string && !in_comment) {
-      if (!strncmp(&row->render[i], scs, scs_len)) {
-        memset(&row->hl[i], HL_COMMENT, row->size - i);
-        break;
+  while (E.buf->hlvalid < to) {
+    erow *row = &E.buf->row[E.buf->hlvalid];
+    int start = (row->idx > 0 && row[-1].hl_open_comment);
+    if (row->hl_start != start) {
+      if (editorSyntaxLex(row, start, &row->hl_open_comment) == NULL) {
+        return;
       }
+      editorSyntaxFree(row);
+      row->hl_start = start;
+      editorWindowDamage(E.buf, row->idx, row->idx);
     }
+    E.buf->hlvalid++;
+  }
+}
 
-    if (mcs_len && mce_len && !in_string) {
-      if (in_comment) {
-        row->hl[i] = HL_MLCOMMENT;
-        if (!strncmp(&row->render[i], mce, mce_len)) {
-          memset(&row->hl[i], HL_MLCOMMENT, mce_len);
-          i += mce_len;
-          in_comment = 0;
-          prev_sep = 1;
-          continue;
-        } else {
-          i++;
-          continue;
-        }
-      } else if (!strncmp(&row->render[i], mcs, mcs_len)) {
-        memset(&row->hl[i], HL_MLCOMMENT, mcs_len);
-        i += mcs_len;
-        in_comment = 1;
-        continue;
-      }
+/***
+ * Frees the least recently drawn highlights of all buffers until half of
+ * KILO_HL_LIMIT is used, the rows of the current frame are kept
+ */
+static void editorSyntaxEvict() {
+  while (E.hlbytes > KILO_HL_LIMIT / 2 && lru.prev != &lru &&
+         lru.prev->used != E.frame) {
+    struct editorHlNode *node = lru.prev;
+    editorSyntaxFree(&node->buf->row[node->idx]);
+  }
+}
+
+/***
+ * Packs the highlight of every character of a row into spans
+ *
+ * @param *row The row, its spans are replaced
+ * @param *hl The highlight of every character of the render
+ * @return 0 on success, -1 if out of memory
+ */
+static int editorSyntaxPack(erow *row, const unsigned char *hl) {
+  int count = 0;
+  for (int i = 0; i < row->rsize;) {
+    int j = i + 1;
+    while (j < row->rsize && hl[j] == hl[i] && j - i < UINT16_MAX) {
+      j++;
     }
+    count += (hl[i] != HL_NORMAL);
+    i = j;
+  }
 
-    if (E.syntax->flags & HL_HIGHLIGHT_STRINGS) {
-      if (in_string) {
-        row->hl[i] = HL_STRING;
-        if (c == '\\' && i + 1 < row->rsize) {
-          row->hl[i + 1] = HL_STRING;
-          i += 2;
-          continue;
-        }
-        if (c == in_string) {
-          in_string = 0;
-        }
-        i++;
-        prev_sep = 1;
-        continue;
-      } else {
-        if (c == '"' || c == '\'') {
-          in_string = c;
-          row->hl[i] = HL_STRING;
-          i++;
-          continue;
-        }
-      }
+  struct editorHlNode *node = NULL;
+  struct editorSpan *spans = NULL;
+  if (count > 0) {
+    node = malloc(sizeof(*node) + sizeof(struct editorSpan) * count);
+    if (node == NULL) {
+      return -1;
     }
+    spans = (struct editorSpan *)(node + 1);
+  }
 
-    if (E.syntax->flags & HL_HIGHLIGHT_NUMBERS) {
-      if ((isdigit(c) && (prev_sep || prev_hl == HL_NUMBER)) ||
-          (c == '.' && prev_hl == HL_NUMBER)) {
-        row->hl[i] = HL_NUMBER;
-        i++;
-        prev_sep = 0;
-        continue;
-      }
+  int n = 0;
+  for (int i = 0; i < row->rsize;) {
+    int j = i + 1;
+    while (j < row->rsize && hl[j] == hl[i] && j - i < UINT16_MAX) {
+      j++;
+    }
+    if (hl[i] != HL_NORMAL) {
+      spans[n].start = i;
+      spans[n].len = j - i;
+      spans[n].hl = hl[i];
+      n++;
     }
+    i = j;
+  }
 
-    if (prev_sep) {
-      for (int j = 0; keywords[j]; j++) {
-        int klen = strlen(keywords[j]);
-        int kw2 = keywords[j][klen - 1] == '|';
-        int kw3 = keywords[j][klen - 1] == '?';
-        if (kw2) {
-          // it is a secondary keyword
-          klen--;
-        }
-        if (kw3) {
-          // it is a tertiary keyword
-          klen--;
-        }
-
-        if (!strncmp(&row->render[i], keywords[j], klen) &&
-            is_separator(row->render[i + klen])) {
-          // This is a known keyword
-          int kwPrint = HL_KEYWORD1;
-          if (kw2) {
-            kwPrint = HL_KEYWORD2;
-          } else if (kw3) {
-            kwPrint = HL_KEYWORD3;
-          }
-
-          memset(&row->hl[i], kwPrint, klen);
-          i += klen;
-          break;
-        }
-
-        if (keywords[j] != NULL) {
-          prev_sep = 0;
-          continue;
-        }
-      }
+  editorSyntaxFree(row);
+  row->hl = spans;
+  row->nhl = count;
+  E.hlbytes += sizeof(struct editorSpan) * count;
+  if (node != NULL) {
+    node->prev = node->next = node;
+    node->buf = E.buf;
+    node->idx = row->idx;
+    editorSyntaxTouch(node);
+    E.hlbytes += sizeof(*node);
+  }
+  return 0;
+}
+
+/***
+ * Gets ready to draw a row of the current buffer, lexing it if its spans
+ * were not kept
+ *
+ * @param *row The row
+ * @param *it Set up to walk the spans of the row and the search match
+ * @return 0 on success, -1 if out of memory
+ */
+int editorSyntaxIterInit(erow *row, struct editorSpanIter *it) {
+  editorSyntaxAdvance(row->idx + 1);
+  if (row->nhl > 0) {
+    editorSyntaxTouch(editorSyntaxNode(row));
+  } else if (row->nhl == -1) {
+    // when the states could not be brought this far the row starts in the
+    // state the row above ends in, and its own state is kept if that one is
+    // up to date
+    int start = row->hl_start;
+    if (E.buf->hlvalid <= row->idx) {
+      start = (row->idx > 0 && row[-1].hl_open_comment);
+    }
+    int end;
+    unsigned char *hl = editorSyntaxLex(row, start, &end);
+    if (hl == NULL || editorSyntaxPack(row, hl) == -1) {
+      return -1;
+    }
+    if (E.buf->hlvalid == row->idx) {
+      row->hl_start = start;
+      row->hl_open_comment = end;
+      E.buf->hlvalid++;
     }
 
-    prev_sep = is_separator(c);
-    i++;
+    if (E.hlbytes > KILO_HL_LIMIT) {
+      editorSyntaxEvict();
+    }
   }
 
-  int changed = (row->hl_open_comment != in_comment);
-  row->hl_open_comment = in_comment;
-  if (changed && row->idx + 1 < E.numrows) {
-    editorUpdateSyntax(&E.row[row->idx + 1]);
+  it->span = row->hl;
+  it->end = row->nhl > 0 ? row->hl + row->nhl : row->hl;
+  it->match_start = it->match_end = -1;
+  if (E.buf->match_row == row->idx) {
+    it->match_start = E.buf->match_start;
+    it->match_end = E.buf->match_start + E.buf->match_len;
   }
+  return 0;
 }
 
-int editorSyntaxToColor(int hl) {
-  switch (hl) {
-  case HL_COMMENT:
-  case HL_MLCOMMENT:
-    return 30;
-  case HL_KEYWORD3:
-    return 36;
-  case HL_KEYWORD2:
-    return 32;
-  case HL_KEYWORD1:
-    return 33;
-  case HL_STRING:
-    return 35;
-  case HL_NUMBER:
-    return 31;
-  case HL_MATCH:
-    return 34;
-  default:
-    return 37;
+/***
+ * Checks whether the current buffer's file is written in a language
+ *
+ * @param *s The language
+ * @param *ext The extension of the file, NULL if it has none
+ * @return 1 when one of the language's extensions or names matches
+ */
+static int editorSyntaxMatches(struct editorSyntax *s, const char *ext) {
+  for (int i = 0; s->filematch[i]; i++) {
+    int is_ext = (s->filematch[i][0] == '.');
+    if ((is_ext && ext && !strcmp(ext, s->filematch[i])) ||
+        (!is_ext && strstr(E.buf->filename, s->filematch[i]))) {
+      return 1;
+    }
   }
+  return 0;
 }
 
 void editorSelectSyntaxHighlight() {
-  E.syntax = NULL;
-  if (E.filename == NULL) {
+  E.buf->syntax = NULL;
+  if (E.buf->filename == NULL) {
     return;
   }
 
-  char *ext = strrchr(E.filename, '.');
+  char *ext = strrchr(E.buf->filename, '.');
 
-  for (unsigned int j = 0; j < HLDB_ENTRIES; j++) {
-    struct editorSyntax *s = &HLDB[j];
-    unsigned int i = 0;
-
-    while (s->filematch[i]) {
-      int is_ext = (s->filematch[i][0] == '.');
-      if ((is_ext && ext && !strcmp(ext, s->filematch[i])) ||
-          (!is_ext && strstr(E.filename, s->filematch[i]))) {
-        E.syntax = s;
-
-        for (int filerow = 0; filerow < E.numrows; filerow++) {
-          editorUpdateSyntax(&E.row[filerow]);
-        }
+  // foo.c.gz is highlighted as foo.c
+  if (ext && ext > E.buf->filename &&
+      (strcmp(ext, ".gz") == 0 || strcmp(ext, ".zst") == 0)) {
+    char *inner = ext - 1;
+    while (inner > E.buf->filename && *inner != '.' && *inner != '/') {
+      inner--;
+    }
+    if (*inner == '.') {
+      static char stripped[32];
+      snprintf(stripped, sizeof(stripped), "%.*s", (int)(ext - inner), inner);
+      ext = stripped;
+    }
+  }
 
-        return;
-      }
-      i++;
+  int count;
+  struct editorSyntax *loaded = editorLanguages(&count);
+  for (int j = 0; j < count; j++) {
+    if (editorSyntaxMatches(&loaded[j], ext)) {
+      E.buf->syntax = &loaded[j];
+      break;
+    }
+  }
+  for (unsigned int j = 0; E.buf->syntax == NULL && j < HLDB_ENTRIES; j++) {
+    if (editorSyntaxMatches(&HLDB[j], ext)) {
+      E.buf->syntax = &HLDB[j];
     }
   }
+
+  for (int filerow = 0; filerow < E.buf->numrows; filerow++) {
+    editorUpdateSyntax(&E.buf->row[filerow]);
+  }
 }
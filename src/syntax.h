@@ -3,9 +3,40 @@
 
 #include "typedefs.h"
 
-int is_separator(int c);
+// walks the highlight of a row from left to right, see editorSyntaxIterInit
+struct editorSpanIter {
+  const struct editorSpan *span;
+  const struct editorSpan *end;
+  int match_start, match_end; // the search match, drawn over the spans
+};
+
+void editorSyntaxFree(erow *row);
+void editorSyntaxMoved(erow *row);
 void editorUpdateSyntax(erow *row);
-int editorSyntaxToColor(int hl);
+void editorSyntaxInvalidate(int at);
+void editorSyntaxAdvance(int to);
+int editorSyntaxIterInit(erow *row, struct editorSpanIter *it);
 void editorSelectSyntaxHighlight();
 
+/***
+ * Gets the highlight of a character, the characters must be asked for from
+ * left to right
+ *
+ * @param *it The iterator of the row
+ * @param i The offset of the character in the render
+ * @return the highlight of the character
+ */
+static inline int editorSyntaxAt(struct editorSpanIter *it, int i) {
+  if (i >= it->match_start && i < it->match_end) {
+    return HL_MATCH;
+  }
+  while (it->span < it->end && (int)(it->span->start + it->span->len) <= i) {
+    it->span++;
+  }
+  if (it->span < it->end && (int)it->span->start <= i) {
+    return it->span->hl;
+  }
+  return HL_NORMAL;
+}
+
 #endif // !#ifndef SYNTAX_H_
@@ -0,0 +1,317 @@
+#include "syntaxdef.h"
+
+// characters that end a word, as the original highlighter had them
+#define SYNTAX_SEPARATORS ",.()+-/*=~%<>[];\""
+
+/***
+ * The hash of the keyword tables
+ *
+ * @param *s The word
+ * @param len The length of the word
+ * @return the 32 bit FNV-1a hash of the word
+ */
+unsigned int editorSyntaxDefHash(const char *s, int len) {
+  unsigned int h = 2166136261u;
+  for (int j = 0; j < len; j++) {
+    h ^= (unsigned char)s[j];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+/***
+ * Reads the next whitespace separated word of a line
+ *
+ * @param **line The position in the line, advanced past the word
+ * @return the word, NULL at the end of the line
+ */
+static char *editorSyntaxDefWord(char **line) {
+  char *s = *line;
+  while (*s && isspace((unsigned char)*s)) {
+    s++;
+  }
+  if (*s == '\0') {
+    *line = s;
+    return NULL;
+  }
+
+  char *word = s;
+  while (*s && !isspace((unsigned char)*s)) {
+    s++;
+  }
+  if (*s) {
+    *s++ = '\0';
+  }
+  *line = s;
+  return word;
+}
+
+/***
+ * Appends a pointer to a growing array
+ *
+ * @return 0 on success, -1 when out of memory
+ */
+static int editorSyntaxDefPush(char ***array, int *count, char *s) {
+  char **new = realloc(*array, sizeof(char *) * (*count + 2));
+  if (new == NULL) {
+    return -1;
+  }
+  new[(*count)++] = s;
+  new[*count] = NULL;
+  *array = new;
+  return 0;
+}
+
+/***
+ * Fills the character classes of a parsed definition
+ *
+ * CLASS_STOP marks the characters that may start a comment or a string, a
+ * word being scanned for a keyword ends there
+ */
+static void editorSyntaxDefClasses(struct editorSyntaxDef *def) {
+  for (int c = 0; c < 256; c++) {
+    def->class[c] = 0;
+    if (isspace(c) || c == '\0' || strchr(SYNTAX_SEPARATORS, c) != NULL) {
+      def->class[c] |= CLASS_SEP;
+    }
+    if (isspace(c)) {
+      def->class[c] |= CLASS_SPACE;
+    }
+    if (c >= '0' && c <= '9') {
+      def->class[c] |= CLASS_DIGIT;
+    }
+    if (isalnum(c) || c == '_' || c >= 0x80) {
+      def->class[c] |= CLASS_IDENT;
+    }
+  }
+
+  if (def->scs) {
+    def->class[(unsigned char)def->scs[0]] |= CLASS_STOP;
+  }
+  if (def->mcs) {
+    def->class[(unsigned char)def->mcs[0]] |= CLASS_STOP;
+  }
+  if (def->flags & HL_HIGHLIGHT_STRINGS) {
+    def->class['"'] |= CLASS_STOP | CLASS_QUOTE;
+    def->class['\''] |= CLASS_STOP | CLASS_QUOTE;
+  }
+
+  def->fast = 1;
+  for (int c = 0; c < 256; c++) {
+    if ((def->class[c] & CLASS_IDENT) && (def->class[c] & CLASS_STOP)) {
+      def->fast = 0;
+    }
+  }
+}
+
+/***
+ * Builds the keyword hash table of a parsed definition, the first of
+ * duplicated words wins
+ *
+ * @return 0 on success, -1 when out of memory
+ */
+static int editorSyntaxDefTable(struct editorSyntaxDef *def) {
+  def->tablesize = 16;
+  while (def->tablesize < def->nwords * 2) {
+    def->tablesize *= 2;
+  }
+  def->table = malloc(sizeof(int) * def->tablesize);
+  if (def->table == NULL) {
+    return -1;
+  }
+  for (int j = 0; j < def->tablesize; j++) {
+    def->table[j] = -1;
+  }
+
+  unsigned int mask = def->tablesize - 1;
+  for (int j = 0; j < def->nwords; j++) {
+    int len = strlen(def->words[j]);
+    unsigned int slot = editorSyntaxDefHash(def->words[j], len) & mask;
+    while (def->table[slot] != -1 &&
+           strcmp(def->words[def->table[slot]], def->words[j]) != 0) {
+      slot = (slot + 1) & mask;
+    }
+    if (def->table[slot] != -1) {
+      continue;
+    }
+
+    def->table[slot] = j;
+    def->class[(unsigned char)def->words[j][0]] |= CLASS_KEYWORD;
+    if (def->minlen == 0 || len < def->minlen) {
+      def->minlen = len;
+    }
+    if (len > def->maxlen) {
+      def->maxlen = len;
+    }
+  }
+  return 0;
+}
+
+/***
+ * Parses the directives of a definition, see editorSyntaxDefParse
+ *
+ * @return 0 on success, -1 with err filled on error
+ */
+static int editorSyntaxDefRead(struct editorSyntaxDef *def, const char *name,
+                               char *err, size_t errsize) {
+  int lineno = 0;
+  char *next = def->text;
+  while (*next) {
+    char *line = next;
+    next = strchr(line, '\n');
+    if (next) {
+      *next++ = '\0';
+    } else {
+      next = line + strlen(line);
+    }
+    lineno++;
+
+    char *directive = editorSyntaxDefWord(&line);
+    if (directive == NULL || directive[0] == '#') {
+      continue;
+    }
+
+    char *arg;
+    int nomem = 0;
+    if (strcmp(directive, "filetype") == 0) {
+      if ((def->filetype = editorSyntaxDefWord(&line)) == NULL) {
+        snprintf(err, errsize, "%s:%d: filetype needs a name", name, lineno);
+        return -1;
+      }
+    } else if (strcmp(directive, "match") == 0) {
+      while ((arg = editorSyntaxDefWord(&line))) {
+        nomem |= editorSyntaxDefPush(&def->match, &def->nmatch, arg);
+      }
+    } else if (strcmp(directive, "comment") == 0) {
+      if ((def->scs = editorSyntaxDefWord(&line)) == NULL) {
+        snprintf(err, errsize, "%s:%d: comment needs a delimiter", name,
+                 lineno);
+        return -1;
+      }
+    } else if (strcmp(directive, "multiline") == 0) {
+      def->mcs = editorSyntaxDefWord(&line);
+      def->mce = editorSyntaxDefWord(&line);
+      if (def->mce == NULL) {
+        snprintf(err, errsize, "%s:%d: multiline needs two delimiters", name,
+                 lineno);
+        return -1;
+      }
+    } else if (strcmp(directive, "highlight") == 0) {
+      while ((arg = editorSyntaxDefWord(&line))) {
+        if (strcmp(arg, "numbers") == 0) {
+          def->flags |= HL_HIGHLIGHT_NUMBERS;
+        } else if (strcmp(arg, "strings") == 0) {
+          def->flags |= HL_HIGHLIGHT_STRINGS;
+        } else {
+          snprintf(err, errsize, "%s:%d: unknown highlight '%s'", name,
+                   lineno, arg);
+          return -1;
+        }
+      }
+    } else if (strncmp(directive, "keyword", 7) == 0 &&
+               directive[7] >= '1' && directive[7] <= '3' &&
+               directive[8] == '\0') {
+      while ((arg = editorSyntaxDefWord(&line))) {
+        unsigned char *hl = realloc(def->hl, def->nwords + 1);
+        if (hl == NULL) {
+          nomem = 1;
+          break;
+        }
+        def->hl = hl;
+        def->hl[def->nwords] = HL_KEYWORD1 + (directive[7] - '1');
+        nomem |= editorSyntaxDefPush(&def->words, &def->nwords, arg);
+      }
+    } else {
+      snprintf(err, errsize, "%s:%d: unknown directive '%s'", name, lineno,
+               directive);
+      return -1;
+    }
+
+    if (nomem) {
+      snprintf(err, errsize, "%s: out of memory", name);
+      return -1;
+    }
+  }
+
+  if (def->filetype == NULL || def->nmatch == 0) {
+    snprintf(err, errsize, "%s: filetype and match are required", name);
+    return -1;
+  }
+  for (char *c = def->filetype; *c; c++) {
+    if (!isalnum((unsigned char)*c) && *c != '_') {
+      snprintf(err, errsize, "%s: filetype '%s' is not an identifier", name,
+               def->filetype);
+      return -1;
+    }
+  }
+
+  editorSyntaxDefClasses(def);
+  for (int j = 0; j < def->nwords; j++) {
+    for (char *c = def->words[j]; *c; c++) {
+      if (def->class[(unsigned char)*c] & (CLASS_SEP | CLASS_STOP)) {
+        snprintf(err, errsize, "%s: keyword '%s' can't contain '%c'", name,
+                 def->words[j], *c);
+        return -1;
+      }
+    }
+  }
+
+  if (editorSyntaxDefTable(def) == -1) {
+    snprintf(err, errsize, "%s: out of memory", name);
+    return -1;
+  }
+  return 0;
+}
+
+/***
+ * Parses a language definition
+ *
+ * A definition is a list of directives, one per line, # starts a comment:
+ *
+ *   filetype <name>
+ *   match <extension or substring>...
+ *   comment <single line comment start>
+ *   multiline <comment start> <comment end>
+ *   highlight [numbers] [strings]
+ *   keyword1|keyword2|keyword3 <word>...
+ *
+ * @param *def The definition to fill, freed with editorSyntaxDefFree
+ * @param *name The name of the definition for the error messages
+ * @param *text The definition
+ * @param len The length of the definition
+ * @param *err Filled with the reason when parsing fails
+ * @param errsize The size of err
+ * @return 0 on success, -1 on error
+ */
+int editorSyntaxDefParse(struct editorSyntaxDef *def, const char *name,
+                         const char *text, size_t len, char *err,
+                         size_t errsize) {
+  memset(def, 0, sizeof(*def));
+  def->text = malloc(len + 1);
+  if (def->text == NULL) {
+    snprintf(err, errsize, "%s: out of memory", name);
+    return -1;
+  }
+  memcpy(def->text, text, len);
+  def->text[len] = '\0';
+
+  if (editorSyntaxDefRead(def, name, err, errsize) == -1) {
+    editorSyntaxDefFree(def);
+    return -1;
+  }
+  return 0;
+}
+
+/***
+ * Frees a parsed definition
+ *
+ * @param *def The definition
+ */
+void editorSyntaxDefFree(struct editorSyntaxDef *def) {
+  free(def->text);
+  free(def->match);
+  free(def->words);
+  free(def->hl);
+  free(def->table);
+  memset(def, 0, sizeof(*def));
+}
@@ -0,0 +1,38 @@
+#ifndef SYNTAXDEF_H_
+#define SYNTAXDEF_H_
+
+#include "typedefs.h"
+
+// a parsed syntax/*.syntax file, shared by tools/syntaxgen.c and the
+// languages loaded at runtime
+struct editorSyntaxDef {
+  char *text; // the definition, the strings below point into it
+
+  char *filetype;
+  char **match;
+  int nmatch;
+  char *scs;
+  char *mcs;
+  char *mce;
+  int flags; // HL_HIGHLIGHT_ flags
+
+  char **words;
+  unsigned char *hl; // HL_KEYWORD of each word
+  int nwords;
+
+  unsigned char class[256]; // CLASS_ bits of every character
+  int fast; // no identifier character ends a word, see editorScanWord
+
+  // open addressed keyword table, indexes into words, -1 for empty slots
+  int *table;
+  int tablesize; // a power of two
+  int minlen, maxlen;
+};
+
+unsigned int editorSyntaxDefHash(const char *s, int len);
+int editorSyntaxDefParse(struct editorSyntaxDef *def, const char *name,
+                         const char *text, size_t len, char *err,
+                         size_t errsize);
+void editorSyntaxDefFree(struct editorSyntaxDef *def);
+
+#endif // !#ifndef SYNTAXDEF_H_
@@ -1,4 +1,10 @@
 #include "terminal.h"
+#include "event.h"
+#include "macro.h"
+#include "utf8.h"
+
+// a byte read past the end of a broken multibyte sequence, -1 when empty
+static int pushback = -1;
 
 /***
  * Prints an error message and exits
@@ -97,19 +103,31 @@ void enableRowMode() {
 }
 
 /***
- * Wait for a key to be pressed and return it
+ * Wait for a key to be pressed on the terminal and return it
  *
  * @return the key
  */
-int editorReadKey() {
+static int editorReadTerminalKey() {
   int nread;
-  char c;
+  unsigned char c;
+
+  while (pushback == -1) {
+    if (!editorEventWait(-1)) {
+      return REFRESH_KEY;
+    }
 
-  while ((nread = read(STDIN_FILENO, &c, 1)) != 1) {
+    nread = read(STDIN_FILENO, &c, 1);
+    if (nread == 1) {
+      break;
+    }
     if (nread == -1 && errno != EAGAIN) {
       die("editorReadKey: read");
     }
   }
+  if (pushback != -1) {
+    c = pushback;
+    pushback = -1;
+  }
 
   if (c == '\x1b') {
     char seq[3];
@@ -173,6 +191,28 @@ int editorReadKey() {
     return '\x1b';
   }
 
+  if (c >= 0x80) {
+    // collect the rest of a multibyte sequence and return its codepoint, a
+    // stray or cut short sequence is read as the replacement character and a
+    // byte that ends it early is kept as the start of the next key
+    char seq[4];
+    int len = (c < 0xC0) ? 1 : (c < 0xE0) ? 2 : (c < 0xF0) ? 3 : 4;
+    seq[0] = c;
+    for (int i = 1; i < len; i++) {
+      if (read(STDIN_FILENO, &seq[i], 1) != 1) {
+        return 0xFFFD;
+      }
+      if (!UTF8_IS_CONT(seq[i])) {
+        pushback = (unsigned char)seq[i];
+        return 0xFFFD;
+      }
+    }
+
+    unsigned int cp;
+    utf8Decode(seq, len, &cp);
+    return cp;
+  }
+
   return c;
 }
 
@@ -228,3 +268,22 @@ int getWindowSize(int *rows, int *cols) {
   *cols = ws.ws_col;
   return 0;
 }
+
+/***
+ * Wait for a key to be pressed and return it, the keys of a macro being
+ * replayed come first and the ones typed are recorded
+ *
+ * @return the key
+ */
+int editorReadKey() {
+  int key;
+  if (editorMacroNext(&key)) {
+    return key;
+  }
+
+  key = editorReadTerminalKey();
+  if (key != REFRESH_KEY) {
+    editorMacroKey(key);
+  }
+  return key;
+}
@@ -0,0 +1,345 @@
+#include "theme.h"
+#include "file.h"
+#include "input.h"
+
+#include <limits.h>
+
+#define THEME_BOLD (1 << 0)
+#define THEME_ITALIC (1 << 1)
+#define THEME_UNDERLINE (1 << 2)
+
+enum editorColorKind { COLOR_DEFAULT, COLOR_INDEX, COLOR_RGB };
+
+struct editorColor {
+  enum editorColorKind kind;
+  int value; // a palette index or 0xRRGGBB
+};
+
+struct editorStyle {
+  struct editorColor fg, bg;
+  int attrs; // THEME_ flags
+};
+
+// the escapes changing from one style to another, composed once
+struct editorThemeSeq {
+  int len;
+  char s[THEME_SEQ_MAX];
+};
+
+static struct editorStyle styles[THEME_STYLES];
+static struct editorThemeSeq seqs[THEME_STYLES][THEME_STYLES];
+static int depth = 16; // colors the terminal shows: 16, 256 or 1 << 24
+
+static const char *names[THEME_STYLES] = {
+    "normal", "comment", "mlcomment", "keyword1", "keyword2", "keyword3",
+    "string", "number",  "match",     NULL,       "gutter"};
+
+// the 16 colors of the usual xterm palette
+static const int basic[16] = {
+    0x000000, 0xcd0000, 0x00cd00, 0xcdcd00, 0x0000ee, 0xcd00cd,
+    0x00cdcd, 0xe5e5e5, 0x7f7f7f, 0xff0000, 0x00ff00, 0xffff00,
+    0x5c5cff, 0xff00ff, 0x00ffff, 0xffffff};
+
+static const char *basicnames[8] = {"black", "red",     "green", "yellow",
+                                    "blue",  "magenta", "cyan",  "white"};
+
+/***
+ * Sets the styles the editor always had
+ */
+static void editorThemeDefaults() {
+  static const int fg[THEME_STYLES] = {-1, 0, 0, 3, 2, 6, 5, 1, 4, -1, 226};
+
+  memset(styles, 0, sizeof(styles));
+  for (int j = 0; j < THEME_STYLES; j++) {
+    if (fg[j] != -1) {
+      styles[j].fg.kind = COLOR_INDEX;
+      styles[j].fg.value = fg[j];
+    }
+  }
+  styles[THEME_GUTTER].bg.kind = COLOR_INDEX;
+  styles[THEME_GUTTER].bg.value = 59;
+}
+
+/***
+ * Gives the red, green and blue of a palette color
+ *
+ * @param n The index, 0 to 255
+ * @return the color as 0xRRGGBB
+ */
+static int editorThemeIndexRgb(int n) {
+  if (n < 16) {
+    return basic[n];
+  }
+  if (n >= 232) {
+    int v = 8 + 10 * (n - 232);
+    return (v << 16) | (v << 8) | v;
+  }
+  static const int levels[6] = {0, 95, 135, 175, 215, 255};
+  n -= 16;
+  return (levels[n / 36] << 16) | (levels[n / 6 % 6] << 8) | levels[n % 6];
+}
+
+/***
+ * Measures how far apart two colors look, roughly
+ */
+static int editorThemeDistance(int a, int b) {
+  int dr = ((a >> 16) & 0xff) - ((b >> 16) & 0xff);
+  int dg = ((a >> 8) & 0xff) - ((b >> 8) & 0xff);
+  int db = (a & 0xff) - (b & 0xff);
+  return 2 * dr * dr + 4 * dg * dg + 3 * db * db;
+}
+
+/***
+ * Finds the palette color closest to a color
+ *
+ * @param rgb The color as 0xRRGGBB
+ * @param count 16 to pick among the basic colors, 256 among all of them
+ * @return the index of the closest one
+ */
+static int editorThemeNearest(int rgb, int count) {
+  int best = 0;
+  int bestdist = INT_MAX;
+  for (int n = 0; n < count; n++) {
+    int d = editorThemeDistance(rgb, editorThemeIndexRgb(n));
+    if (d < bestdist) {
+      best = n;
+      bestdist = d;
+    }
+  }
+  return best;
+}
+
+/***
+ * Appends the parameter setting a color as the terminal can show it
+ *
+ * @param *p Where to write
+ * @param c The color
+ * @param bg Whether it is the background
+ * @return the number of bytes written
+ */
+static int editorThemeColor(char *p, struct editorColor c, int bg) {
+  if (c.kind == COLOR_DEFAULT) {
+    return sprintf(p, bg ? "49" : "39");
+  }
+
+  int n = c.value;
+  if (c.kind == COLOR_RGB && depth == (1 << 24)) {
+    return sprintf(p, "%d;2;%d;%d;%d", bg ? 48 : 38, (n >> 16) & 0xff,
+                   (n >> 8) & 0xff, n & 0xff);
+  }
+  if (c.kind == COLOR_RGB) {
+    n = editorThemeNearest(n, depth);
+  } else if (n >= 16 && depth == 16) {
+    n = editorThemeNearest(editorThemeIndexRgb(n), 16);
+  }
+
+  if (n < 8) {
+    return sprintf(p, "%d", (bg ? 40 : 30) + n);
+  }
+  if (n < 16) {
+    return sprintf(p, "%d", (bg ? 100 : 90) + n - 8);
+  }
+  return sprintf(p, "%d;5;%d", bg ? 48 : 38, n);
+}
+
+/***
+ * Composes the escape changing the terminal from one style to another,
+ * only what differs is changed
+ *
+ * @param *a The style set
+ * @param *b The style wanted
+ * @param *seq Filled with the escape, empty when they look the same
+ */
+static void editorThemeCompose(const struct editorStyle *a,
+                               const struct editorStyle *b,
+                               struct editorThemeSeq *seq) {
+  static const int on[3] = {1, 3, 4};
+  static const int off[3] = {22, 23, 24};
+  char params[THEME_SEQ_MAX];
+  int len = 0;
+
+  for (int j = 0; j < 3; j++) {
+    if ((a->attrs ^ b->attrs) & (1 << j)) {
+      len += sprintf(&params[len], "%s%d", len ? ";" : "",
+                     (b->attrs & (1 << j)) ? on[j] : off[j]);
+    }
+  }
+  if (a->fg.kind != b->fg.kind || a->fg.value != b->fg.value) {
+    len += sprintf(&params[len], "%s", len ? ";" : "");
+    len += editorThemeColor(&params[len], b->fg, 0);
+  }
+  if (a->bg.kind != b->bg.kind || a->bg.value != b->bg.value) {
+    len += sprintf(&params[len], "%s", len ? ";" : "");
+    len += editorThemeColor(&params[len], b->bg, 1);
+  }
+
+  seq->len = 0;
+  if (len > 0) {
+    seq->len = sprintf(seq->s, "\x1b[%.*sm", len, params);
+  }
+}
+
+/***
+ * Reads a color of a theme
+ *
+ * @param *word default, a name of the 8 basic colors, a palette index or
+ * #rrggbb
+ * @param *c Filled with the color
+ * @return 0 on success, -1 if the color is not understood
+ */
+static int editorThemeParseColor(const char *word, struct editorColor *c) {
+  char *end;
+  if (strcmp(word, "default") == 0) {
+    c->kind = COLOR_DEFAULT;
+    c->value = 0;
+    return 0;
+  }
+  for (int j = 0; j < 8; j++) {
+    if (strcmp(word, basicnames[j]) == 0) {
+      c->kind = COLOR_INDEX;
+      c->value = j;
+      return 0;
+    }
+  }
+  if (word[0] == '#' && strlen(word) == 7) {
+    long v = strtol(&word[1], &end, 16);
+    if (*end == '\0') {
+      c->kind = COLOR_RGB;
+      c->value = v;
+      return 0;
+    }
+  }
+  long v = strtol(word, &end, 10);
+  if (word[0] != '\0' && *end == '\0' && v >= 0 && v <= 255) {
+    c->kind = COLOR_INDEX;
+    c->value = v;
+    return 0;
+  }
+  return -1;
+}
+
+/***
+ * Reads a line of a theme
+ *
+ * @param *line The line, split in place
+ * @return 0 on success, -1 if the line is not understood
+ */
+static int editorThemeParseLine(char *line) {
+  char *words[8];
+  int n = 0;
+  for (char *w = strtok(line, " \t"); w && n < 8; w = strtok(NULL, " \t")) {
+    words[n++] = w;
+  }
+  if (n == 0 || words[0][0] == '#') {
+    return 0;
+  }
+
+  if (strcmp(words[0], "colors") == 0 && n == 2) {
+    if (strcmp(words[1], "truecolor") == 0) {
+      depth = 1 << 24;
+    } else if (strcmp(words[1], "256") == 0 || strcmp(words[1], "16") == 0) {
+      depth = atoi(words[1]);
+    } else {
+      return -1;
+    }
+    return 0;
+  }
+
+  int style = 0;
+  while (style < THEME_STYLES &&
+         (names[style] == NULL || strcmp(names[style], words[0]) != 0)) {
+    style++;
+  }
+  if (style == THEME_STYLES || n < 2) {
+    return -1;
+  }
+
+  struct editorStyle s = {{COLOR_DEFAULT, 0}, {COLOR_DEFAULT, 0}, 0};
+  if (editorThemeParseColor(words[1], &s.fg) == -1) {
+    return -1;
+  }
+  for (int j = 2; j < n; j++) {
+    if (strcmp(words[j], "on") == 0 && j + 1 < n) {
+      if (editorThemeParseColor(words[++j], &s.bg) == -1) {
+        return -1;
+      }
+    } else if (strcmp(words[j], "bold") == 0) {
+      s.attrs |= THEME_BOLD;
+    } else if (strcmp(words[j], "italic") == 0) {
+      s.attrs |= THEME_ITALIC;
+    } else if (strcmp(words[j], "underline") == 0) {
+      s.attrs |= THEME_UNDERLINE;
+    } else {
+      return -1;
+    }
+  }
+  styles[style] = s;
+  return 0;
+}
+
+/***
+ * Loads the user's theme and composes the escapes of every change of style
+ *
+ * A theme has a line per style, # starts a comment:
+ *
+ *   colors truecolor|256|16
+ *   <style> <color> [on <color>] [bold] [italic] [underline]
+ *
+ * The styles are normal, comment, mlcomment, keyword1 to keyword3, string,
+ * number, match and gutter. Colors are default, black to white, a palette
+ * index or #rrggbb, turned into the closest ones the terminal shows
+ */
+void editorThemeLoad() {
+  const char *colorterm = getenv("COLORTERM");
+  const char *term = getenv("TERM");
+  if (colorterm && (strcmp(colorterm, "truecolor") == 0 ||
+                    strcmp(colorterm, "24bit") == 0)) {
+    depth = 1 << 24;
+  } else if (term && strstr(term, "256color")) {
+    depth = 256;
+  }
+  editorThemeDefaults();
+
+  char *path = editorFileXdgPath("XDG_CONFIG_HOME", ".config", "kilo/theme");
+  size_t len;
+  char *text = path ? editorFileRead(path, &len) : NULL;
+  if (text != NULL) {
+    int lineno = 0;
+    char *next = text;
+    while (next < text + len) {
+      char *line = next;
+      char *nl = memchr(line, '\n', text + len - line);
+      if (nl) {
+        *nl = '\0';
+        next = nl + 1;
+      } else {
+        next = text + len;
+      }
+      lineno++;
+      if (editorThemeParseLine(line) == -1) {
+        editorSetStatusMessage("Theme error: line %d", lineno);
+      }
+    }
+  }
+  free(text);
+  free(path);
+
+  for (int a = 0; a < THEME_STYLES; a++) {
+    for (int b = 0; b < THEME_STYLES; b++) {
+      editorThemeCompose(&styles[a], &styles[b], &seqs[a][b]);
+    }
+  }
+}
+
+/***
+ * Gives the escape changing the terminal from one style to another
+ *
+ * @param from The style set, a highlight or THEME_RESET
+ * @param to The style wanted, a highlight, THEME_RESET or THEME_GUTTER
+ * @param *len Filled with the length of the escape, 0 when nothing changes
+ * @return the escape
+ */
+const char *editorThemeSeq(int from, int to, int *len) {
+  *len = seqs[from][to].len;
+  return seqs[from][to].s;
+}
@@ -0,0 +1,14 @@
+#ifndef THEME_H_
+#define THEME_H_
+
+#include "typedefs.h"
+
+#define THEME_RESET (HL_MATCH + 1) // what the terminal has after \x1b[m
+#define THEME_GUTTER (HL_MATCH + 2)
+#define THEME_STYLES (HL_MATCH + 3)
+#define THEME_SEQ_MAX 64 // every attribute and two truecolor colors
+
+void editorThemeLoad();
+const char *editorThemeSeq(int from, int to, int *len);
+
+#endif // !#ifndef THEME_H_
@@ -0,0 +1,459 @@
+#include "trigram.h"
+
+// every trigram sets one bit of its block, picked by a multiplicative hash
+#define TRIGRAM_SHIFT 13
+#define TRIGRAM_WORDS ((1 << TRIGRAM_SHIFT) / 64)
+
+// blocks past this many times their size are split by building again
+#define TRIGRAM_OVERGROWN 8
+
+struct editorTrigramBlock {
+  int bytes; // of text added to bits since they were cleared
+  int size;  // of text the bits were last built from, 0 if never
+  uint64_t bits[TRIGRAM_WORDS];
+};
+
+// the blocks of lines read in the background, in the order of the lines
+struct editorTrigramBatch {
+  int numblocks;
+  int *rows; // lines each block covers
+  struct editorTrigramBlock *blocks;
+};
+
+// the rows of a buffer are cut in consecutive blocks and each row keeps
+// the number of its block, so the numbers only grow down the buffer. Rows
+// that change or come in add their trigrams to the block they land in,
+// bits are never cleared until the block is built again
+struct editorTrigramIndex {
+  struct editorTrigramBlock *blocks;
+  int numblocks;
+  int cap;
+
+  // rows appended while a batch is adopted take its blocks in turn
+  const struct editorTrigramBatch *adopt;
+  int adoptfirst; // number of the first block of the batch
+  int adoptnext;  // the batch block rows are placed in
+  int adoptleft;  // rows left for it
+
+  int overgrown; // a block grew too big, the index is to be built again
+};
+
+/***
+ * Adds the trigrams of a line to a block, tabs count as the spaces they are
+ * drawn as so the line is indexed as its render
+ *
+ * @param *blk The block
+ * @param *s The line
+ * @param len The length of the line
+ */
+static void editorTrigramAdd(struct editorTrigramBlock *blk, const char *s,
+                             size_t len) {
+  uint32_t t = 0;
+  size_t col = 0;
+  for (size_t j = 0; j < len; j++) {
+    unsigned char c = s[j];
+    size_t times = 1;
+    if (c == '\t') {
+      c = ' ';
+      times = KILO_TAB_STOPS - col % KILO_TAB_STOPS;
+    }
+    while (times--) {
+      t = ((t << 8) | c) & 0xffffff;
+      if (++col >= 3) {
+        uint32_t bit = (t * 0x9e3779b1u) >> (32 - TRIGRAM_SHIFT);
+        blk->bits[bit >> 6] |= (uint64_t)1 << (bit & 63);
+      }
+    }
+  }
+  blk->bytes += len;
+}
+
+/***
+ * Appends an empty block to an index
+ *
+ * @param *ix The index
+ * @return the number of the block, -1 if out of memory
+ */
+static int editorTrigramBlockNew(struct editorTrigramIndex *ix) {
+  if (ix->numblocks == ix->cap) {
+    int cap = ix->cap ? ix->cap * 2 : 64;
+    struct editorTrigramBlock *new =
+        realloc(ix->blocks, sizeof(struct editorTrigramBlock) * cap);
+    if (new == NULL) {
+      return -1;
+    }
+    ix->blocks = new;
+    ix->cap = cap;
+  }
+  memset(&ix->blocks[ix->numblocks], 0, sizeof(struct editorTrigramBlock));
+  return ix->numblocks++;
+}
+
+/***
+ * Allocates an empty index
+ *
+ * @return the index, NULL if out of memory
+ */
+struct editorTrigramIndex *editorTrigramNew() {
+  return calloc(1, sizeof(struct editorTrigramIndex));
+}
+
+/***
+ * Frees an index
+ *
+ * @param *ix The index, NULL does nothing
+ */
+void editorTrigramFree(struct editorTrigramIndex *ix) {
+  if (ix == NULL) {
+    return;
+  }
+  free(ix->blocks);
+  free(ix);
+}
+
+/***
+ * Cuts the rows of the current buffer in blocks again and builds each of
+ * them from the rows' renders
+ *
+ * @param *ix The index of the current buffer
+ * @return 0 on success, -1 if out of memory
+ */
+static int editorTrigramBuild(struct editorTrigramIndex *ix) {
+  ix->numblocks = 0;
+  ix->overgrown = 0;
+  int b = -1;
+  for (int j = 0; j < E.buf->numrows; j++) {
+    if (b == -1 || ix->blocks[b].bytes >= KILO_TRIGRAM_BLOCK) {
+      if (b != -1) {
+        ix->blocks[b].size = ix->blocks[b].bytes;
+      }
+      b = editorTrigramBlockNew(ix);
+      if (b == -1) {
+        return -1;
+      }
+    }
+    erow *row = &E.buf->row[j];
+    row->block = b;
+    editorTrigramAdd(&ix->blocks[b], row->render, row->rsize);
+  }
+  if (b != -1) {
+    ix->blocks[b].size = ix->blocks[b].bytes;
+  }
+  return 0;
+}
+
+/***
+ * Turns the search index of the current buffer on or off, it is built from
+ * the rows when turned on
+ *
+ * @param on Whether the buffer is to have an index
+ */
+void editorTrigramEnable(int on) {
+  if (!on) {
+    editorTrigramFree(E.buf->trigrams);
+    E.buf->trigrams = NULL;
+    return;
+  }
+  if (E.buf->trigrams != NULL) {
+    return;
+  }
+  E.buf->trigrams = editorTrigramNew();
+  if (E.buf->trigrams != NULL && editorTrigramBuild(E.buf->trigrams) == -1) {
+    editorTrigramEnable(0);
+  }
+}
+
+/***
+ * Picks the block of a row about to be added to the current buffer
+ *
+ * A row takes the block of the row above it, so the numbers keep growing
+ * down the buffer. Rows appended at the end start a new block once the last
+ * one is full
+ *
+ * @param at Where the row goes, the rows above it are in place
+ * @param last Whether no rows follow it
+ * @return the block
+ */
+int editorTrigramPlace(int at, int last) {
+  struct editorTrigramIndex *ix = E.buf->trigrams;
+  if (ix == NULL) {
+    return 0;
+  }
+
+  if (ix->adopt != NULL) {
+    while (ix->adoptleft == 0 && ix->adoptnext + 1 < ix->adopt->numblocks) {
+      ix->adoptnext++;
+      ix->adoptleft = ix->adopt->rows[ix->adoptnext];
+    }
+    ix->adoptleft--;
+    return ix->adoptfirst + ix->adoptnext;
+  }
+
+  int b = at > 0 ? E.buf->row[at - 1].block : 0;
+  if (ix->numblocks == 0 ||
+      (last && ix->blocks[b].bytes >= KILO_TRIGRAM_BLOCK)) {
+    b = editorTrigramBlockNew(ix);
+    if (b == -1) {
+      // a row left out of the index would never be found
+      editorTrigramEnable(0);
+      return 0;
+    }
+  }
+  return b;
+}
+
+/***
+ * Adds the trigrams of a row that changed or came in to its block
+ *
+ * @param *row The row, with its render
+ */
+void editorTrigramRow(erow *row) {
+  struct editorTrigramIndex *ix = E.buf->trigrams;
+  if (ix == NULL || ix->adopt != NULL || row->block >= ix->numblocks) {
+    return;
+  }
+  editorTrigramAdd(&ix->blocks[row->block], row->render, row->rsize);
+}
+
+/***
+ * Builds the blocks of lines about to be appended, safe to run on any
+ * thread
+ *
+ * @param *data The lines, the last one may lack its newline
+ * @param len The length of the lines
+ * @return the blocks, NULL if out of memory
+ */
+struct editorTrigramBatch *editorTrigramBatchBuild(const char *data,
+                                                   size_t len) {
+  struct editorTrigramBatch *batch = calloc(1, sizeof(*batch));
+  int cap = len / KILO_TRIGRAM_BLOCK + 1;
+  if (batch == NULL) {
+    return NULL;
+  }
+  batch->rows = malloc(sizeof(int) * cap);
+  batch->blocks = malloc(sizeof(struct editorTrigramBlock) * cap);
+  if (batch->rows == NULL || batch->blocks == NULL) {
+    editorTrigramBatchFree(batch);
+    return NULL;
+  }
+
+  // a block closes after the line that fills it, so there are never more
+  // blocks than the text makes full ones plus one
+  struct editorTrigramBlock *blk = NULL;
+  const char *p = data;
+  const char *end = data + len;
+  while (p < end) {
+    if (blk == NULL || blk->bytes >= KILO_TRIGRAM_BLOCK) {
+      blk = &batch->blocks[batch->numblocks];
+      memset(blk, 0, sizeof(*blk));
+      batch->rows[batch->numblocks++] = 0;
+    }
+    const char *nl = memchr(p, '\n', end - p);
+    size_t linelen = nl ? (size_t)(nl - p) : (size_t)(end - p);
+    editorTrigramAdd(blk, p, linelen);
+    batch->rows[batch->numblocks - 1]++;
+    p = nl ? nl + 1 : end;
+  }
+  for (int j = 0; j < batch->numblocks; j++) {
+    batch->blocks[j].size = batch->blocks[j].bytes;
+  }
+  return batch;
+}
+
+/***
+ * Frees a batch
+ *
+ * @param *batch The batch, NULL does nothing
+ */
+void editorTrigramBatchFree(struct editorTrigramBatch *batch) {
+  if (batch == NULL) {
+    return;
+  }
+  free(batch->rows);
+  free(batch->blocks);
+  free(batch);
+}
+
+/***
+ * Adds the blocks of a batch to the index of the current buffer, the rows
+ * appended until editorTrigramAdoptDone are placed in them as they are
+ *
+ * @param *batch The blocks of the rows about to be appended
+ */
+void editorTrigramAdopt(struct editorTrigramBatch *batch) {
+  struct editorTrigramIndex *ix = E.buf->trigrams;
+  if (ix == NULL || batch->numblocks == 0) {
+    return;
+  }
+
+  int first = ix->numblocks;
+  for (int j = 0; j < batch->numblocks; j++) {
+    int b = editorTrigramBlockNew(ix);
+    if (b == -1) {
+      // the rows are indexed one by one instead
+      ix->numblocks = first;
+      return;
+    }
+    ix->blocks[b] = batch->blocks[j];
+  }
+
+  ix->adopt = batch;
+  ix->adoptfirst = first;
+  ix->adoptnext = 0;
+  ix->adoptleft = batch->rows[0];
+}
+
+/***
+ * Ends the placement of rows in the blocks of a batch
+ */
+void editorTrigramAdoptDone() {
+  struct editorTrigramIndex *ix = E.buf->trigrams;
+  if (ix != NULL) {
+    ix->adopt = NULL;
+  }
+}
+
+/***
+ * Finds the first row of the current buffer whose block is at least some
+ * block, the blocks of the rows only grow
+ *
+ * @param b The block
+ * @param lo The first row to look at
+ * @param hi The row past the last to look at
+ * @return the row, hi if there is none
+ */
+static int editorTrigramFirstRow(int b, int lo, int hi) {
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (E.buf->row[mid].block < b) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+/***
+ * Builds a block again from its rows, dropping the trigrams of text that
+ * is not there anymore
+ *
+ * @param *ix The index of the current buffer
+ * @param b The block
+ */
+static void editorTrigramRebuild(struct editorTrigramIndex *ix, int b) {
+  struct editorTrigramBlock *blk = &ix->blocks[b];
+  int from = editorTrigramFirstRow(b, 0, E.buf->numrows);
+  int to = editorTrigramFirstRow(b + 1, from, E.buf->numrows);
+
+  memset(blk, 0, sizeof(*blk));
+  for (int j = from; j < to; j++) {
+    editorTrigramAdd(blk, E.buf->row[j].render, E.buf->row[j].rsize);
+  }
+  blk->size = blk->bytes;
+  if (blk->size > TRIGRAM_OVERGROWN * KILO_TRIGRAM_BLOCK) {
+    ix->overgrown = 1;
+  }
+}
+
+/***
+ * Tells whether a block may hold every trigram of the query
+ *
+ * @param *ix The index of the current buffer
+ * @param b The block
+ * @param *bits The bits of the trigrams of the query
+ * @param n The number of trigrams
+ * @return 1 if it may, 0 if some trigram is surely not in it
+ */
+static int editorTrigramMayMatch(struct editorTrigramIndex *ix, int b,
+                                 const uint32_t *bits, int n) {
+  struct editorTrigramBlock *blk = &ix->blocks[b];
+  for (int pass = 0; pass < 2; pass++) {
+    int j = 0;
+    while (j < n && (blk->bits[bits[j] >> 6] >> (bits[j] & 63) & 1)) {
+      j++;
+    }
+    if (j < n) {
+      return 0;
+    }
+    // a block that took many edits is checked again once cleaned up
+    if (pass == 1 || blk->bytes <= 2 * blk->size + KILO_TRIGRAM_BLOCK) {
+      return 1;
+    }
+    editorTrigramRebuild(ix, b);
+  }
+  return 1;
+}
+
+/***
+ * Counts the rows from one on that the index rules out for a query
+ *
+ * @param *query The text searched in the renders
+ * @param at The first row to look at
+ * @param direction 1 to count rows down, -1 to count them up
+ * @return the number of rows, from at on, that can't contain the query
+ */
+int editorTrigramSkip(const char *query, int at, int direction) {
+  static char *last = NULL;
+  static uint32_t *bits = NULL;
+  static int n = 0;
+  static int maybe = -1;
+
+  struct editorTrigramIndex *ix = E.buf->trigrams;
+  if (ix != NULL && ix->overgrown && editorTrigramBuild(ix) == -1) {
+    editorTrigramEnable(0);
+    return 0;
+  }
+  if (ix == NULL || at < 0 || at >= E.buf->numrows ||
+      E.buf->row[at].block >= ix->numblocks) {
+    return 0;
+  }
+
+  // the bits of the query are worked out once per query
+  if (last == NULL || strcmp(last, query) != 0) {
+    size_t len = strlen(query);
+    free(last);
+    free(bits);
+    maybe = -1;
+    last = strdup(query);
+    bits = malloc(sizeof(uint32_t) * (len + 1));
+    n = 0;
+    if (last == NULL || bits == NULL) {
+      free(last);
+      last = NULL;
+      return 0;
+    }
+    uint32_t t = 0;
+    for (size_t j = 0; j < len; j++) {
+      t = ((t << 8) | (unsigned char)query[j]) & 0xffffff;
+      if (j >= 2) {
+        bits[n++] = (t * 0x9e3779b1u) >> (32 - TRIGRAM_SHIFT);
+      }
+    }
+  }
+  if (n == 0) {
+    return 0;
+  }
+
+  // the rows of a block that may match are all looked at, the block is only
+  // checked for the first of them
+  int b = E.buf->row[at].block;
+  if (b == maybe) {
+    return 0;
+  }
+  if (editorTrigramMayMatch(ix, b, bits, n)) {
+    maybe = b;
+    return 0;
+  }
+  maybe = -1;
+  int to = b;
+  while (to + direction >= 0 && to + direction < ix->numblocks &&
+         !editorTrigramMayMatch(ix, to + direction, bits, n)) {
+    to += direction;
+  }
+
+  if (direction > 0) {
+    return editorTrigramFirstRow(to + 1, at, E.buf->numrows) - at;
+  }
+  return at - editorTrigramFirstRow(to, 0, at) + 1;
+}
@@ -0,0 +1,20 @@
+#ifndef TRIGRAM_H_
+#define TRIGRAM_H_
+
+#include "typedefs.h"
+
+struct editorTrigramBatch;
+
+struct editorTrigramIndex *editorTrigramNew();
+void editorTrigramFree(struct editorTrigramIndex *ix);
+void editorTrigramEnable(int on);
+int editorTrigramPlace(int at, int last);
+void editorTrigramRow(erow *row);
+struct editorTrigramBatch *editorTrigramBatchBuild(const char *data,
+                                                   size_t len);
+void editorTrigramBatchFree(struct editorTrigramBatch *batch);
+void editorTrigramAdopt(struct editorTrigramBatch *batch);
+void editorTrigramAdoptDone();
+int editorTrigramSkip(const char *query, int at, int direction);
+
+#endif // !#ifndef TRIGRAM_H_
@@ -6,10 +6,12 @@
 #include <fcntl.h>
 #include <stdarg.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/stat.h>
 #include <termios.h>
 #include <time.h>
 #include <unistd.h>
@@ -23,12 +25,31 @@
   "HELP: (Ctrl-Q | q) = quit | (Ctrl-S | w) = save | (i) = Insert Mode | "     \
   "(Ctrl-F | /) = find"
 #define KILO_SIGN_COLUMN 5
+#define KILO_CACHE_LIMIT (64 * 1024 * 1024)
+#define KILO_LOAD_ASYNC (1024 * 1024) // files this big load in the background
+#define KILO_LOAD_CHUNK (1024 * 1024)
+#define KILO_LOAD_QUEUE 8 // chunks read ahead of the main thread
+#define KILO_LOAD_BATCH 4 // chunks appended per wake up
+#define KILO_COMPRESS_LEVEL 6
+#define KILO_JOURNAL_MS 200       // edits gathered into one journal write
+#define KILO_JOURNAL_SYNC_MS 1000 // longest time a journal write is unsynced
+#define KILO_DIFF_MAX_COST 10000 // edit distance past which diffs go coarse
+#define KILO_GUTTER_SPAN 256 // line numbers precomposed around the screen
+#define KILO_HL_LIMIT (256 * 1024) // bytes of highlight kept for drawn rows
+#define KILO_MACRO_DEPTH 16        // macros replayed from inside macros
+#define KILO_RESIZE_MS 50 // quiet time after a resize before laying out
+#define KILO_ROWCACHE_SAMPLE (64 * 1024) // bytes hashed at each end of a file
+#define KILO_ROWCACHE_BUDGET (256 * 1024 * 1024) // bytes of row caches kept
+#define KILO_ROWCACHE_AGE (30 * 24 * 60 * 60) // seconds one is kept unused
+#define KILO_TRIGRAM_BLOCK 4096 // bytes of text per block of the search index
 
 #define CTRL_KEY(k) ((k) & 0x1f)
 
+// special keys are numbered past the last Unicode codepoint so they never
+// collide with a decoded character
 enum editorKey {
   BACKSPACE = 127,
-  ARROW_LEFT = 1000,
+  ARROW_LEFT = 0x110000,
   ARROW_RIGHT,
   ARROW_UP,
   ARROW_DOWN,
@@ -36,10 +57,25 @@ enum editorKey {
   HOME_KEY,
   END_KEY,
   PAGE_UP,
-  PAGE_DOWN
+  PAGE_DOWN,
+  REFRESH_KEY // nothing was typed but a background event changed the screen
 };
 
-enum editorMode { NORMAL_MODE, INSERT_MODE, COMMAND_MODE };
+enum editorMode {
+  NORMAL_MODE,
+  INSERT_MODE,
+  COMMAND_MODE,
+  VISUAL_MODE,       // characters from the anchor to the cursor
+  VISUAL_LINE_MODE,  // whole rows
+  VISUAL_BLOCK_MODE, // the rectangle between the anchor and the cursor
+};
+
+enum editorRangeType { RANGE_CHARS, RANGE_LINES, RANGE_BLOCK };
+
+#define GUTTER_NUMBER (1 << 0)   // show line numbers
+#define GUTTER_RELATIVE (1 << 1) // count them from the cursor row
+
+enum editorCompression { COMPRESS_NONE = 0, COMPRESS_GZIP, COMPRESS_ZSTD };
 
 enum editorHighlight {
   HL_NORMAL = 0,
@@ -56,28 +92,177 @@ enum editorHighlight {
 #define HL_HIGHLIGHT_NUMBERS (1 << 0)
 #define HL_HIGHLIGHT_STRINGS (1 << 1)
 
+// character classes of a language
+#define CLASS_SEP (1 << 0)
+#define CLASS_DIGIT (1 << 1)
+#define CLASS_STOP (1 << 2)  // may start a comment or a string
+#define CLASS_IDENT (1 << 3) // letters, digits, _ and UTF-8 bytes
+#define CLASS_SPACE (1 << 4)
+#define CLASS_QUOTE (1 << 5) // opens a string, when the language has them
+#define CLASS_KEYWORD (1 << 6) // starts one of the language's keywords
+
 /*** data ***/
 
+struct erow;
+
+// languages are generated from syntax/*.syntax by tools/syntaxgen.c or
+// loaded at startup from the user's syntax directory
 struct editorSyntax {
   char *filetype;
   char **filematch;
-  char **keywords;
-  char *singleline_comment_start;
-  char *multiline_comment_start;
-  char *multiline_comment_end;
+  // highlights a row into hl, one byte per character of its render, returns
+  // whether it ends inside a multiline comment
+  int (*lex)(const struct editorSyntax *syntax, struct erow *row,
+             unsigned char *hl, int in_comment);
   int flags;
+  const void *compiled; // the language in the cache, for loaded ones
+};
+
+struct editorKeyword {
+  const char *word;
+  unsigned char len;
+  unsigned char hl;
+};
+
+// a run of characters with the same highlight, runs of HL_NORMAL are not kept
+// and longer runs are split
+struct editorSpan {
+  uint32_t start; // offset in the render
+  uint16_t len;
+  unsigned char hl;
 };
 
 typedef struct erow {
   int idx;
   int size;
   int rsize;
+  int rwidth;
+  int ascii;
+  int block; // of the search index the row is in
   char *chars;
   char *render;
-  unsigned char *hl;
-  int hl_open_comment;
+  struct editorSpan *hl; // highlight of the row, sorted by start
+  int nhl;               // number of spans, -1 until the row is drawn
+  int hl_start;        // lexer state the row starts in, -1 if unknown
+  int hl_open_comment; // lexer state the row ends in
+  uint64_t hash; // of chars, kept by editorUpdateRow
 } erow;
 
+// what was worked out from the text of a row, kept by the row cache so a
+// file opened again is not measured again. The width of the render is kept
+// in the bits of flags above ROW_INFO_WIDTH_SHIFT
+struct editorRowInfo {
+  uint64_t hash;
+  uint32_t size;
+  uint32_t flags;
+};
+
+#define ROW_INFO_ASCII (1 << 0)
+#define ROW_INFO_TABS (1 << 1)
+#define ROW_INFO_LEXED (1 << 2) // the lexer states below are known
+#define ROW_INFO_START (1 << 3) // starts inside a multiline comment
+#define ROW_INFO_END (1 << 4)   // ends inside one
+#define ROW_INFO_WIDTH_SHIFT 5
+
+// one change to a row, see editorRowEditMany
+struct editorRowEdit {
+  int at;  // offset in chars
+  int del; // bytes removed at at
+  const char *s;
+  int len; // bytes of s inserted in their place
+};
+
+// a part of the text, rows top to bottom inclusive. Characters go from start
+// in the top row to end in the bottom one, byte offsets with end exclusive,
+// blocks are the display columns start to end, end exclusive
+struct editorRange {
+  enum editorRangeType type;
+  int top, bottom;
+  int start, end;
+};
+
+// a place in the text, at is an offset in the chars of the row
+struct editorRowPos {
+  int row;
+  int at;
+};
+
+// a cursor besides the one of the window, cx counts the sign column like E.cx
+struct editorCursor {
+  int cx, cy;
+};
+
+struct editorLoader;
+struct editorFollow;
+struct editorJournal;
+struct editorDiffView;
+struct editorTrigramIndex;
+
+struct editorBuffer {
+  erow *row;
+  int numrows;
+  int rowcap;
+  int dirty;
+  char *filename;
+  struct editorSyntax *syntax;
+  int compression; // how the file is stored on disk
+  struct stat disk; // the file as it was last read or written, st_ino 0 if none
+  int wd;           // inotify watch on the file, -1 if none
+
+  // cursor and viewport saved while the buffer is not displayed
+  int cx, cy;
+  int rowoff;
+  int coloff;
+
+  struct editorLoader *loader; // set while the file is read in the background
+  struct editorFollow *follow; // set while appends to the file are streamed in
+  struct editorJournal *journal; // unsaved edits, kept on disk for recovery
+  struct editorDiffView *diff;   // set while changes are shown in the gutter
+  struct editorTrigramIndex *trigrams; // search index, NULL when turned off
+
+  int hlvalid; // rows whose lexer states are up to date
+  int hlcached; // rows whose lexer states the row cache has, -1 if no cache
+
+  // extra cursors edited along with the one of the window, sorted by row
+  // and column
+  struct editorCursor *cursors;
+  int numcursors;
+
+  // search match drawn over the highlight, match_row -1 if there is none
+  int match_row;
+  int match_start, match_len; // in the render of the row
+
+  int cold;         // renders were dropped to save memory
+  size_t cachebytes; // bytes held by the renders
+  unsigned long lastused;
+};
+
+struct editorWindow {
+  struct editorBuffer *buf;
+
+  // cursor and viewport saved while the window is not the active one
+  int cx, cy;
+  int rx;
+  int rowoff;
+  int coloff;
+
+  // position and size on the terminal, rows does not count the status line
+  int top, left;
+  int rows, cols;
+
+  // what the terminal currently shows, drawn_rowoff is -1 when the whole
+  // window must be repainted and damage flags the lines to repaint otherwise
+  int drawn_rowoff;
+  int drawn_coloff;
+  int drawn_cy; // the cursor row relative numbers were drawn for
+  unsigned char *damage;
+
+  // layout tree, a window with children is a split and is never displayed
+  int vertical;
+  struct editorWindow *parent;
+  struct editorWindow *child[2];
+};
+
 struct editorConfig {
   int cx, cy;
   int rx;
@@ -85,14 +270,24 @@ struct editorConfig {
   int coloff;
   int screenrows;
   int screencols;
-  int numrows;
-  int dirty;
+  int termrows;
+  int termcols;
   enum editorMode mode;
-  erow *row;
-  char *filename;
+  int vcx, vcy; // where the visual selection started, like cx and cy
+  int gutter; // GUTTER_ flags
+  struct editorWindow *win;
+  struct editorWindow *layout;
+  struct editorWindow **windows;
+  int numwindows;
+  struct editorBuffer *buf;
+  struct editorBuffer **buffers;
+  int numbuffers;
+  int curbuf;
+  unsigned long switches;
+  unsigned int frame; // bumped by every refresh, ages the highlight
+  size_t hlbytes;     // bytes held by the highlight of all buffers
   char statusmsg[80];
   time_t statusmsg_time;
-  struct editorSyntax *syntax;
   struct termios orig_termios;
 };
 
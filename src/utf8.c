@@ -0,0 +1,432 @@
+#include "utf8.h"
+#include <stdint.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+struct utf8Interval {
+  unsigned int first;
+  unsigned int last;
+};
+
+/*
+ * Codepoints that take no column of their own: combining marks, joiners,
+ * variation selectors and format characters
+ */
+static const struct utf8Interval zero_width[] = {
+    {0x0300, 0x036F},   {0x0483, 0x0489},   {0x0591, 0x05BD},
+    {0x05BF, 0x05BF},   {0x05C1, 0x05C2},   {0x05C4, 0x05C5},
+    {0x05C7, 0x05C7},   {0x0610, 0x061A},   {0x061C, 0x061C},
+    {0x064B, 0x065F},   {0x0670, 0x0670},   {0x06D6, 0x06DC},
+    {0x06DF, 0x06E4},   {0x06E7, 0x06E8},   {0x06EA, 0x06ED},
+    {0x0711, 0x0711},   {0x0730, 0x074A},   {0x07A6, 0x07B0},
+    {0x07EB, 0x07F3},   {0x0816, 0x0819},   {0x081B, 0x0823},
+    {0x0825, 0x0827},   {0x0829, 0x082D},   {0x0859, 0x085B},
+    {0x08D3, 0x08E1},   {0x08E3, 0x0902},   {0x093A, 0x093A},
+    {0x093C, 0x093C},   {0x0941, 0x0948},   {0x094D, 0x094D},
+    {0x0951, 0x0957},   {0x0962, 0x0963},   {0x0981, 0x0981},
+    {0x09BC, 0x09BC},   {0x09C1, 0x09C4},   {0x09CD, 0x09CD},
+    {0x09E2, 0x09E3},   {0x0A01, 0x0A02},   {0x0A3C, 0x0A3C},
+    {0x0A41, 0x0A42},   {0x0A47, 0x0A48},   {0x0A4B, 0x0A4D},
+    {0x0A70, 0x0A71},   {0x0A81, 0x0A82},   {0x0ABC, 0x0ABC},
+    {0x0AC1, 0x0AC5},   {0x0AC7, 0x0AC8},   {0x0ACD, 0x0ACD},
+    {0x0B01, 0x0B01},   {0x0B3C, 0x0B3C},   {0x0B3F, 0x0B3F},
+    {0x0B41, 0x0B44},   {0x0B4D, 0x0B4D},   {0x0B82, 0x0B82},
+    {0x0BC0, 0x0BC0},   {0x0BCD, 0x0BCD},   {0x0C3E, 0x0C40},
+    {0x0C46, 0x0C48},   {0x0C4A, 0x0C4D},   {0x0C55, 0x0C56},
+    {0x0CBC, 0x0CBC},   {0x0CCC, 0x0CCD},   {0x0D41, 0x0D44},
+    {0x0D4D, 0x0D4D},   {0x0DCA, 0x0DCA},   {0x0DD2, 0x0DD4},
+    {0x0DD6, 0x0DD6},   {0x0E31, 0x0E31},   {0x0E34, 0x0E3A},
+    {0x0E47, 0x0E4E},   {0x0EB1, 0x0EB1},   {0x0EB4, 0x0EBC},
+    {0x0EC8, 0x0ECD},   {0x0F18, 0x0F19},   {0x0F35, 0x0F35},
+    {0x0F37, 0x0F37},   {0x0F39, 0x0F39},   {0x0F71, 0x0F7E},
+    {0x0F80, 0x0F84},   {0x0F86, 0x0F87},   {0x0F8D, 0x0FBC},
+    {0x0FC6, 0x0FC6},   {0x102D, 0x1030},   {0x1032, 0x1037},
+    {0x1039, 0x103A},   {0x103D, 0x103E},   {0x1058, 0x1059},
+    {0x105E, 0x1060},   {0x1071, 0x1074},   {0x1082, 0x1082},
+    {0x1085, 0x1086},   {0x108D, 0x108D},   {0x109D, 0x109D},
+    {0x1160, 0x11FF},   {0x135D, 0x135F},   {0x1712, 0x1714},
+    {0x1732, 0x1734},   {0x1752, 0x1753},   {0x1772, 0x1773},
+    {0x17B4, 0x17B5},   {0x17B7, 0x17BD},   {0x17C6, 0x17C6},
+    {0x17C9, 0x17D3},   {0x17DD, 0x17DD},   {0x180B, 0x180E},
+    {0x18A9, 0x18A9},   {0x1920, 0x1922},   {0x1927, 0x1928},
+    {0x1932, 0x1932},   {0x1939, 0x193B},   {0x1A17, 0x1A18},
+    {0x1A1B, 0x1A1B},   {0x1A56, 0x1A56},   {0x1A58, 0x1A60},
+    {0x1AB0, 0x1AFF},   {0x1B00, 0x1B03},   {0x1B34, 0x1B34},
+    {0x1B36, 0x1B3A},   {0x1B3C, 0x1B3C},   {0x1B42, 0x1B42},
+    {0x1B6B, 0x1B73},   {0x1DC0, 0x1DFF},   {0x200B, 0x200F},
+    {0x202A, 0x202E},   {0x2060, 0x2064},   {0x20D0, 0x20F0},
+    {0x2CEF, 0x2CF1},   {0x2D7F, 0x2D7F},   {0x2DE0, 0x2DFF},
+    {0x302A, 0x302D},   {0x3099, 0x309A},   {0xA66F, 0xA672},
+    {0xA674, 0xA67D},   {0xA69E, 0xA69F},   {0xA6F0, 0xA6F1},
+    {0xA802, 0xA802},   {0xA806, 0xA806},   {0xA80B, 0xA80B},
+    {0xA825, 0xA826},   {0xA8C4, 0xA8C5},   {0xA8E0, 0xA8F1},
+    {0xFB1E, 0xFB1E},   {0xFE00, 0xFE0F},   {0xFE20, 0xFE2F},
+    {0xFEFF, 0xFEFF},   {0xFFF9, 0xFFFB},   {0x1D167, 0x1D169},
+    {0x1D173, 0x1D182}, {0x1D185, 0x1D18B}, {0x1D1AA, 0x1D1AD},
+    {0xE0001, 0xE0001}, {0xE0020, 0xE007F}, {0xE0100, 0xE01EF},
+};
+
+/*
+ * East Asian Wide and Fullwidth codepoints, plus the emoji that terminals
+ * draw in two columns
+ */
+static const struct utf8Interval wide[] = {
+    {0x1100, 0x115F},   {0x231A, 0x231B},   {0x2329, 0x232A},
+    {0x23E9, 0x23EC},   {0x23F0, 0x23F0},   {0x23F3, 0x23F3},
+    {0x25FD, 0x25FE},   {0x2614, 0x2615},   {0x2648, 0x2653},
+    {0x267F, 0x267F},   {0x2693, 0x2693},   {0x26A1, 0x26A1},
+    {0x26AA, 0x26AB},   {0x26BD, 0x26BE},   {0x26C4, 0x26C5},
+    {0x26CE, 0x26CE},   {0x26D4, 0x26D4},   {0x26EA, 0x26EA},
+    {0x26F2, 0x26F3},   {0x26F5, 0x26F5},   {0x26FA, 0x26FA},
+    {0x26FD, 0x26FD},   {0x2705, 0x2705},   {0x270A, 0x270B},
+    {0x2728, 0x2728},   {0x274C, 0x274C},   {0x274E, 0x274E},
+    {0x2753, 0x2755},   {0x2757, 0x2757},   {0x2795, 0x2797},
+    {0x27B0, 0x27B0},   {0x27BF, 0x27BF},   {0x2B1B, 0x2B1C},
+    {0x2B50, 0x2B50},   {0x2B55, 0x2B55},   {0x2E80, 0x303E},
+    {0x3041, 0x33FF},   {0x3400, 0x4DBF},   {0x4E00, 0x9FFF},
+    {0xA000, 0xA4CF},   {0xA960, 0xA97F},   {0xAC00, 0xD7A3},
+    {0xF900, 0xFAFF},   {0xFE10, 0xFE19},   {0xFE30, 0xFE6F},
+    {0xFF00, 0xFF60},   {0xFFE0, 0xFFE6},   {0x16FE0, 0x16FE4},
+    {0x17000, 0x18CFF}, {0x1B000, 0x1B2FF}, {0x1F004, 0x1F004},
+    {0x1F0CF, 0x1F0CF}, {0x1F18E, 0x1F18E}, {0x1F191, 0x1F19A},
+    {0x1F200, 0x1F202}, {0x1F210, 0x1F23B}, {0x1F240, 0x1F248},
+    {0x1F250, 0x1F251}, {0x1F260, 0x1F265}, {0x1F300, 0x1F320},
+    {0x1F32D, 0x1F335}, {0x1F337, 0x1F37C}, {0x1F37E, 0x1F393},
+    {0x1F3A0, 0x1F3CA}, {0x1F3CF, 0x1F3D3}, {0x1F3E0, 0x1F3F0},
+    {0x1F3F4, 0x1F3F4}, {0x1F3F8, 0x1F43E}, {0x1F440, 0x1F440},
+    {0x1F442, 0x1F4FC}, {0x1F4FF, 0x1F53D}, {0x1F54B, 0x1F54E},
+    {0x1F550, 0x1F567}, {0x1F57A, 0x1F57A}, {0x1F595, 0x1F596},
+    {0x1F5A4, 0x1F5A4}, {0x1F5FB, 0x1F64F}, {0x1F680, 0x1F6C5},
+    {0x1F6CC, 0x1F6CC}, {0x1F6D0, 0x1F6D2}, {0x1F6D5, 0x1F6D7},
+    {0x1F6EB, 0x1F6EC}, {0x1F6F4, 0x1F6FC}, {0x1F7E0, 0x1F7EB},
+    {0x1F90C, 0x1F93A}, {0x1F93C, 0x1F945}, {0x1F947, 0x1F9FF},
+    {0x1FA70, 0x1FAFF}, {0x20000, 0x2FFFD}, {0x30000, 0x3FFFD},
+};
+
+#define TABLE_LEN(t) ((int)(sizeof(t) / sizeof((t)[0])))
+
+/***
+ * Binary search of a codepoint in a sorted interval table
+ */
+static int utf8InTable(unsigned int cp, const struct utf8Interval *table,
+                       int n) {
+  if (cp < table[0].first || cp > table[n - 1].last) {
+    return 0;
+  }
+
+  int lo = 0;
+  int hi = n - 1;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    if (cp > table[mid].last) {
+      lo = mid + 1;
+    } else if (cp < table[mid].first) {
+      hi = mid - 1;
+    } else {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/***
+ * Checks if a codepoint attaches to the previous one in the same cluster
+ */
+static int utf8IsExtend(unsigned int cp) {
+  // emoji skin tone modifiers
+  if (cp >= 0x1F3FB && cp <= 0x1F3FF) {
+    return 1;
+  }
+  return utf8CharWidth(cp) == 0;
+}
+
+/***
+ * Validates a UTF-8 sequence and counts its codepoints
+ *
+ * Blocks of pure ASCII are skipped 16 bytes at a time (8 without SSE2), so
+ * plain text only pays for the scalar decoder when it meets a multibyte
+ * sequence
+ *
+ * @param *s The bytes to validate
+ * @param len The number of bytes
+ * @return the number of codepoints, or -1 if the sequence is not valid UTF-8
+ */
+int utf8Validate(const char *s, int len) {
+  int count = 0;
+  int i = 0;
+
+  while (i < len) {
+#if defined(__SSE2__)
+    if (i + 16 <= len) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+      if (_mm_movemask_epi8(v) == 0) {
+        count += 16;
+        i += 16;
+        continue;
+      }
+    }
+#else
+    if (i + 8 <= len) {
+      uint64_t v;
+      memcpy(&v, s + i, sizeof(v));
+      if ((v & 0x8080808080808080ULL) == 0) {
+        count += 8;
+        i += 8;
+        continue;
+      }
+    }
+#endif
+
+    // the block holds a multibyte sequence, walk it with the scalar decoder
+    int end = (i + 16 < len) ? i + 16 : len;
+    while (i < end) {
+      if ((unsigned char)s[i] < 0x80) {
+        i++;
+      } else {
+        unsigned int cp;
+        int n = utf8Decode(&s[i], len - i, &cp);
+        if (n == 1) {
+          return -1;
+        }
+        i += n;
+      }
+      count++;
+    }
+  }
+
+  return count;
+}
+
+/***
+ * Decodes the codepoint at the start of a byte sequence
+ *
+ * @param *s The bytes to decode
+ * @param len The number of bytes available
+ * @param *cp Where to store the codepoint, U+FFFD when the sequence is invalid
+ * @return the number of bytes consumed, 1 for an invalid byte
+ */
+int utf8Decode(const char *s, int len, unsigned int *cp) {
+  const unsigned char *u = (const unsigned char *)s;
+  unsigned char c = u[0];
+
+  if (c < 0x80) {
+    *cp = c;
+    return 1;
+  }
+
+  int n;
+  unsigned int min;
+  unsigned int v;
+  if (c >= 0xC2 && c <= 0xDF) {
+    n = 2;
+    min = 0x80;
+    v = c & 0x1F;
+  } else if (c >= 0xE0 && c <= 0xEF) {
+    n = 3;
+    min = 0x800;
+    v = c & 0x0F;
+  } else if (c >= 0xF0 && c <= 0xF4) {
+    n = 4;
+    min = 0x10000;
+    v = c & 0x07;
+  } else {
+    *cp = 0xFFFD;
+    return 1;
+  }
+
+  if (len < n) {
+    *cp = 0xFFFD;
+    return 1;
+  }
+
+  for (int j = 1; j < n; j++) {
+    if (!UTF8_IS_CONT(u[j])) {
+      *cp = 0xFFFD;
+      return 1;
+    }
+    v = (v << 6) | (u[j] & 0x3F);
+  }
+
+  // overlong forms, surrogates and values past the last codepoint
+  if (v < min || (v >= 0xD800 && v <= 0xDFFF) || v > 0x10FFFF) {
+    *cp = 0xFFFD;
+    return 1;
+  }
+
+  *cp = v;
+  return n;
+}
+
+/***
+ * Encodes a codepoint as UTF-8
+ *
+ * @param cp The codepoint
+ * @param *out A buffer of at least 4 bytes
+ * @return the number of bytes written
+ */
+int utf8Encode(unsigned int cp, char *out) {
+  if (cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+    cp = 0xFFFD;
+  }
+
+  if (cp < 0x80) {
+    out[0] = cp;
+    return 1;
+  }
+  if (cp < 0x800) {
+    out[0] = 0xC0 | (cp >> 6);
+    out[1] = 0x80 | (cp & 0x3F);
+    return 2;
+  }
+  if (cp < 0x10000) {
+    out[0] = 0xE0 | (cp >> 12);
+    out[1] = 0x80 | ((cp >> 6) & 0x3F);
+    out[2] = 0x80 | (cp & 0x3F);
+    return 3;
+  }
+  out[0] = 0xF0 | (cp >> 18);
+  out[1] = 0x80 | ((cp >> 12) & 0x3F);
+  out[2] = 0x80 | ((cp >> 6) & 0x3F);
+  out[3] = 0x80 | (cp & 0x3F);
+  return 4;
+}
+
+/***
+ * Number of terminal columns used by a codepoint
+ *
+ * @param cp The codepoint
+ * @return 0, 1 or 2
+ */
+int utf8CharWidth(unsigned int cp) {
+  if (cp < 0x300) {
+    return 1;
+  }
+  if (utf8InTable(cp, zero_width, TABLE_LEN(zero_width))) {
+    return 0;
+  }
+  if (utf8InTable(cp, wide, TABLE_LEN(wide))) {
+    return 2;
+  }
+  return 1;
+}
+
+/***
+ * Measures the grapheme cluster at the start of a byte sequence
+ *
+ * A cluster is a base codepoint followed by any combining marks, variation
+ * selectors or emoji modifiers, and anything glued on by a zero width joiner.
+ * An invalid byte is a cluster of its own, one column wide.
+ *
+ * @param *s The bytes to measure
+ * @param len The number of bytes available
+ * @param *width Where to store the cluster display width
+ * @return the number of bytes in the cluster
+ */
+int utf8ClusterLen(const char *s, int len, int *width) {
+  unsigned int cp;
+  int n = utf8Decode(s, len, &cp);
+  *width = (n == 1) ? 1 : utf8CharWidth(cp);
+
+  unsigned int prev = cp;
+  while (n < len && (unsigned char)s[n] >= 0x80) {
+    unsigned int next;
+    int m = utf8Decode(&s[n], len - n, &next);
+    if (m == 1 || !(prev == 0x200D || utf8IsExtend(next))) {
+      break;
+    }
+    n += m;
+    prev = next;
+  }
+
+  return n;
+}
+
+/***
+ * Finds the start of the codepoint containing a byte
+ *
+ * A valid sequence is at most 4 bytes, so only the 3 bytes before are looked
+ * at, a continuation byte that no lead covers is a codepoint of its own
+ *
+ * @param *s The bytes of the row
+ * @param len The number of bytes
+ * @param at The byte offset
+ * @return the offset of the first byte of the codepoint
+ */
+static int utf8CharStart(const char *s, int len, int at) {
+  int p = at;
+  while (p > 0 && at - p < 3 && UTF8_IS_CONT(s[p])) {
+    p--;
+  }
+
+  unsigned int cp;
+  if (!UTF8_IS_CONT(s[p]) && p + utf8Decode(&s[p], len - p, &cp) > at) {
+    return p;
+  }
+  return at;
+}
+
+/***
+ * Finds the start of the cluster containing a byte
+ *
+ * Walks back one codepoint at a time while it joins the one before, with the
+ * same rule as utf8ClusterLen, so the cost is the cluster and not the row
+ *
+ * @param *s The bytes of the row
+ * @param len The number of bytes
+ * @param at The byte offset
+ * @return the offset of the first byte of the cluster, or len when at is past
+ * the end
+ */
+int utf8ClusterStart(const char *s, int len, int at) {
+  if (at >= len) {
+    return len;
+  }
+  if (at <= 0) {
+    return 0;
+  }
+
+  int i = utf8CharStart(s, len, at);
+  while (i > 0 && (unsigned char)s[i] >= 0x80) {
+    unsigned int cp;
+    unsigned int prev;
+    if (utf8Decode(&s[i], len - i, &cp) == 1) {
+      break;
+    }
+    int j = utf8CharStart(s, len, i - 1);
+    utf8Decode(&s[j], len - j, &prev);
+    if (!(prev == 0x200D || utf8IsExtend(cp))) {
+      break;
+    }
+    i = j;
+  }
+  return i;
+}
+
+/***
+ * Display width of a byte sequence with no tabs
+ *
+ * @param *s The bytes to measure
+ * @param len The number of bytes
+ * @return the number of terminal columns
+ */
+int utf8StringWidth(const char *s, int len) {
+  int width = 0;
+  int i = 0;
+
+  while (i < len) {
+    if ((unsigned char)s[i] < 0x80 &&
+        (i + 1 == len || (unsigned char)s[i + 1] < 0x80)) {
+      width++;
+      i++;
+      continue;
+    }
+
+    int w;
+    i += utf8ClusterLen(&s[i], len - i, &w);
+    width += w;
+  }
+
+  return width;
+}
@@ -0,0 +1,16 @@
+#ifndef UTF8_H_
+#define UTF8_H_
+
+#include "typedefs.h"
+
+#define UTF8_IS_CONT(c) (((unsigned char)(c) & 0xC0) == 0x80)
+
+int utf8Validate(const char *s, int len);
+int utf8Decode(const char *s, int len, unsigned int *cp);
+int utf8Encode(unsigned int cp, char *out);
+int utf8CharWidth(unsigned int cp);
+int utf8ClusterLen(const char *s, int len, int *width);
+int utf8ClusterStart(const char *s, int len, int at);
+int utf8StringWidth(const char *s, int len);
+
+#endif // !#ifndef UTF8_H_
@@ -0,0 +1,165 @@
+#include "watch.h"
+#include "event.h"
+#include "file.h"
+#include "input.h"
+#include <libgen.h>
+#include <sys/inotify.h>
+
+// writers that keep the file open are left to :follow, the rest are seen
+// once they close the file or move another one over it
+#define KILO_WATCH_EVENTS                                                      \
+  (IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF)
+
+// a file missing for a moment, moved away before the new one is written,
+// is waited for in its directory
+#define KILO_WATCH_DIR_EVENTS (IN_CREATE | IN_MOVED_TO)
+
+static int inotifyfd = -1;
+
+/***
+ * Checks whether an event of a directory is about a buffer's file
+ *
+ * @param *ev The event, naming a file of the directory
+ * @param *buf The buffer
+ * @return 1 if the event names the file
+ */
+static int editorWatchNames(const struct inotify_event *ev,
+                            const struct editorBuffer *buf) {
+  char *copy = strdup(buf->filename);
+  int same = copy && strcmp(ev->name, basename(copy)) == 0;
+  free(copy);
+  return same;
+}
+
+/***
+ * Reacts to a buffer's file changing on disk
+ *
+ * A buffer without unsaved changes is reloaded, otherwise the user is
+ * warned and :e! or :w decide which version wins
+ *
+ * @param *buf The buffer
+ */
+static void editorWatchCheck(struct editorBuffer *buf) {
+  if (buf->loader != NULL || buf->follow != NULL || !editorFileChanged(buf)) {
+    return;
+  }
+
+  if (buf->dirty) {
+    editorSetStatusMessage("WARNING! '%s' changed on disk! :e! to reload or "
+                           ":w to overwrite",
+                           buf->filename);
+    return;
+  }
+
+  struct editorBuffer *saved = E.buf;
+  E.buf = buf;
+  int changed = editorReload();
+  E.buf = saved;
+
+  if (E.buf == buf && E.cy > buf->numrows) {
+    E.cy = buf->numrows;
+  }
+
+  if (changed >= 0) {
+    editorSetStatusMessage("\"%s\" changed on disk, %d lines reloaded",
+                           buf->filename, changed);
+  }
+}
+
+/***
+ * Reads the pending inotify events and checks the buffers they are about
+ *
+ * @param fd The inotify descriptor
+ * @param *arg Unused
+ */
+static void editorWatchRead(int fd, void *arg) {
+  (void)arg;
+  char events[4096]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+
+  ssize_t n;
+  while ((n = read(fd, events, sizeof(events))) > 0) {
+    for (char *p = events; p < events + n;) {
+      struct inotify_event *ev = (struct inotify_event *)p;
+      p += sizeof(struct inotify_event) + ev->len;
+
+      for (int j = 0; j < E.numbuffers; j++) {
+        struct editorBuffer *buf = E.buffers[j];
+        if (buf->wd != ev->wd) {
+          continue;
+        }
+
+        if (ev->len > 0) {
+          // the directory waited in, the file is back once it has its name
+          if (!editorWatchNames(ev, buf)) {
+            continue;
+          }
+          editorWatchRemove(buf);
+          editorWatchAdd(buf);
+        } else if (ev->mask & IN_IGNORED) {
+          // the file was replaced or removed, watch whatever has its name
+          buf->wd = -1;
+          editorWatchAdd(buf);
+        } else if (ev->mask & (IN_MOVE_SELF | IN_DELETE_SELF)) {
+          // the watch follows the file moved away or still open somewhere,
+          // it goes back on the name
+          editorWatchRemove(buf);
+          editorWatchAdd(buf);
+        }
+        editorWatchCheck(buf);
+      }
+    }
+  }
+}
+
+/***
+ * Starts watching a buffer's file for changes made by other programs
+ *
+ * @param *buf The buffer
+ */
+void editorWatchAdd(struct editorBuffer *buf) {
+  if (buf->filename == NULL || buf->wd != -1) {
+    return;
+  }
+
+  if (inotifyfd == -1) {
+    inotifyfd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyfd == -1) {
+      return;
+    }
+    editorEventAdd(inotifyfd, editorWatchRead, NULL);
+  }
+
+  buf->wd = inotify_add_watch(inotifyfd, buf->filename, KILO_WATCH_EVENTS);
+  if (buf->wd == -1 && errno == ENOENT) {
+    char *copy = strdup(buf->filename);
+    if (copy != NULL) {
+      buf->wd = inotify_add_watch(inotifyfd, dirname(copy),
+                                  KILO_WATCH_DIR_EVENTS);
+      free(copy);
+    }
+  }
+}
+
+/***
+ * Stops watching a buffer's file
+ *
+ * @param *buf The buffer
+ */
+void editorWatchRemove(struct editorBuffer *buf) {
+  if (buf->wd == -1) {
+    return;
+  }
+
+  // a file open under two names gets the same watch in both buffers
+  int shared = 0;
+  for (int j = 0; j < E.numbuffers; j++) {
+    if (E.buffers[j] != buf && E.buffers[j]->wd == buf->wd) {
+      shared = 1;
+    }
+  }
+  if (!shared) {
+    inotify_rm_watch(inotifyfd, buf->wd);
+  }
+  buf->wd = -1;
+}
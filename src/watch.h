@@ -0,0 +1,9 @@
+#ifndef WATCH_H_
+#define WATCH_H_
+
+#include "typedefs.h"
+
+void editorWatchAdd(struct editorBuffer *buf);
+void editorWatchRemove(struct editorBuffer *buf);
+
+#endif // !#ifndef WATCH_H_
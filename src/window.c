@@ -0,0 +1,409 @@
+#include "window.h"
+#include "terminal.h"
+#include <limits.h>
+
+/***
+ * Allocates a window showing a buffer
+ *
+ * @param *buf The buffer to show, NULL for a split node
+ * @return the new window
+ */
+static struct editorWindow *editorWindowNew(struct editorBuffer *buf) {
+  struct editorWindow *win = malloc(sizeof(struct editorWindow));
+  if (win == NULL) {
+    return NULL;
+  }
+
+  win->buf = buf;
+  win->cx = KILO_SIGN_COLUMN;
+  win->cy = 0;
+  win->rx = 0;
+  win->rowoff = 0;
+  win->coloff = 0;
+  win->top = 0;
+  win->left = 0;
+  win->rows = 0;
+  win->cols = 0;
+  win->drawn_rowoff = -1;
+  win->drawn_coloff = 0;
+  win->drawn_cy = -1;
+  win->damage = NULL;
+  win->vertical = 0;
+  win->parent = NULL;
+  win->child[0] = NULL;
+  win->child[1] = NULL;
+
+  return win;
+}
+
+/***
+ * Points E.curbuf at the buffer shown in the active window
+ */
+static void editorWindowSyncBuffer() {
+  for (int j = 0; j < E.numbuffers; j++) {
+    if (E.buffers[j] == E.buf) {
+      E.curbuf = j;
+      break;
+    }
+  }
+  E.buf->lastused = ++E.switches;
+}
+
+/***
+ * Creates the first window, showing the current buffer full screen
+ */
+void editorWindowInit() {
+  E.layout = editorWindowNew(E.buf);
+  if (E.layout == NULL) {
+    die("editorWindowInit: malloc");
+  }
+  E.win = E.layout;
+  E.windows = NULL;
+  E.numwindows = 0;
+
+  editorWindowSave(E.win);
+  editorWindowLayout();
+}
+
+/***
+ * Assigns a rectangle of the terminal to a layout node and its children
+ *
+ * @param *win The layout node
+ * @param top The first terminal row
+ * @param left The first terminal column
+ * @param height The number of rows, status line included
+ * @param width The number of columns
+ */
+static void editorWindowPlace(struct editorWindow *win, int top, int left,
+                              int height, int width) {
+  if (win->child[0] == NULL) {
+    win->top = top;
+    win->left = left;
+    win->rows = (height > 1) ? height - 1 : 0;
+    win->cols = (width > 0) ? width : 0;
+    win->damage = realloc(win->damage, win->rows + 1);
+    win->drawn_rowoff = -1;
+
+    E.windows[E.numwindows++] = win;
+    return;
+  }
+
+  if (win->vertical) {
+    // one column is kept for the separator
+    int lwidth = (width - 1) / 2;
+    editorWindowPlace(win->child[0], top, left, height, lwidth);
+    editorWindowPlace(win->child[1], top, left + lwidth + 1, height,
+                      width - lwidth - 1);
+  } else {
+    int theight = height / 2;
+    editorWindowPlace(win->child[0], top, left, theight, width);
+    editorWindowPlace(win->child[1], top + theight, left, height - theight,
+                      width);
+  }
+}
+
+/***
+ * Counts the displayed windows of a layout node
+ */
+static int editorWindowCount(struct editorWindow *win) {
+  if (win->child[0] == NULL) {
+    return 1;
+  }
+  return editorWindowCount(win->child[0]) + editorWindowCount(win->child[1]);
+}
+
+/***
+ * Lays out every window on the terminal and schedules a full repaint
+ */
+void editorWindowLayout() {
+  editorWindowSave(E.win);
+
+  E.windows = realloc(E.windows, sizeof(struct editorWindow *) *
+                                     editorWindowCount(E.layout));
+  E.numwindows = 0;
+
+  // the last terminal row is the message bar
+  editorWindowPlace(E.layout, 0, 0, E.termrows - 1, E.termcols);
+
+  editorWindowLoad(E.win);
+}
+
+/***
+ * Stores the editor cursor and viewport into a window
+ *
+ * @param *win The window to save into
+ */
+void editorWindowSave(struct editorWindow *win) {
+  win->buf = E.buf;
+  win->cx = E.cx;
+  win->cy = E.cy;
+  win->rx = E.rx;
+  win->rowoff = E.rowoff;
+  win->coloff = E.coloff;
+}
+
+/***
+ * Makes the cursor, viewport and buffer of a window the editor's
+ *
+ * @param *win The window to load
+ */
+void editorWindowLoad(struct editorWindow *win) {
+  E.buf = win->buf;
+  E.cx = win->cx;
+  E.cy = win->cy;
+  E.rx = win->rx;
+  E.rowoff = win->rowoff;
+  E.coloff = win->coloff;
+  E.screenrows = win->rows;
+  E.screencols = win->cols;
+
+  // the buffer may have been shortened from another window
+  if (E.cy > E.buf->numrows) {
+    E.cy = E.buf->numrows;
+  }
+  int size = (E.cy < E.buf->numrows) ? E.buf->row[E.cy].size : 0;
+  if (E.cx > size + KILO_SIGN_COLUMN) {
+    E.cx = size + KILO_SIGN_COLUMN;
+  }
+}
+
+/***
+ * Makes a window the active one
+ *
+ * @param *win The window to activate
+ */
+void editorWindowFocus(struct editorWindow *win) {
+  if (win == NULL || win == E.win) {
+    return;
+  }
+
+  editorWindowSave(E.win);
+  E.win = win;
+  editorWindowLoad(win);
+  editorWindowSyncBuffer();
+}
+
+/***
+ * Replaces a node of the layout tree with another one
+ */
+static void editorWindowReplaceNode(struct editorWindow *old,
+                                    struct editorWindow *node) {
+  struct editorWindow *parent = old->parent;
+  node->parent = parent;
+
+  if (parent == NULL) {
+    E.layout = node;
+  } else if (parent->child[0] == old) {
+    parent->child[0] = node;
+  } else {
+    parent->child[1] = node;
+  }
+}
+
+/***
+ * Splits the active window in two views of the same buffer
+ *
+ * @param vertical Whether the new window goes to the left instead of above
+ * @return 0 on success, -1 if there is no room for another window
+ */
+int editorWindowSplit(int vertical) {
+  struct editorWindow *win = E.win;
+  if (vertical ? (win->cols - 1) / 2 <= KILO_SIGN_COLUMN
+               : (win->rows + 1) / 2 < 2) {
+    return -1;
+  }
+
+  struct editorWindow *node = editorWindowNew(NULL);
+  struct editorWindow *view = editorWindowNew(E.buf);
+  if (node == NULL || view == NULL) {
+    free(node);
+    free(view);
+    return -1;
+  }
+
+  editorWindowSave(win);
+  view->cx = win->cx;
+  view->cy = win->cy;
+  view->rx = win->rx;
+  view->rowoff = win->rowoff;
+  view->coloff = win->coloff;
+
+  node->vertical = vertical;
+  editorWindowReplaceNode(win, node);
+  node->child[0] = view;
+  node->child[1] = win;
+  view->parent = node;
+  win->parent = node;
+
+  E.win = view;
+  editorWindowLayout();
+  return 0;
+}
+
+/***
+ * Closes the active window, its sibling takes the freed space
+ *
+ * @return 0 on success, -1 if it is the last window
+ */
+int editorWindowClose() {
+  struct editorWindow *win = E.win;
+  struct editorWindow *parent = win->parent;
+  if (parent == NULL) {
+    return -1;
+  }
+
+  struct editorWindow *sibling =
+      (parent->child[0] == win) ? parent->child[1] : parent->child[0];
+  editorWindowReplaceNode(parent, sibling);
+
+  free(win->damage);
+  free(win);
+  free(parent);
+
+  struct editorWindow *next = sibling;
+  while (next->child[0] != NULL) {
+    next = next->child[0];
+  }
+
+  E.win = next;
+  editorWindowLoad(next);
+  editorWindowSyncBuffer();
+  editorWindowLayout();
+  return 0;
+}
+
+/***
+ * Activates the next window on the screen
+ */
+void editorWindowNext() {
+  for (int j = 0; j < E.numwindows; j++) {
+    if (E.windows[j] == E.win) {
+      editorWindowFocus(E.windows[(j + 1) % E.numwindows]);
+      return;
+    }
+  }
+}
+
+/***
+ * Activates the previous window on the screen
+ */
+void editorWindowPrev() {
+  for (int j = 0; j < E.numwindows; j++) {
+    if (E.windows[j] == E.win) {
+      editorWindowFocus(E.windows[(j + E.numwindows - 1) % E.numwindows]);
+      return;
+    }
+  }
+}
+
+/***
+ * Activates the window next to the active one
+ *
+ * @param key One of h, j, k, l for left, down, up and right
+ */
+void editorWindowMove(int key) {
+  struct editorWindow *win = E.win;
+  int row = win->top + (E.cy - E.rowoff);
+  int col = win->left + (E.rx - E.coloff);
+
+  switch (key) {
+  case 'h':
+    col = win->left - 2;
+    break;
+  case 'l':
+    col = win->left + win->cols + 1;
+    break;
+  case 'k':
+    row = win->top - 1;
+    break;
+  case 'j':
+    row = win->top + win->rows + 1;
+    break;
+  default:
+    return;
+  }
+
+  for (int j = 0; j < E.numwindows; j++) {
+    struct editorWindow *w = E.windows[j];
+    if (row >= w->top && row <= w->top + w->rows && col >= w->left &&
+        col < w->left + w->cols) {
+      editorWindowFocus(w);
+      return;
+    }
+  }
+}
+
+/***
+ * Marks rows of a buffer as changed in every window that shows them
+ *
+ * @param *buf The buffer that changed
+ * @param from The first changed row
+ * @param to The last changed row, INT_MAX for everything below from
+ */
+void editorWindowDamage(struct editorBuffer *buf, int from, int to) {
+  for (int j = 0; j < E.numwindows; j++) {
+    struct editorWindow *win = E.windows[j];
+    if (win->buf != buf || win->drawn_rowoff < 0) {
+      continue;
+    }
+
+    int first = from - win->drawn_rowoff;
+    int last = (to == INT_MAX) ? win->rows - 1 : to - win->drawn_rowoff;
+    if (first < 0) {
+      first = 0;
+    }
+    if (last >= win->rows) {
+      last = win->rows - 1;
+    }
+    if (first <= last) {
+      memset(&win->damage[first], 1, last - first + 1);
+    }
+  }
+}
+
+/***
+ * Schedules a full repaint of every window
+ */
+void editorWindowDamageAll() {
+  for (int j = 0; j < E.numwindows; j++) {
+    E.windows[j]->drawn_rowoff = -1;
+  }
+}
+
+/***
+ * Points every window showing a buffer at another one
+ *
+ * @param *old The buffer going away
+ * @param *buf The buffer to show instead
+ */
+void editorWindowReplaceBuffer(struct editorBuffer *old,
+                               struct editorBuffer *buf) {
+  for (int j = 0; j < E.numwindows; j++) {
+    struct editorWindow *win = E.windows[j];
+    if (win->buf != old) {
+      continue;
+    }
+
+    win->buf = buf;
+    win->cx = buf->cx;
+    win->cy = buf->cy;
+    win->rowoff = buf->rowoff;
+    win->coloff = buf->coloff;
+    win->drawn_rowoff = -1;
+  }
+}
+
+/***
+ * Checks whether a buffer is displayed
+ *
+ * @param *buf The buffer
+ * @return 1 if some window shows the buffer
+ */
+int editorWindowShows(struct editorBuffer *buf) {
+  for (int j = 0; j < E.numwindows; j++) {
+    if (E.windows[j]->buf == buf) {
+      return 1;
+    }
+  }
+  return 0;
+}
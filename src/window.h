@@ -0,0 +1,22 @@
+#ifndef WINDOW_H_
+#define WINDOW_H_
+
+#include "typedefs.h"
+
+void editorWindowInit();
+void editorWindowLayout();
+void editorWindowSave(struct editorWindow *win);
+void editorWindowLoad(struct editorWindow *win);
+void editorWindowFocus(struct editorWindow *win);
+int editorWindowSplit(int vertical);
+int editorWindowClose();
+void editorWindowNext();
+void editorWindowPrev();
+void editorWindowMove(int key);
+void editorWindowDamage(struct editorBuffer *buf, int from, int to);
+void editorWindowDamageAll();
+void editorWindowReplaceBuffer(struct editorBuffer *old,
+                               struct editorBuffer *buf);
+int editorWindowShows(struct editorBuffer *buf);
+
+#endif // !#ifndef WINDOW_H_
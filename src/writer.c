@@ -0,0 +1,137 @@
+#include "writer.h"
+#include <fcntl.h>
+#include <poll.h>
+
+// what the terminal has not taken yet, from off to len
+static char *queue = NULL;
+static size_t qoff = 0;
+static size_t qlen = 0;
+static size_t qcap = 0;
+
+// a frame was skipped while the terminal was behind
+static int stale = 0;
+
+/***
+ * Writes as much of the queue as the terminal takes without blocking
+ *
+ * stdout is only non-blocking for the write, it usually shares its flags
+ * with stdin whose reads rely on the raw mode timeout
+ *
+ * @return 1 when the queue is empty, 0 otherwise
+ */
+static int editorWriterFlush() {
+  if (qoff == qlen) {
+    qoff = qlen = 0;
+    return 1;
+  }
+
+  int flags = fcntl(STDOUT_FILENO, F_GETFL);
+  if (flags != -1 && !(flags & O_NONBLOCK)) {
+    fcntl(STDOUT_FILENO, F_SETFL, flags | O_NONBLOCK);
+  }
+
+  while (qoff < qlen) {
+    ssize_t n = write(STDOUT_FILENO, &queue[qoff], qlen - qoff);
+    if (n > 0) {
+      qoff += n;
+    } else if (n == -1 && errno == EINTR) {
+      continue;
+    } else {
+      // a terminal that is gone never takes the rest
+      if (n == 0 || errno != EAGAIN) {
+        qoff = qlen;
+      }
+      break;
+    }
+  }
+
+  if (flags != -1 && !(flags & O_NONBLOCK)) {
+    fcntl(STDOUT_FILENO, F_SETFL, flags);
+  }
+
+  if (qoff == qlen) {
+    qoff = qlen = 0;
+    return 1;
+  }
+  return 0;
+}
+
+/***
+ * Tells whether a new frame can be sent, the terminal still busy with the
+ * last one skips it and it is drawn once the terminal catches up
+ *
+ * @return 1 when the terminal took everything sent so far, 0 otherwise
+ */
+int editorWriterReady() {
+  if (editorWriterFlush()) {
+    stale = 0;
+    return 1;
+  }
+  stale = 1;
+  return 0;
+}
+
+/***
+ * Sends bytes to the terminal, what it doesn't take at once is kept and
+ * sent when it is writable again
+ *
+ * @param *s The bytes
+ * @param len The number of bytes
+ */
+void editorWriterQueue(const char *s, size_t len) {
+  if (qoff > 0) {
+    memmove(queue, &queue[qoff], qlen - qoff);
+    qlen -= qoff;
+    qoff = 0;
+  }
+  if (qlen + len > qcap) {
+    size_t cap = qcap ? qcap : 4096;
+    while (cap < qlen + len) {
+      cap *= 2;
+    }
+    char *new = realloc(queue, cap);
+    if (new == NULL) {
+      return;
+    }
+    queue = new;
+    qcap = cap;
+  }
+
+  memcpy(&queue[qlen], s, len);
+  qlen += len;
+  editorWriterFlush();
+}
+
+/***
+ * Tells whether bytes are waiting for the terminal
+ *
+ * @return 1 if some are, 0 otherwise
+ */
+int editorWriterPending() { return qoff < qlen; }
+
+/***
+ * Sends more of the queue once the terminal is writable
+ *
+ * @return 1 if the queue emptied after a frame was skipped, so the screen
+ * is to be drawn again, 0 otherwise
+ */
+int editorWriterWritable() {
+  if (!editorWriterFlush() || !stale) {
+    return 0;
+  }
+  stale = 0;
+  return 1;
+}
+
+/***
+ * Waits until the terminal has taken everything queued
+ */
+void editorWriterDrain() {
+  while (!editorWriterFlush()) {
+    struct pollfd pfd = {STDOUT_FILENO, POLLOUT, 0};
+    if (poll(&pfd, 1, -1) == -1 && errno != EINTR) {
+      return;
+    }
+  }
+  stale = 0;
+}
@@ -0,0 +1,12 @@
+#ifndef WRITER_H_
+#define WRITER_H_
+
+#include "typedefs.h"
+
+int editorWriterReady();
+void editorWriterQueue(const char *s, size_t len);
+int editorWriterPending();
+int editorWriterWritable();
+void editorWriterDrain();
+
+#endif // !#ifndef WRITER_H_
@@ -0,0 +1,377 @@
+/***
+ * Turns the language definitions of the syntax/ directory into static
+ * highlighting tables and one lexer per language
+ *
+ * usage: syntaxgen <output.h> <definition.syntax>...
+ *
+ * Definitions are parsed by src/syntaxdef.c, the format is described there.
+ * The generated header is included by src/syntax.c, which provides
+ * editorSyntaxKeyword and the scanners of src/scan.h for the lexers
+ */
+#include "syntaxdef.h"
+
+/***
+ * Prints an error and exits
+ *
+ * @param *fmt A printf format
+ */
+static void genDie(const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  fputs("syntaxgen: ", stderr);
+  vfprintf(stderr, fmt, ap);
+  fputc('\n', stderr);
+  va_end(ap);
+  exit(1);
+}
+
+/***
+ * Reads and parses a language definition, exiting on error
+ *
+ * @param *path The .syntax file
+ * @param *def The definition to fill
+ */
+static void genParse(const char *path, struct editorSyntaxDef *def) {
+  FILE *fp = fopen(path, "r");
+  if (fp == NULL) {
+    genDie("%s: can't open", path);
+  }
+
+  char *text = NULL;
+  size_t len = 0, cap = 0, n;
+  do {
+    if (len == cap) {
+      cap = cap ? cap * 2 : 4096;
+      if ((text = realloc(text, cap)) == NULL) {
+        genDie("out of memory");
+      }
+    }
+    n = fread(&text[len], 1, cap - len, fp);
+    len += n;
+  } while (n > 0);
+  if (ferror(fp)) {
+    genDie("%s: read failed", path);
+  }
+  fclose(fp);
+
+  char err[256];
+  const char *base = strrchr(path, '/');
+  if (editorSyntaxDefParse(def, base ? base + 1 : path, text, len, err,
+                           sizeof(err)) == -1) {
+    genDie("%s", err);
+  }
+  free(text);
+}
+
+/***
+ * Writes a character as a C character constant
+ */
+static void genChar(FILE *out, int c) {
+  if (c == '\'' || c == '\\') {
+    fprintf(out, "'\\%c'", c);
+  } else if (isprint(c)) {
+    fprintf(out, "'%c'", c);
+  } else {
+    fprintf(out, "%d", c);
+  }
+}
+
+/***
+ * Writes a string as a C string literal
+ */
+static void genString(FILE *out, const char *s) {
+  fputc('"', out);
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\') {
+      fputc('\\', out);
+    }
+    fputc(*s, out);
+  }
+  fputc('"', out);
+}
+
+/***
+ * Writes the condition matching a delimiter at s[i]
+ *
+ * The render is NUL terminated, so the comparisons stop at the end of the
+ * row without a bounds check
+ *
+ * @param *out The generated header
+ * @param *delim The delimiter
+ */
+static void genMatch(FILE *out, const char *delim) {
+  for (int j = 0; delim[j]; j++) {
+    fprintf(out, "%ss[i%s", j ? " && " : "", j ? "" : "] == ");
+    if (j) {
+      fprintf(out, " + %d] == ", j);
+    }
+    genChar(out, (unsigned char)delim[j]);
+  }
+}
+
+/***
+ * Writes the keyword hash table of a language and the function looking
+ * words up in it
+ *
+ * @param *out The generated header
+ * @param *def The language
+ */
+static void genKeywords(FILE *out, struct editorSyntaxDef *def) {
+  const char *name = def->filetype;
+
+  fprintf(out, "static const struct editorKeyword syntax_%s_keywords[%d] = {\n",
+          name, def->tablesize);
+  for (int j = 0; j < def->tablesize; j++) {
+    int w = def->table[j];
+    if (w != -1) {
+      fprintf(out, "    [%d] = {", j);
+      genString(out, def->words[w]);
+      fprintf(out, ", %d, HL_KEYWORD%d},\n", (int)strlen(def->words[w]),
+              def->hl[w] - HL_KEYWORD1 + 1);
+    }
+  }
+  fprintf(out, "};\n\n");
+
+  fprintf(out, "static int syntax_%s_keyword(const char *s, int len) {\n",
+          name);
+  if (def->maxlen == 0) {
+    fprintf(out, "  (void)s;\n  (void)len;\n  return HL_NORMAL;\n}\n\n");
+  } else {
+    fprintf(out, "  if (len < %d || len > %d) {\n    return HL_NORMAL;\n  }\n",
+            def->minlen, def->maxlen);
+    fprintf(out, "  return editorSyntaxKeyword(syntax_%s_keywords, %d, s, "
+                 "len);\n}\n\n",
+            name, def->tablesize - 1);
+  }
+}
+
+/***
+ * Writes the character class table of a language
+ *
+ * @param *out The generated header
+ * @param *def The language
+ */
+static void genClassTable(FILE *out, struct editorSyntaxDef *def) {
+  fprintf(out, "static const unsigned char syntax_%s_class[256] = {",
+          def->filetype);
+  for (int c = 0; c < 256; c++) {
+    fprintf(out, "%s%d,", (c % 16) ? " " : "\n    ", def->class[c]);
+  }
+  fprintf(out, "\n};\n\n");
+}
+
+/***
+ * Writes the lexer of a language
+ *
+ * The rules are the ones of the original interpreter with the delimiters and
+ * flags of the language folded in, runs of spaces, words and the insides of
+ * strings and comments are skipped by the scanners of src/scan.h
+ *
+ * @param *out The generated header
+ * @param *def The language
+ */
+static void genLexer(FILE *out, struct editorSyntaxDef *def) {
+  const char *name = def->filetype;
+
+  fprintf(out,
+          "static int syntax_%s_lex(const struct editorSyntax *syntax, "
+          "erow *row,\n"
+          "                         unsigned char *hl, int in_comment) {\n"
+          "  (void)syntax;\n"
+          "  const unsigned char *class = syntax_%s_class;\n"
+          "  const unsigned char *s = (const unsigned char *)row->render;\n"
+          "  int n = row->rsize;\n"
+          "  int prev_sep = 1;\n",
+          name, name);
+  if (def->flags & HL_HIGHLIGHT_STRINGS) {
+    fprintf(out, "  int in_string = 0;\n");
+  }
+  fprintf(out, "  int i = 0;\n\n");
+
+  if (!def->mcs) {
+    fprintf(out, "  in_comment = 0;\n");
+  }
+  fprintf(out, "  while (i < n) {\n"
+               "    unsigned char c = s[i];\n\n");
+
+  if (def->mcs) {
+    // the comment is skipped up to the next character that may end it
+    fprintf(out, "    if (in_comment) {\n"
+                 "      int j = editorScanComment(s, i, n, ");
+    genChar(out, (unsigned char)def->mce[0]);
+    fprintf(out, ");\n"
+                 "      memset(&hl[i], HL_MLCOMMENT, j - i);\n"
+                 "      i = j;\n"
+                 "      if (i == n) {\n"
+                 "        break;\n"
+                 "      }\n"
+                 "      if (");
+    genMatch(out, def->mce);
+    fprintf(out,
+            ") {\n"
+            "        memset(&hl[i], HL_MLCOMMENT, %d);\n"
+            "        i += %d;\n"
+            "        in_comment = 0;\n"
+            "        prev_sep = 1;\n"
+            "      } else {\n"
+            "        hl[i++] = HL_MLCOMMENT;\n"
+            "      }\n"
+            "      continue;\n"
+            "    }\n\n",
+            (int)strlen(def->mce), (int)strlen(def->mce));
+  }
+
+  if (def->flags & HL_HIGHLIGHT_STRINGS) {
+    fprintf(out, "    if (in_string) {\n"
+                 "      int j = editorScanString(s, i, n, in_string);\n"
+                 "      if (j > i) {\n"
+                 "        memset(&hl[i], HL_STRING, j - i);\n"
+                 "        i = j;\n"
+                 "        prev_sep = 1;\n"
+                 "        continue;\n"
+                 "      }\n"
+                 "      hl[i] = HL_STRING;\n"
+                 "      if (c == '\\\\' && i + 1 < n) {\n"
+                 "        hl[i + 1] = HL_STRING;\n"
+                 "        i += 2;\n"
+                 "        continue;\n"
+                 "      }\n"
+                 "      if (c == in_string) {\n"
+                 "        in_string = 0;\n"
+                 "      }\n"
+                 "      i++;\n"
+                 "      prev_sep = 1;\n"
+                 "      continue;\n"
+                 "    }\n\n");
+  }
+
+  fprintf(out, "    if (class[c] & CLASS_SPACE) {\n"
+               "      i = editorScanSpaces(s, i + 1, n);\n"
+               "      prev_sep = 1;\n"
+               "      continue;\n"
+               "    }\n\n");
+
+  if (def->scs || def->mcs || (def->flags & HL_HIGHLIGHT_STRINGS)) {
+    fprintf(out, "    if (class[c] & CLASS_STOP) {\n");
+    if (def->scs) {
+      fprintf(out, "      if (");
+      genMatch(out, def->scs);
+      fprintf(out, ") {\n"
+                   "        memset(&hl[i], HL_COMMENT, n - i);\n"
+                   "        break;\n"
+                   "      }\n");
+    }
+    if (def->mcs) {
+      fprintf(out, "      if (");
+      genMatch(out, def->mcs);
+      fprintf(out,
+              ") {\n"
+              "        memset(&hl[i], HL_MLCOMMENT, %d);\n"
+              "        i += %d;\n"
+              "        in_comment = 1;\n"
+              "        continue;\n"
+              "      }\n",
+              (int)strlen(def->mcs), (int)strlen(def->mcs));
+    }
+    if (def->flags & HL_HIGHLIGHT_STRINGS) {
+      fprintf(out, "      if (class[c] & CLASS_QUOTE) {\n"
+                   "        in_string = c;\n"
+                   "        hl[i++] = HL_STRING;\n"
+                   "        continue;\n"
+                   "      }\n");
+    }
+    fprintf(out, "    }\n\n");
+  }
+
+  if (def->flags & HL_HIGHLIGHT_NUMBERS) {
+    fprintf(out,
+            "    if (((class[c] & CLASS_DIGIT) &&\n"
+            "         (prev_sep || (i > 0 && hl[i - 1] == HL_NUMBER))) ||\n"
+            "        (c == '.' && i > 0 && hl[i - 1] == HL_NUMBER)) {\n"
+            "      hl[i++] = HL_NUMBER;\n"
+            "      prev_sep = 0;\n"
+            "      continue;\n"
+            "    }\n\n");
+  }
+
+  // a whole word is scanned at once, it is a keyword only when it is
+  // followed by a separator
+  fprintf(out,
+          "    if (prev_sep && !(class[c] & (CLASS_SEP | CLASS_STOP))) {\n"
+          "      int j = editorScanWord(class, %d, s, i + 1, n);\n"
+          "      if ((class[c] & CLASS_KEYWORD) &&\n"
+          "          (class[s[j]] & CLASS_SEP)) {\n"
+          "        int kw = syntax_%s_keyword((const char *)&s[i], j - i);\n"
+          "        if (kw != HL_NORMAL) {\n"
+          "          memset(&hl[i], kw, j - i);\n"
+          "        }\n"
+          "      }\n"
+          "      i = j;\n"
+          "      prev_sep = 0;\n"
+          "      continue;\n"
+          "    }\n\n"
+          "    prev_sep = class[c] & CLASS_SEP;\n"
+          "    i++;\n"
+          "  }\n\n"
+          "  return in_comment;\n"
+          "}\n\n",
+          def->fast, name);
+}
+
+/***
+ * Writes the match list of a language
+ *
+ * @param *out The generated header
+ * @param *def The language
+ */
+static void genMatchList(FILE *out, struct editorSyntaxDef *def) {
+  fprintf(out, "static char *syntax_%s_match[] = {", def->filetype);
+  for (int j = 0; j < def->nmatch; j++) {
+    genString(out, def->match[j]);
+    fprintf(out, ", ");
+  }
+  fprintf(out, "NULL};\n\n");
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    fprintf(stderr, "usage: syntaxgen <output.h> <definition.syntax>...\n");
+    return 1;
+  }
+
+  int ndefs = argc - 2;
+  struct editorSyntaxDef *defs = calloc(ndefs, sizeof(struct editorSyntaxDef));
+  if (defs == NULL) {
+    genDie("out of memory");
+  }
+  for (int j = 0; j < ndefs; j++) {
+    genParse(argv[j + 2], &defs[j]);
+  }
+
+  FILE *out = fopen(argv[1], "w");
+  if (out == NULL) {
+    genDie("%s: can't create", argv[1]);
+  }
+
+  fprintf(out, "// generated by tools/syntaxgen.c, do not edit\n\n");
+  for (int j = 0; j < ndefs; j++) {
+    fprintf(out, "/*** %s ***/\n\n", defs[j].filetype);
+    genMatchList(out, &defs[j]);
+    genClassTable(out, &defs[j]);
+    genKeywords(out, &defs[j]);
+    genLexer(out, &defs[j]);
+  }
+
+  fprintf(out, "struct editorSyntax HLDB[] = {\n");
+  for (int j = 0; j < ndefs; j++) {
+    const char *name = defs[j].filetype;
+    fprintf(out, "    {\"%s\", syntax_%s_match, syntax_%s_lex, %d, NULL},\n",
+            name, name, name, defs[j].flags);
+  }
+  fprintf(out, "};\n");
+
+  if (fclose(out) != 0) {
+    genDie("%s: write failed", argv[1]);
+  }
+  return 0;
+}